@@ -24,15 +24,24 @@
 
 #include "IEffectNode.h"
 #include "IEffectPlugin.h"
+#include "mdate.h"
 
+#include <QHash>
 #include <QObject>
 #include <QReadLocker>
 #include <QReadWriteLock>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSet>
 #include <QString>
+#include <QThreadPool>
 #include <QWriteLocker>
 
+#include <string.h>
+
 EffectNodeFactory              EffectNode::s_renf;
 QReadWriteLock                 EffectNode::s_srwl( QReadWriteLock::Recursive );
+QAtomicInt                     EffectNode::s_topologyRevision( 0 );
 
 template class SemanticObjectManager< InSlot<LightVideoFrame> >;
 template class SemanticObjectManager< OutSlot<LightVideoFrame> >;
@@ -43,10 +52,66 @@ template class SemanticObjectManager< OutSlot<LightVideoFrame> >;
 // template class SemanticObjectManager<InSlot<qreal> >;
 // template class SemanticObjectManager<OutSlot<qreal> >;
 
+/**
+ *  \brief  Renders one step of an EffectNode plan, from the node's workers.
+ */
+class   EffectNode::StepRenderer : public QRunnable
+{
+    public:
+        StepRenderer( EffectNode* node, int step ) : m_node( node ), m_step( step )
+        {
+            setAutoDelete( false );
+        }
+        virtual void    run()
+        {
+            m_node->renderStep( m_step );
+        }
+
+    private:
+        EffectNode*     m_node;
+        int             m_step;
+};
+
+/**
+ *  \brief  Renders a range of rows of an EffectNode plugin, from the slicers
+ *          of one of its fathers.
+ */
+class   EffectNode::SliceRenderer : public QRunnable
+{
+    public:
+        SliceRenderer( EffectNode* node ) : m_node( node ), m_firstRow( 0 ), m_nbRows( 0 )
+        {
+            setAutoDelete( false );
+        }
+        void            setRange( quint32 firstRow, quint32 nbRows )
+        {
+            m_firstRow = firstRow;
+            m_nbRows = nbRows;
+        }
+        virtual void    run()
+        {
+            m_node->m_plugin->render( m_firstRow, m_nbRows );
+            m_node->m_slicesDone->release();
+        }
+
+    private:
+        EffectNode*     m_node;
+        quint32         m_firstRow;
+        quint32         m_nbRows;
+};
+
 EffectNode::EffectNode( IEffectPlugin* plugin ) : m_rwl( QReadWriteLock::Recursive ),
                                                   m_father( NULL ), m_plugin( plugin ),
-                                                  m_visited( false )
-{
+                                                  m_planOutdated( 1 ),
+                                                  m_nbPlanCompilations( 0 ),
+                                                  m_workers( NULL ),
+                                                  m_nbWorkers( 0 ),
+                                                  m_stepsDone( NULL ),
+                                                  m_slicers( NULL ),
+                                                  m_slicesDone( NULL ),
+                                                  m_activeStaticVideosInputsTracked( false )
+{
+    memset( &m_renderStats, 0, sizeof( m_renderStats ) );
     m_staticVideosInputs.setFather( this );
     m_staticVideosOutputs.setFather( this );
     m_staticVideosInputs.setScope( false );
@@ -62,8 +127,16 @@ EffectNode::EffectNode( IEffectPlugin* plugin ) : m_rwl( QReadWriteLock::Recursi
 
 EffectNode::EffectNode() : m_father( NULL ),
                            m_plugin( NULL ),
-                           m_visited( false )
-{
+                           m_planOutdated( 1 ),
+                           m_nbPlanCompilations( 0 ),
+                           m_workers( NULL ),
+                           m_nbWorkers( 0 ),
+                           m_stepsDone( NULL ),
+                           m_slicers( NULL ),
+                           m_slicesDone( NULL ),
+                           m_activeStaticVideosInputsTracked( false )
+{
+    memset( &m_renderStats, 0, sizeof( m_renderStats ) );
     m_staticVideosInputs.setFather( this );
     m_staticVideosOutputs.setFather( this );
     m_staticVideosInputs.setScope( false );
@@ -77,6 +150,20 @@ EffectNode::EffectNode() : m_father( NULL ),
 
 EffectNode::~EffectNode()
 {
+    if ( m_workers != NULL )
+    {
+        m_workers->waitForDone();
+        delete m_workers;
+    }
+    if ( m_slicers != NULL )
+    {
+        m_slicers->waitForDone();
+        delete m_slicers;
+    }
+    qDeleteAll( m_stepRenderers );
+    delete m_stepsDone;
+    qDeleteAll( m_sliceRenderers );
+    delete m_slicesDone;
     delete m_plugin;
 }
 
@@ -84,152 +171,342 @@ void
 EffectNode::render( void )
 {
     if ( m_plugin != NULL )
-        m_plugin->render();
+        renderPlugin();
     else
     {
+        QWriteLocker                        wl( &m_rwl );
+
+        if ( m_planOutdated.fetchAndStoreOrdered( 0 ) != 0 )
+            compilePlan();
         if ( m_father != NULL)
         {
-            QWriteLocker                        wl( &m_rwl );
             transmitDatasFromInputsToInternalsOutputs();
             renderSubNodes();
             transmitDatasFromInternalsInputsToOutputs();
-            resetAllChildsNodesVisitState();
         }
         else
-        {
-            QWriteLocker                        wl( &m_rwl );
             renderSubNodes();
-            resetAllChildsNodesVisitState();
-        }
     }
 }
 
 void
 EffectNode::renderSubNodes( void )
 {
-    QList<EffectNode*>                                effectsNodes = m_enf.getEffectNodeInstancesList();
-    QList<EffectNode*>::iterator                      effectsNodesIt = effectsNodes.begin();
-    QList<EffectNode*>::iterator                      effectsNodesEnd = effectsNodes.end();
-    QList<OutSlot<LightVideoFrame>*>                  intOuts = m_connectedInternalsStaticVideosOutputs.getObjectsReferencesList() ;
-    QList<OutSlot<LightVideoFrame>*>::iterator        intOutsIt = intOuts.begin();
-    QList<OutSlot<LightVideoFrame>*>::iterator        intOutsEnd = intOuts.end();
-    QQueue<EffectNode*>                               nodeQueue;
-    EffectNode*                                       toQueueNode;
-    EffectNode*                                       currentNode;
-    InSlot<LightVideoFrame>*                          currentIn;
+    if ( m_nbWorkers < 2 || m_plan.size() < 2 )
+    {
+        QVector<EffectNode*>::const_iterator    it = m_plan.constBegin();
+        QVector<EffectNode*>::const_iterator    end = m_plan.constEnd();
 
-    for ( ; effectsNodesIt != effectsNodesEnd; ++effectsNodesIt )
+        for ( ; it != end; ++it )
+            renderChild( *it );
+        return ;
+    }
+    for ( int i = 0; i < m_plan.size(); ++i )
+        m_stepsNbPendingDependencies[i].fetchAndStoreRelaxed( m_stepsNbDependencies[i] );
+    for ( int i = 0; i < m_plan.size(); ++i )
     {
-        if (
-            ( (*effectsNodesIt)->getNBConnectedStaticsVideosInputs() == 0 ) &&
-            ( (*effectsNodesIt)->getNBConnectedStaticsVideosOutputs() > 0 )
-            )
-        {
-            (*effectsNodesIt)->setVisited();
-            nodeQueue.enqueue( (*effectsNodesIt) );
-        }
+        if ( m_stepsNbDependencies[i] == 0 )
+            m_workers->start( m_stepRenderers[i] );
     }
-    for ( ; intOutsIt != intOutsEnd; ++intOutsIt )
+    //Every child has to be rendered before the frames leave this node.
+    m_stepsDone->acquire( m_plan.size() );
+}
+
+void
+EffectNode::renderStep( int step )
+{
+    renderChild( m_plan[step] );
+    foreach ( int successor, m_stepsSuccessors[step] )
     {
-        currentIn = (*intOutsIt)->getInSlotPtr();
-        toQueueNode = currentIn->getPrivateFather();
-        if ((toQueueNode != this) && ( toQueueNode->wasItVisited() == false ))
-        {
-            toQueueNode->setVisited();
-            nodeQueue.enqueue( toQueueNode );
-        }
+        if ( m_stepsNbPendingDependencies[successor].fetchAndAddOrdered( -1 ) == 1 )
+            m_workers->start( m_stepRenderers[successor] );
     }
+    m_stepsDone->release();
+}
 
-    while ( nodeQueue.empty() == false )
+void
+EffectNode::renderPlugin( void )
+{
+    EffectNode*     owner = m_father;
+
+    if ( m_plugin->isRowSeparable() == false )
     {
-        currentNode = nodeQueue.dequeue();
-        QList<OutSlot<LightVideoFrame>*>                  outs = currentNode->getConnectedStaticsVideosOutputsList();
-        QList<OutSlot<LightVideoFrame>*>::iterator        outsIt = outs.begin();
-        QList<OutSlot<LightVideoFrame>*>::iterator        outsEnd = outs.end();
+        m_plugin->render();
+        return ;
+    }
+    //The fathers are being rendered, so their worker count can't change.
+    while ( owner != NULL && owner->m_nbWorkers < 2 )
+        owner = owner->m_father;
+    if ( owner == NULL )
+    {
+        m_plugin->render();
+        return ;
+    }
 
-        currentNode->render();
-        for ( ; outsIt != outsEnd; ++outsIt )
-        {
-            currentIn = (*outsIt)->getInSlotPtr();
-            toQueueNode = currentIn->getPrivateFather();
-            if ((toQueueNode != this) && ( toQueueNode->wasItVisited() == false ))
-            {
-                toQueueNode->setVisited();
-                nodeQueue.enqueue( toQueueNode );
-            }
-        }
+    quint32     nbRows = m_plugin->beginRender();
+    quint32     nbSlices = qMin( (quint32)owner->m_nbWorkers, nbRows / MinRowsPerSlice );
+
+    if ( nbSlices < 2 )
+    {
+        if ( nbRows > 0 )
+            m_plugin->render( 0, nbRows );
+        m_plugin->endRender();
+        return ;
+    }
+    if ( m_slicesDone == NULL )
+        m_slicesDone = new QSemaphore;
+    while ( (quint32)m_sliceRenderers.size() < nbSlices )
+        m_sliceRenderers.append( new SliceRenderer( this ) );
+    for ( quint32 i = 1; i < nbSlices; ++i )
+    {
+        quint32     firstRow = nbRows * i / nbSlices;
+        quint32     lastRow = nbRows * ( i + 1 ) / nbSlices;
+
+        m_sliceRenderers[i]->setRange( firstRow, lastRow - firstRow );
+        owner->m_slicers->start( m_sliceRenderers[i] );
     }
+    //The first slice is rendered by this thread, which would only wait otherwise.
+    m_plugin->render( 0, nbRows / nbSlices );
+    m_slicesDone->acquire( nbSlices - 1 );
+    m_plugin->endRender();
+}
+
+void
+EffectNode::renderChild( EffectNode* child )
+{
+    qint64      start = mdate();
+
+    child->render();
+
+    qint64          duration = mdate() - start;
+    QMutexLocker    lock( &child->m_renderStatsMutex );
+    RenderStats&    stats = child->m_renderStats;
+
+    stats.last = duration;
+    if ( duration > stats.max )
+        stats.max = duration;
+    stats.total += duration;
+    ++stats.nbRenders;
 }
 
 void
 EffectNode::transmitDatasFromInputsToInternalsOutputs( void )
 {
-    if ( m_staticVideosInputs.getNBObjects() != 0 )
-    {
-        QList<InSlot<LightVideoFrame>*>             ins = m_staticVideosInputs.getObjectsList();
-        QList<OutSlot<LightVideoFrame>*>            intOuts = m_internalsStaticVideosOutputs.getObjectsList();
-        QList<InSlot<LightVideoFrame>*>::iterator  insIt = ins.begin();
-        QList<InSlot<LightVideoFrame>*>::iterator  insEnd = ins.end();
-        QList<OutSlot<LightVideoFrame>*>::iterator  intOutsIt = intOuts.begin();
-        QList<OutSlot<LightVideoFrame>*>::iterator  intOutsEnd = intOuts.end();
-
-        for ( ; ( insIt != insEnd ) && ( intOutsIt != intOutsEnd ); ++insIt, ++intOutsIt )
-            *(*intOutsIt) << *(*insIt);
-    }
+    QVector<Transmission>::const_iterator   it = m_inputsTransmissions.constBegin();
+    QVector<Transmission>::const_iterator   end = m_inputsTransmissions.constEnd();
 
+    for ( ; it != end; ++it )
+        *it->out << *it->in;
 }
 
 void
 EffectNode::transmitDatasFromInternalsInputsToOutputs( void )
 {
-    if ( m_staticVideosOutputs.getNBObjects() != 0 )
-    {
-        QList<InSlot<LightVideoFrame>*>             intIns = m_internalsStaticVideosInputs.getObjectsList();
-        QList<OutSlot<LightVideoFrame>*>            outs = m_staticVideosOutputs.getObjectsList();
-        QList<InSlot<LightVideoFrame>*>::iterator  intInsIt = intIns.begin();
-        QList<InSlot<LightVideoFrame>*>::iterator  intInsEnd = intIns.end();
-        QList<OutSlot<LightVideoFrame>*>::iterator  outsIt = outs.begin();
-        QList<OutSlot<LightVideoFrame>*>::iterator  outsEnd = outs.end();
-
-        for ( ; ( intInsIt != intInsEnd ) && ( outsIt != outsEnd ); ++intInsIt, ++outsIt )
-            *(*outsIt) << *(*intInsIt);
-    }
+    QVector<Transmission>::const_iterator   it = m_outputsTransmissions.constBegin();
+    QVector<Transmission>::const_iterator   end = m_outputsTransmissions.constEnd();
+
+    for ( ; it != end; ++it )
+        *it->out << *it->in;
 }
 
 void
-EffectNode::resetAllChildsNodesVisitState( void )
+EffectNode::topologyChanged( void )
 {
-    QList<EffectNode*>            childs = m_enf.getEffectNodeInstancesList();
+    m_planOutdated.fetchAndStoreOrdered( 1 );
+    if ( m_father != NULL )
+        m_father->m_planOutdated.fetchAndStoreOrdered( 1 );
+    s_topologyRevision.fetchAndAddOrdered( 1 );
+}
 
-    if ( childs.empty() == false )
-    {
-        QList<EffectNode*>::iterator  it = childs.begin();
-        QList<EffectNode*>::iterator  end = childs.end();
+quint32
+EffectNode::getNBPlanCompilations( void ) const
+{
+    QReadLocker                        rl( &m_rwl );
+    return m_nbPlanCompilations;
+}
 
-        for ( ; it != end; ++it)
-            (*it)->resetVisitState();
+void
+EffectNode::setWorkerCount( int nbWorkers )
+{
+    QWriteLocker                        wl( &m_rwl );
+
+    if ( nbWorkers >= 2 )
+    {
+        if ( m_workers == NULL )
+        {
+            m_workers = new QThreadPool;
+            m_stepsDone = new QSemaphore;
+            m_slicers = new QThreadPool;
+        }
+        m_workers->setMaxThreadCount( nbWorkers );
+        m_slicers->setMaxThreadCount( nbWorkers );
     }
+    m_nbWorkers = nbWorkers;
 }
 
-void
-EffectNode::setVisited( void )
+int
+EffectNode::getWorkerCount( void ) const
 {
-    QWriteLocker wl( &m_rwl );
-    m_visited = true;
+    QReadLocker                        rl( &m_rwl );
+    return m_nbWorkers;
+}
+
+EffectNode::RenderStats
+EffectNode::getRenderStats( void ) const
+{
+    QMutexLocker    lock( &m_renderStatsMutex );
+    return m_renderStats;
 }
 
 void
-EffectNode::resetVisitState( void )
+EffectNode::resetRenderStats( void )
 {
-    QWriteLocker wl( &m_rwl );
-    m_visited = false;
+    QMutexLocker    lock( &m_renderStatsMutex );
+    memset( &m_renderStats, 0, sizeof( m_renderStats ) );
 }
 
-bool
-EffectNode::wasItVisited( void ) const
+void
+EffectNode::compilePlan( void )
 {
-    QReadLocker rl( &m_rwl );
-    return  m_visited;
+    QList<EffectNode*>                                effectsNodes = m_enf.getEffectNodeInstancesList();
+    QList<OutSlot<LightVideoFrame>*>                  intOuts = m_connectedInternalsStaticVideosOutputs.getObjectsReferencesList();
+    QList<EffectNode*>                                reached;
+    QSet<EffectNode*>                                 reachedSet;
+    QHash<EffectNode*, int>                           nbPendingInputs;
+    QHash<EffectNode*, QList<EffectNode*> >           successors;
+    QQueue<EffectNode*>                               nodeQueue;
+    EffectNode*                                       toQueueNode;
+    EffectNode*                                       currentNode;
+
+    ++m_nbPlanCompilations;
+    m_plan.clear();
+    m_inputsTransmissions.clear();
+    m_outputsTransmissions.clear();
+
+    //Pair the slots the same way the frames go through this node. A frame
+    //coming from an unconnected slot, or going to one, would be lost anyway.
+    {
+        QList<InSlot<LightVideoFrame>*>     ins = m_staticVideosInputs.getObjectsList();
+        QList<OutSlot<LightVideoFrame>*>    outs = m_internalsStaticVideosOutputs.getObjectsList();
+
+        for ( int i = 0; i < ins.size() && i < outs.size(); ++i )
+        {
+            if ( ins[i]->getOutSlotPtr() == NULL || outs[i]->getInSlotPtr() == NULL )
+                continue ;
+            Transmission    t = { ins[i], outs[i] };
+            m_inputsTransmissions.append( t );
+        }
+    }
+    {
+        QList<InSlot<LightVideoFrame>*>     intIns = m_internalsStaticVideosInputs.getObjectsList();
+        QList<OutSlot<LightVideoFrame>*>    outs = m_staticVideosOutputs.getObjectsList();
+
+        for ( int i = 0; i < intIns.size() && i < outs.size(); ++i )
+        {
+            if ( intIns[i]->getOutSlotPtr() == NULL || outs[i]->getInSlotPtr() == NULL )
+                continue ;
+            Transmission    t = { intIns[i], outs[i] };
+            m_outputsTransmissions.append( t );
+        }
+    }
+
+    //Find the children the frames reach, in the order they reach them.
+    foreach ( EffectNode* node, effectsNodes )
+    {
+        if ( node->getNBConnectedStaticsVideosInputs() == 0 &&
+             node->getNBConnectedStaticsVideosOutputs() > 0 )
+        {
+            reachedSet.insert( node );
+            reached.append( node );
+            nodeQueue.enqueue( node );
+        }
+    }
+    foreach ( OutSlot<LightVideoFrame>* intOut, intOuts )
+    {
+        toQueueNode = intOut->getInSlotPtr()->getPrivateFather();
+        if ( toQueueNode != this && reachedSet.contains( toQueueNode ) == false )
+        {
+            reachedSet.insert( toQueueNode );
+            reached.append( toQueueNode );
+            nodeQueue.enqueue( toQueueNode );
+        }
+    }
+    while ( nodeQueue.empty() == false )
+    {
+        currentNode = nodeQueue.dequeue();
+        foreach ( OutSlot<LightVideoFrame>* out,
+                  currentNode->getConnectedStaticsVideosOutputsList() )
+        {
+            toQueueNode = out->getInSlotPtr()->getPrivateFather();
+            if ( toQueueNode == this )
+                continue ;
+            successors[currentNode].append( toQueueNode );
+            ++nbPendingInputs[toQueueNode];
+            if ( reachedSet.contains( toQueueNode ) == false )
+            {
+                reachedSet.insert( toQueueNode );
+                reached.append( toQueueNode );
+                nodeQueue.enqueue( toQueueNode );
+            }
+        }
+    }
+
+    //Then sort them. This is only done when the graph changes, so the
+    //quadratic lookup doesn't matter.
+    while ( reached.empty() == false )
+    {
+        int     next = 0;
+
+        for ( int i = 0; i < reached.size(); ++i )
+        {
+            if ( nbPendingInputs.value( reached[i] ) == 0 )
+            {
+                next = i;
+                break ;
+            }
+        }
+        //If no child is ready, there's a loop, which is broken at the first
+        //child the frames reach.
+        currentNode = reached.takeAt( next );
+        m_plan.append( currentNode );
+        foreach ( EffectNode* successor, successors.value( currentNode ) )
+            --nbPendingInputs[successor];
+    }
+
+    //Finally, tell the workers which step waits for which. Every dependency
+    //goes from a step to a later one, so the steps can't wait for each other.
+    QHash<EffectNode*, int>     steps;
+    int                         nbSteps = m_plan.size();
+
+    for ( int i = 0; i < nbSteps; ++i )
+        steps[m_plan[i]] = i;
+    m_stepsSuccessors.fill( QVector<int>(), nbSteps );
+    m_stepsNbDependencies.fill( 0, nbSteps );
+    m_stepsNbPendingDependencies.resize( nbSteps );
+    for ( int i = 0; i < nbSteps; ++i )
+    {
+        foreach ( EffectNode* successor, successors.value( m_plan[i] ) )
+        {
+            int     to = steps.value( successor );
+
+            if ( to == i )
+                continue ;
+            if ( to > i )
+            {
+                m_stepsSuccessors[i].append( to );
+                ++m_stepsNbDependencies[to];
+            }
+            else
+            {
+                m_stepsSuccessors[to].append( i );
+                ++m_stepsNbDependencies[i];
+            }
+        }
+    }
+    qDeleteAll( m_stepRenderers );
+    m_stepRenderers.clear();
+    for ( int i = 0; i < nbSteps; ++i )
+        m_stepRenderers.append( new StepRenderer( this, i ) );
 }
 
 //
@@ -268,6 +545,7 @@ EffectNode::primitiveConnectStaticVideoOutputToStaticVideoInput( quint32 outId,
     EffectNode*                brother;
     InSlot<LightVideoFrame>*  in;
 
+    topologyChanged();
     if ( outId == 0 && outName.isEmpty() == false )
     {
         if ( ( out = m_staticVideosOutputs.getObject( outName ) ) == NULL )
@@ -503,6 +781,7 @@ EffectNode::disconnectStaticVideoOutput( quint32 nodeId )
     InSlot<LightVideoFrame>*   in;
     EffectNode*                father;
 
+    topologyChanged();
     if ( ( out = m_staticVideosOutputs.getObject( nodeId ) ) == NULL )
         return false;
 
@@ -538,6 +817,7 @@ EffectNode::disconnectStaticVideoOutput( const QString & nodeName )
     InSlot<LightVideoFrame>*   in;
     EffectNode*                father;
 
+    topologyChanged();
     if ( ( out = m_staticVideosOutputs.getObject( nodeName ) ) == NULL )
         return false;
     in = out->getInSlotPtr();
@@ -579,6 +859,20 @@ EffectNode::getInternalPlugin( void )
     return m_plugin;
 }
 
+quint32
+EffectNode::acceptedFormats( void ) const
+{
+    QReadLocker                        rl( &m_rwl );
+    quint32                            formats = VideoFrame::RGB24 | VideoFrame::I420 |
+                                                 VideoFrame::NV12;
+
+    if ( m_plugin != NULL )
+        return m_plugin->acceptedFormats();
+    foreach ( EffectNode* child, m_enf.getEffectNodeInstancesList() )
+        formats &= child->acceptedFormats();
+    return formats;
+}
+
 
 //
 //
@@ -704,6 +998,12 @@ EffectNode::getRootNode( const QString & rootNodeName )
     return EffectNode::s_renf.getEffectNodeInstance( rootNodeName );
 }
 
+int
+EffectNode::getTopologyRevision( void )
+{
+    return s_topologyRevision;
+}
+
 //
 //
 //
@@ -781,6 +1081,8 @@ bool
 EffectNode::createEmptyChild( void )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_plugin == NULL )
     {
         m_enf.createEmptyEffectNodeInstance();
@@ -793,6 +1095,8 @@ bool
 EffectNode::createEmptyChild( const QString & childName )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_plugin == NULL )
         return m_enf.createEmptyEffectNodeInstance( childName );
     return false;
@@ -802,6 +1106,8 @@ bool
 EffectNode::createChild( quint32 typeId )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_plugin == NULL )
         return m_enf.createEffectNodeInstance( typeId );
     return false;
@@ -811,6 +1117,8 @@ bool
 EffectNode::createChild( const QString & typeName )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_plugin == NULL )
         return m_enf.createEffectNodeInstance( typeName );
     return false;
@@ -820,6 +1128,8 @@ bool
 EffectNode::deleteChild( quint32 childId )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_plugin == NULL )
         return m_enf.deleteEffectNodeInstance( childId );
     return false;
@@ -829,6 +1139,8 @@ bool
 EffectNode::deleteChild( const QString & childName )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_plugin == NULL )
         return m_enf.deleteEffectNodeInstance( childName );
     return false;
@@ -880,16 +1192,20 @@ void
 EffectNode::createStaticVideoInput( const QString & name )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     m_staticVideosInputs.createObject( name );
     if ( m_plugin == NULL )
         m_internalsStaticVideosOutputs.createObject( name );
-
+    updateActiveStaticVideoInputs();
 }
 
 void
 EffectNode::createStaticVideoOutput( const QString & name )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     m_staticVideosOutputs.createObject( name );
     if ( m_plugin == NULL )
         m_internalsStaticVideosInputs.createObject( name );
@@ -905,16 +1221,20 @@ void
 EffectNode::createStaticVideoInput( void )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     m_staticVideosInputs.createObject();
     if ( m_plugin == NULL )
         m_internalsStaticVideosOutputs.createObject();
-
+    updateActiveStaticVideoInputs();
 }
 
 void
 EffectNode::createStaticVideoOutput( void )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     m_staticVideosOutputs.createObject();
     if ( m_plugin == NULL )
         m_internalsStaticVideosInputs.createObject();
@@ -930,8 +1250,11 @@ bool
 EffectNode::removeStaticVideoInput( const QString & name )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_staticVideosInputs.deleteObject( name ) )
     {
+        updateActiveStaticVideoInputs();
         if ( m_plugin == NULL )
             if ( m_internalsStaticVideosOutputs.deleteObject( name ) == false )
                 return false; // IF THIS CAS HAPPEND WE ARE SCREWED
@@ -944,6 +1267,8 @@ bool
 EffectNode::removeStaticVideoOutput( const QString & name )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_staticVideosOutputs.deleteObject( name ) )
     {
         if ( m_plugin == NULL )
@@ -963,8 +1288,11 @@ bool
 EffectNode::removeStaticVideoInput( quint32 id )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_staticVideosInputs.deleteObject( id ) )
     {
+        updateActiveStaticVideoInputs();
         if ( m_plugin == NULL )
             if ( m_internalsStaticVideosOutputs.deleteObject( id ) == false )
                 return false; // IF THIS CAS HAPPEND WE ARE SCREWED
@@ -977,6 +1305,8 @@ bool
 EffectNode::removeStaticVideoOutput( quint32 id )
 {
     QWriteLocker                        wl( &m_rwl );
+
+    topologyChanged();
     if ( m_staticVideosOutputs.deleteObject( id ) )
     {
         if ( m_plugin == NULL )
@@ -1072,6 +1402,61 @@ EffectNode::getStaticsVideosOutputsList( void ) const
     return m_staticVideosOutputs.getObjectsList();
 }
 
+const QVector<InSlot<LightVideoFrame>*>&
+EffectNode::getStaticsVideosInputsArray( void ) const
+{
+    QReadLocker                        rl( &m_rwl );
+    return m_staticVideosInputs.getObjectsArray();
+}
+
+const QVector<OutSlot<LightVideoFrame>*>&
+EffectNode::getStaticsVideosOutputsArray( void ) const
+{
+    QReadLocker                        rl( &m_rwl );
+    return m_staticVideosOutputs.getObjectsArray();
+}
+
+const QVector<InSlot<LightVideoFrame>*>&
+EffectNode::getActiveStaticsVideosInputsArray( void ) const
+{
+    QReadLocker                        rl( &m_rwl );
+    return m_activeStaticVideosInputs;
+}
+
+void
+EffectNode::setActiveStaticVideoInputs( const QVector<quint32>& ids )
+{
+    QWriteLocker                        wl( &m_rwl );
+
+    m_activeStaticVideosInputsIds = ids;
+    m_activeStaticVideosInputsTracked = true;
+    updateActiveStaticVideoInputs();
+}
+
+void
+EffectNode::updateActiveStaticVideoInputs( void )
+{
+    const QVector<InSlot<LightVideoFrame>*>&    ins = m_staticVideosInputs.getObjectsArray();
+
+    m_activeStaticVideosInputs.clear();
+    if ( m_activeStaticVideosInputsTracked == false )
+    {
+        foreach ( InSlot<LightVideoFrame>* in, ins )
+        {
+            if ( in != NULL )
+                m_activeStaticVideosInputs.append( in );
+        }
+        return ;
+    }
+    foreach ( quint32 id, m_activeStaticVideosInputsIds )
+    {
+        InSlot<LightVideoFrame>*    in = m_staticVideosInputs.getObject( id );
+
+        if ( in != NULL )
+            m_activeStaticVideosInputs.append( in );
+    }
+}
+
 //  QList<InSlot<AudioSoundSample>*>		getStaticAudioInputList( void ) const;
 //     QList<OutSlot<AudioSoundSample>*>		getStaticAudioOutputList( void ) const;
 //     QList<InSlot<qreal>*>		getStaticControlInputList( void ) const;
@@ -1289,6 +1674,7 @@ EffectNode::primitiveConnectChildAndParentTogether( quint32 outId,
     InSlot<LightVideoFrame>*  in;
 
 
+    topologyChanged();
     if ( PTC == true )
     {
         if ( inId == 0 && inName.isEmpty() == false )
@@ -1453,6 +1839,7 @@ EffectNode::disconnectInternalStaticVideoOutput( quint32 nodeId )
     InSlot<LightVideoFrame>*   in;
     EffectNode*                father;
 
+    topologyChanged();
     if ( ( out = m_internalsStaticVideosOutputs.getObject( nodeId ) ) == NULL )
         return false;
     in = out->getInSlotPtr();
@@ -1474,6 +1861,7 @@ EffectNode::disconnectInternalStaticVideoOutput( const QString & nodeName )
     InSlot<LightVideoFrame>*   in;
     EffectNode*                father;
 
+    topologyChanged();
     if ( ( out = m_internalsStaticVideosOutputs.getObject( nodeName ) ) == NULL )
         return false;
     in = out->getInSlotPtr();
@@ -1498,6 +1886,7 @@ EffectNode::referenceStaticVideoInputAsConnected( InSlot<LightVideoFrame>* in )
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedStaticVideosInputs.addObjectReference( in );
 }
 
@@ -1506,6 +1895,7 @@ EffectNode::referenceInternalStaticVideoOutputAsConnected( OutSlot<LightVideoFra
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedInternalsStaticVideosOutputs.addObjectReference( out );
 }
 
@@ -1514,6 +1904,7 @@ EffectNode::referenceStaticVideoOutputAsConnected( OutSlot<LightVideoFrame>* out
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedStaticVideosOutputs.addObjectReference( out );
 }
 
@@ -1522,6 +1913,7 @@ EffectNode::referenceInternalStaticVideoInputAsConnected( InSlot<LightVideoFrame
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedInternalsStaticVideosInputs.addObjectReference( in );
 }
 
@@ -1530,6 +1922,7 @@ EffectNode::dereferenceStaticVideoInputAsConnected( quint32 inId )
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedStaticVideosInputs.delObjectReference( inId );
 }
 
@@ -1538,6 +1931,7 @@ EffectNode::dereferenceInternalStaticVideoOutputAsConnected( quint32 outId )
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedInternalsStaticVideosOutputs.delObjectReference(  outId );
 }
 
@@ -1546,6 +1940,7 @@ EffectNode::dereferenceStaticVideoOutputAsConnected( quint32 outId )
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedStaticVideosOutputs.delObjectReference(  outId );
 }
 
@@ -1554,6 +1949,7 @@ EffectNode::dereferenceInternalStaticVideoInputAsConnected( quint32 inId )
 {
     QWriteLocker                        wl( &m_rwl );
 
+    topologyChanged();
     return m_connectedInternalsStaticVideosInputs.delObjectReference( inId );
 }
 
@@ -30,7 +30,10 @@
 #include "SemanticObjectManager.hpp"
 #include "SimpleObjectsReferencer.hpp"
 
+#include <QAtomicInt>
+#include <QMutex>
 #include <QQueue>
+#include <QVector>
 #include <QtGlobal>
 
 class   IEffectPlugin;
@@ -38,7 +41,9 @@ class   LightVideoFrame;
 
 class   QReadLocker;
 class   QReadWriteLock;
+class   QSemaphore;
 class   QString;
+class   QThreadPool;
 class   QWriteLocker;
 class   QObject;
 
@@ -56,6 +61,17 @@ class	EffectNode : public IEffectNode
 
  public:
 
+    /**
+     *  \brief  How long a node takes to render, in microseconds.
+     */
+    struct  RenderStats
+    {
+        qint64      last;
+        qint64      max;
+        qint64      total;
+        qint64      nbRenders;
+    };
+
     // ================================================================= CTORS, DTOR & INIT ========================================================================
 
     ~EffectNode();
@@ -83,10 +99,35 @@ class	EffectNode : public IEffectNode
     void        renderSubNodes( void );
     void        transmitDatasFromInputsToInternalsOutputs( void );
     void        transmitDatasFromInternalsInputsToOutputs( void );
-    void        resetAllChildsNodesVisitState( void );
-    void        setVisited( void );
-    void        resetVisitState( void );
-    bool        wasItVisited( void ) const;
+    /**
+     *  \brief  Tell this node, and its father, that the graph they render has
+     *          changed, so their plan has to be compiled again.
+     *
+     *  This is done by every method creating, deleting or connecting a node or
+     *  a slot.
+     */
+    void        topologyChanged( void );
+    /**
+     *  \return The number of times the plan of this node has been compiled.
+     */
+    quint32     getNBPlanCompilations( void ) const;
+    /**
+     *  \brief  Render the children with nbWorkers threads.
+     *
+     *  A child is started as soon as the children it depends on are rendered,
+     *  so the independent branches are rendered at the same time. With 0 or 1
+     *  worker, the children are rendered one after the other by the thread
+     *  rendering this node.
+     *  The frames of the row separable plugins below this node (see
+     *  IEffectPlugin::isRowSeparable()) are also split in up to nbWorkers slices.
+     */
+    void        setWorkerCount( int nbWorkers );
+    int         getWorkerCount( void ) const;
+    /**
+     *  \return How long this node took to render, as timed by its father.
+     */
+    RenderStats getRenderStats( void ) const;
+    void        resetRenderStats( void );
 
     // ================================================================= GET WIDGET ========================================================================
 
@@ -96,6 +137,12 @@ class	EffectNode : public IEffectNode
 
     IEffectPlugin*       getInternalPlugin( void );
 
+    /**
+     *  \return The formats accepted by the plugin, or by all the children of
+     *          a node that doesn't have any plugin.
+     */
+    quint32              acceptedFormats( void ) const;
+
     // ================================================================= PARENT NODE ========================================================================
 
     void                setFather( EffectNode* father );
@@ -107,6 +154,11 @@ class	EffectNode : public IEffectNode
     static bool                createRootNode( const QString & rootNodeName );
     static bool                deleteRootNode( const QString & rootNodeName );
     static EffectNode*         getRootNode( const QString & rootNodeName );
+    /**
+     *  \return A number changing each time a node, a slot or a connection of
+     *          any graph is created or removed.
+     */
+    static int                 getTopologyRevision( void );
 
     // ================================================================= CHILD NODES ========================================================================
 
@@ -200,6 +252,17 @@ class	EffectNode : public IEffectNode
 
     QList<InSlot<LightVideoFrame>*>		getStaticsVideosInputsList( void ) const;
     QList<OutSlot<LightVideoFrame>*>		getStaticsVideosOutputsList( void ) const;
+    const QVector<InSlot<LightVideoFrame>*>&    getStaticsVideosInputsArray( void ) const;
+    const QVector<OutSlot<LightVideoFrame>*>&   getStaticsVideosOutputsArray( void ) const;
+    const QVector<InSlot<LightVideoFrame>*>&    getActiveStaticsVideosInputsArray( void ) const;
+    /**
+     *  \brief  Tell which inputs are given a frame, from now on.
+     *
+     *  Until this is called, every input is active.
+     *  \param  ids The ids of the active inputs, by increasing id. The ids
+     *              which aren't inputs (yet) are ignored.
+     */
+    void                                        setActiveStaticVideoInputs( const QVector<quint32>& ids );
     //  QList<InSlot<AudioSoundSample>*>		getStaticsAudiosInputsList( void ) const;
     //     QList<OutSlot<AudioSoundSample>*>		getStaticsAudiosOutputsList( void ) const;
     //     QList<InSlot<qreal>*>		getStaticsControlsInputsList( void ) const;
@@ -434,6 +497,55 @@ public:
     quint32                          getNBConnectedStaticsVideosOutputs( void ) const;
     quint32                          getNBConnectedInternalsStaticsVideosInputs( void ) const;
 
+    //-------------------------------------------------------------------------//
+    //                             RENDERING PLAN                              //
+    //-------------------------------------------------------------------------//
+
+    /**
+     *  \brief  Sort the children in the order they have to be rendered, and
+     *          resolve the slots this node transmits its frames through.
+     *
+     *  The children are the ones the frames reach, from the internal outputs or
+     *  from the children without any connected input. A child comes after the
+     *  ones it depends on. When the children are in a loop, the first one the
+     *  frames reach gets the frames of the previous render from the others.
+     */
+    void                             compilePlan( void );
+
+    struct  Transmission
+    {
+        InSlot<LightVideoFrame>*    in;
+        OutSlot<LightVideoFrame>*   out;
+    };
+    class   StepRenderer;
+    class   SliceRenderer;
+
+    enum
+    {
+        /// Frames are never split in slices smaller than this.
+        MinRowsPerSlice = 16,
+    };
+
+    /**
+     *  \brief  Render a child, and time it.
+     */
+    void                             renderChild( EffectNode* child );
+    /**
+     *  \brief  Render a step of the plan from a worker, then start the steps
+     *          that were waiting for it.
+     */
+    void                             renderStep( int step );
+    /**
+     *  \brief  Render the plugin, in slices if it's row separable and one of
+     *          the fathers has some workers.
+     */
+    void                             renderPlugin( void );
+    /**
+     *  \brief  Build m_activeStaticVideosInputs again, after the inputs, or the
+     *          active ids, changed.
+     */
+    void                             updateActiveStaticVideoInputs( void );
+
     ////
     ////
     ////
@@ -448,6 +560,7 @@ public:
 
     static EffectNodeFactory            s_renf;
     static QReadWriteLock               s_srwl;
+    static QAtomicInt                   s_topologyRevision;
 
  private:
 
@@ -455,7 +568,52 @@ public:
     EffectNodeFactory                   m_enf;
     EffectNode*                         m_father;
     IEffectPlugin*                      m_plugin;
-    bool                                m_visited;
+    /**
+     *  \brief  Set when the plan has to be compiled before the next render.
+     */
+    QAtomicInt                          m_planOutdated;
+    quint32                             m_nbPlanCompilations;
+    QVector<EffectNode*>                m_plan;
+    QVector<Transmission>               m_inputsTransmissions;
+    QVector<Transmission>               m_outputsTransmissions;
+    /**
+     *  \brief  The steps that can only start after each step of the plan.
+     *
+     *  A step depends on the ones giving it a frame, and the ones it gives a
+     *  frame to through a loop depend on it, so they don't overwrite the frame
+     *  before it is read.
+     */
+    QVector< QVector<int> >             m_stepsSuccessors;
+    QVector<int>                        m_stepsNbDependencies;
+    QVector<QAtomicInt>                 m_stepsNbPendingDependencies;
+    QVector<StepRenderer*>              m_stepRenderers;
+    QThreadPool*                        m_workers;
+    int                                 m_nbWorkers;
+    /**
+     *  \brief  Released once by each step, so the render can wait for all of them.
+     */
+    QSemaphore*                         m_stepsDone;
+    /**
+     *  \brief  The threads rendering the slices of the plugins below this node.
+     *
+     *  They're not the same as m_workers: a worker waits for the slices of the
+     *  node it renders, and it could wait forever if all the workers did.
+     */
+    QThreadPool*                        m_slicers;
+    QVector<SliceRenderer*>             m_sliceRenderers;
+    /**
+     *  \brief  Released once by each slice, but the one rendered by the thread
+     *          rendering this node.
+     */
+    QSemaphore*                         m_slicesDone;
+    QVector<InSlot<LightVideoFrame>*>   m_activeStaticVideosInputs;
+    QVector<quint32>                    m_activeStaticVideosInputsIds;
+    /**
+     *  \brief  false until setActiveStaticVideoInputs() is called.
+     */
+    bool                                m_activeStaticVideosInputsTracked;
+    RenderStats                         m_renderStats;
+    mutable QMutex                      m_renderStatsMutex;
 
     //
     //
@@ -40,7 +40,9 @@
 EffectsEngine::EffectsEngine( void ) : m_patch( NULL ),
                                        m_bypassPatch( NULL ),
                                        m_enabled( true ),
-                                       m_processedInBypassPatch( false )
+                                       m_nbToggles( 0 ),
+                                       m_processedInBypassPatch( false ),
+                                       m_nbVideoInputs( 0 )
 {
     makePatch();
     makeBypassPatch();
@@ -61,25 +63,16 @@ EffectsEngine::makePatch( void )
         qDebug() << "RootNode creation failed !";
     else
     {
-        quint32	i;
         EffectNode* tmp;
 
         qDebug() << "RootNode successfully created!";
         m_patch = EffectNode::getRootNode( "RootNode" );
-        for ( i = 0 ; i < 64; ++i)
-            m_patch->createStaticVideoInput();
         m_patch->createStaticVideoOutput();
 
 
+        //The inputs, and the mixer inputs, are added by setVideoInput().
         if ( m_patch->createChild( "Mixer" ) == true )
         {
-            tmp = m_patch->getChild( 1 );
-            for ( i = 1 ; i <= 64; ++i )
-                if ( tmp->connectChildStaticVideoInputToParentStaticVideoOutput( i, i ) == false )
-                    qDebug() << "The connection of the input "
-                             << i << " of the mixer with the internal "
-                             << i << " output of the RootNode failed!";
-
             m_patch->createChild( "BlitInRectangle" );
             m_patch->createChild( "InvertRNB" );
 
@@ -116,25 +109,15 @@ EffectsEngine::makeBypassPatch( void )
         qDebug() << "BypassRootNode creation failed!!!!!!!!!!";
     else
     {
-        quint32	i;
         EffectNode* tmp;
 
         qDebug() << "BypassRootNode successfully created!";
 
         m_bypassPatch = EffectNode::getRootNode( "BypassRootNode" );
-        for ( i = 0 ; i < 64; ++i)
-            m_bypassPatch->createStaticVideoInput();
         m_bypassPatch->createStaticVideoOutput();
 
         if ( m_bypassPatch->createChild( "Mixer" ) == true )
         {
-            tmp = m_bypassPatch->getChild( 1 );
-            for ( i = 1 ; i <= 64; ++i)
-                if ( tmp->connectChildStaticVideoInputToParentStaticVideoOutput( i, i ) == false )
-                    qDebug() << "The connection of the intput "
-                             << i << " of the mixer with the internal "
-                             << i << " output of the BypassRootNode failed!";
-
             tmp = m_bypassPatch->getChild( 1 );
             if ( tmp->connectChildStaticVideoOutputToParentStaticVideoInput( 1, 1 ) == false )
                 qDebug() << "The connection of the mixer output"
@@ -146,20 +129,80 @@ EffectsEngine::makeBypassPatch( void )
     }
 }
 
+void
+EffectsEngine::addVideoInputs( EffectNode* patch, quint32 nbInputs )
+{
+    if ( patch == NULL )
+        return ;
+
+    EffectNode*     mixer = patch->getChild( 1 );
+
+    for ( quint32 i = patch->getNBStaticsVideosInputs() + 1; i <= nbInputs; ++i )
+    {
+        patch->createStaticVideoInput();
+        if ( mixer == NULL )
+            continue ;
+        mixer->createStaticVideoInput();
+        if ( mixer->connectChildStaticVideoInputToParentStaticVideoOutput( i, i ) == false )
+            qDebug() << "The connection of the input "
+                     << i << " of the mixer with the internal "
+                     << i << " output of the" << patch->getInstanceName() << "failed!";
+    }
+}
+
 void
 EffectsEngine::setVideoInput( quint32 inId, const LightVideoFrame & frame )
 {
     QWriteLocker  wl( &m_rwl );
+    EffectNode*   patch;
+
+    if ( inId > m_nbVideoInputs )
+    {
+        //Both patches are kept with the same inputs, as they can be switched
+        //at any time.
+        addVideoInputs( m_patch, inId );
+        addVideoInputs( m_bypassPatch, inId );
+        m_nbVideoInputs = inId;
+    }
     if ( m_enabled == true )
     {
         m_processedInBypassPatch = false;
-        (*m_patch->getInternalStaticVideoOutput( inId )) << frame;
+        patch = m_patch;
     }
     else
     {
         m_processedInBypassPatch = true;
-        (*m_bypassPatch->getInternalStaticVideoOutput( inId )) << frame;
+        patch = m_bypassPatch;
     }
+    (*patch->getInternalStaticVideoOutput( inId )) << frame;
+
+    //Keep the ids sorted, as the mixer stacks the inputs in this order.
+    int     i = m_nextActiveVideoInputs.size();
+
+    while ( i > 0 && m_nextActiveVideoInputs[i - 1] > inId )
+        --i;
+    if ( i == 0 || m_nextActiveVideoInputs[i - 1] != inId )
+        m_nextActiveVideoInputs.insert( i, inId );
+}
+
+void
+EffectsEngine::updateActiveVideoInputs( EffectNode* patch, QVector<quint32>& active )
+{
+    if ( m_nextActiveVideoInputs != active )
+    {
+        //Don't keep the frames of the inputs that aren't active anymore.
+        foreach ( quint32 id, active )
+        {
+            if ( m_nextActiveVideoInputs.contains( id ) == false )
+                (*patch->getInternalStaticVideoOutput( id )) << m_nullFrame;
+        }
+        active = m_nextActiveVideoInputs;
+
+        EffectNode*     mixer = patch->getChild( 1 );
+        if ( mixer != NULL )
+            mixer->setActiveStaticVideoInputs( active );
+    }
+    m_nextActiveVideoInputs.clear();
 }
 
 void
@@ -167,9 +210,15 @@ EffectsEngine::render( void )
 {
     QWriteLocker  wl( &m_rwl );
     if ( m_processedInBypassPatch == false )
+    {
+        updateActiveVideoInputs( m_patch, m_activeVideoInputs );
         m_patch->render();
+    }
     else
+    {
+        updateActiveVideoInputs( m_bypassPatch, m_bypassActiveVideoInputs );
         m_bypassPatch->render();
+    }
 }
 
 const LightVideoFrame &
@@ -182,12 +231,36 @@ EffectsEngine::getVideoOutput( quint32 outId ) const
     return *m_bypassPatch->getInternalStaticVideoInput( outId );
 }
 
+VideoFrame::Format
+EffectsEngine::videoFormat( void ) const
+{
+    QReadLocker  rl( &m_rwl );
+
+    //The engine can be enabled or disabled while rendering, but the frames
+    //keep the format they were negotiated with, so both patches must handle it.
+    if ( m_patch == NULL || m_bypassPatch == NULL )
+        return VideoFrame::RGB24;
+    if ( ( m_patch->acceptedFormats() & m_bypassPatch->acceptedFormats() &
+           VideoFrame::I420 ) != 0 )
+        return VideoFrame::I420;
+    return VideoFrame::RGB24;
+}
+
+int
+EffectsEngine::revision( void ) const
+{
+    QReadLocker  rl( &m_rwl );
+    return m_nbToggles + EffectNode::getTopologyRevision();
+}
+
 // BYPASSING
 
 void
 EffectsEngine::enable( void )
 {
     QWriteLocker  wl( &m_rwl );
+    if ( m_enabled == false )
+        ++m_nbToggles;
     m_enabled = true;
 }
 
@@ -195,5 +268,17 @@ void
 EffectsEngine::disable( void )
 {
     QWriteLocker  wl( &m_rwl );
+    if ( m_enabled == true )
+        ++m_nbToggles;
     m_enabled = false;
 }
+
+void
+EffectsEngine::setWorkerCount( int nbWorkers )
+{
+    QWriteLocker  wl( &m_rwl );
+    if ( m_patch != NULL )
+        m_patch->setWorkerCount( nbWorkers );
+    if ( m_bypassPatch != NULL )
+        m_bypassPatch->setWorkerCount( nbWorkers );
+}
@@ -30,10 +30,12 @@
 #define EFFECTSENGINE_H_
 
 #include "EffectNodeFactory.h"
+#include "LightVideoFrame.h"
 //Temporary
 #include "SemanticObjectManager.hpp"
 
 #include <QReadWriteLock>
+#include <QVector>
 #include <QtGlobal>
 
 // Temporary
@@ -43,7 +45,6 @@ class  TStop;
 
 
 class   EffectNode;
-class   LightVideoFrame;
 
 /**
  * \class EffectsEngine
@@ -100,6 +101,14 @@ class	EffectsEngine
     */
     void                    disable( void );
 
+    /**
+    * \brief Set the number of threads rendering the effects
+    * \param nbWorkers : with 0 or 1, the effects are rendered one after the
+    *        other. Otherwise, the independent branches of both patches are
+    *        rendered at the same time.
+    */
+    void                    setWorkerCount( int nbWorkers );
+
     /**
     * \brief Render the audio/video with effects
     * If the patch used by inputs methods is "RootNode", it will call the
@@ -131,9 +140,28 @@ class	EffectsEngine
     * input with the id inId of the EffectNode called "RootNode"
     * else, it will give the video frame to the input with the id inId
     * of the EffectNode called "BypassRootNode"
+
+    * The inputs are created as they're used, so there can be any number of them.
+    * Only the inputs given a frame since the last render are rendered: the
+    * mixer doesn't even visit the others.
     */
     void                        setVideoInput( quint32 inId, const LightVideoFrame & frame );
 
+    /**
+    * \brief Negotiate the format of the frames given to the effects engine
+    * \return I420 if every plugin of both patches handles it, RGB24 otherwise.
+    *         Both patches are checked, as the engine can be enabled or
+    *         disabled during a render.
+    */
+    VideoFrame::Format          videoFormat( void ) const;
+
+    /**
+    * \brief Tell when the rendered frames may have changed
+    * \return A number changing each time the effects engine is enabled or
+    *         disabled, and each time an effect graph is edited.
+    */
+    int                         revision( void ) const;
+
 private:
 
     /**
@@ -166,6 +194,11 @@ private:
      * to m_bypassPatch
      */
     bool                    m_enabled;
+    /**
+     * \var int m_nbToggles
+     * The number of times m_enabled has changed
+     */
+    int                     m_nbToggles;
     /**
      * \var EffectNode* m_processedInBypassPatch
      * This var is used to tell the render and the outputs methods
@@ -173,6 +206,32 @@ private:
      */
     bool                    m_processedInBypassPatch;
 
+    /**
+     * \brief Add inputs to a patch, and to its mixer, up to nbInputs inputs
+     */
+    void                    addVideoInputs( EffectNode* patch, quint32 nbInputs );
+    /**
+     * \brief Release the frames of the inputs that aren't active anymore,
+     *        and tell the mixer which inputs are active
+     * \param active : the inputs that were active on the last render of patch
+     */
+    void                    updateActiveVideoInputs( EffectNode* patch,
+                                                     QVector<quint32>& active );
+
+    /**
+     * \var quint32 m_nbVideoInputs
+     * The number of video inputs of both patches
+     */
+    quint32                 m_nbVideoInputs;
+    /**
+     * \var QVector<quint32> m_nextActiveVideoInputs
+     * The ids of the inputs given a frame since the last render, in increasing order
+     */
+    QVector<quint32>        m_nextActiveVideoInputs;
+    QVector<quint32>        m_activeVideoInputs;
+    QVector<quint32>        m_bypassActiveVideoInputs;
+    LightVideoFrame         m_nullFrame;
+
 };
 
 #endif // EFFECTSENGINE_H_
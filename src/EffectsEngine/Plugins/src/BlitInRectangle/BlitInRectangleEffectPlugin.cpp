@@ -22,6 +22,7 @@
  *****************************************************************************/
 
 #include "BlitInRectangleEffectPlugin.h"
+#include "PixelKernels.h"
 #include <QtDebug>
 
 
@@ -40,6 +41,10 @@ void            BlitInRectangleEffectPlugin::init(IEffectNode* ien)
     m_ien->createStaticVideoInput("dst");
     m_ien->createStaticVideoOutput("aux");
     m_ien->createStaticVideoOutput("res");
+    m_src = m_ien->getStaticVideoInput("src");
+    m_dst = m_ien->getStaticVideoInput("dst");
+    m_aux = m_ien->getStaticVideoOutput("aux");
+    m_res = m_ien->getStaticVideoOutput("res");
     return ;
 }
 
@@ -48,15 +53,27 @@ void    BlitInRectangleEffectPlugin::render( void )
     LightVideoFrame     lvf1;
     LightVideoFrame     lvf2;
 
-    (*m_ien->getStaticVideoInput("src")) >> lvf1;
-    (*m_ien->getStaticVideoInput("dst")) >> lvf2;
+    (*m_src) >> lvf1;
+    (*m_dst) >> lvf2;
 
-    QImage              src( lvf1->frame.octets, lvf1->width, lvf1->height, QImage::Format_RGB888 );
-    QImage              dst( lvf2->frame.octets, lvf2->width, lvf2->height, QImage::Format_RGB888 );
-    QPainter            p( &dst );
+    const VideoFrame&   srcFrame = *static_cast<const LightVideoFrame&>( lvf1 );
+    if ( srcFrame.frame.octets != NULL &&
+         static_cast<const LightVideoFrame&>( lvf2 )->frame.octets != NULL )
+    {
+        //The source is drawn over a copy of the destination.
+        VideoFrame&     dstFrame = lvf2.writable( Q_FUNC_INFO );
+        //Clip the source to the destination.
+        quint32         width = qMin( srcFrame.width, dstFrame.width > X ?
+                                                      dstFrame.width - X : 0 );
+        quint32         height = qMin( srcFrame.height, dstFrame.height > Y ?
+                                                        dstFrame.height - Y : 0 );
 
-    p.drawImage( 100, 100, src);
-    (*m_ien->getStaticVideoOutput("aux")) << lvf2;
-    (*m_ien->getStaticVideoOutput("res")) << lvf2;
+        for ( quint32 y = 0; y < height; ++y )
+            PixelKernels::copy( dstFrame.scanLine( 0, Y + y ) + X * Pixel::NbComposantes,
+                                srcFrame.scanLine( 0, y ),
+                                width * Pixel::NbComposantes );
+    }
+    (*m_aux) << lvf2;
+    (*m_res) << lvf2;
     return ;
 }
@@ -24,8 +24,6 @@
 #ifndef BLITINRECTANGLEEFFECTPLUGIN_H_
 #define BLITINRECTANGLEEFFECTPLUGIN_H_
 
-#include <QImage>
-#include <QPainter>
 #include "IEffectNode.h"
 #include "IEffectPlugin.h"
 
@@ -48,7 +46,15 @@ class	BlitInRectangleEffectPlugin : public QObject, public IEffectPlugin
 
  private:
 
+  /// Where the source is drawn in the destination, in pixels.
+  static const quint32          X = 100;
+  static const quint32          Y = 100;
+
   IEffectNode*                  m_ien;
+  VideoInputHandle              m_src;
+  VideoInputHandle              m_dst;
+  VideoOutputHandle             m_aux;
+  VideoOutputHandle             m_res;
 };
 
 #endif // BLITINRECTANGLEEFFECTPLUGIN_H_
@@ -21,10 +21,11 @@
  *****************************************************************************/
 
 #include "GreenFilterEffectPlugin.h"
+#include "PixelKernels.h"
 #include <QtDebug>
 
 
-GreenFilterEffectPlugin::GreenFilterEffectPlugin()
+GreenFilterEffectPlugin::GreenFilterEffectPlugin() : m_ien( NULL ), m_dst( NULL )
 {
 }
 
@@ -42,17 +43,41 @@ void            GreenFilterEffectPlugin::init(IEffectNode* ien)
 
 void    GreenFilterEffectPlugin::render( void )
 {
-    quint32		i;
-    LightVideoFrame	tmp;
-    (*m_ien->getStaticVideoInput(1)) >> tmp;
-    if (tmp->frame.octets != NULL)
-    {
-        for ( i = 0; i < tmp->nbpixels; ++i )
-        {
-            tmp->frame.pixels[i].Red = 0;
-            tmp->frame.pixels[i].Blue = 0;
-        }
-        (*m_ien->getStaticVideoOutput(1)) << tmp;
-    }
-    return ;
+    quint32     nbRows = beginRender();
+
+    if ( nbRows > 0 )
+        render( 0, nbRows );
+    endRender();
+}
+
+quint32 GreenFilterEffectPlugin::beginRender( void )
+{
+    (*m_ien->getStaticVideoInput(1)) >> m_src;
+    //Only read the input through a const reference, so it's never copied.
+    const LightVideoFrame&  src = m_src;
+    if (src->frame.octets == NULL)
+        return 0;
+    //The input is still referenced by the track, so the result is written
+    //to a new frame instead of a copy of the input.
+    m_res = src.allocateLike();
+    m_dst = &m_res.writable( Q_FUNC_INFO );
+    return src->height;
+}
+
+void    GreenFilterEffectPlugin::render( quint32 firstRow, quint32 nbRows )
+{
+    const LightVideoFrame&  src = m_src;
+
+    FrameKernels<VideoFrame::RGB24>::maskChannels( *m_dst, *src, PixelKernels::Green,
+                                                   firstRow, nbRows );
+}
+
+void    GreenFilterEffectPlugin::endRender( void )
+{
+    if ( m_dst != NULL )
+        (*m_ien->getStaticVideoOutput(1)) << m_res;
+    //Don't keep a reference on the frames until the next render.
+    m_src = LightVideoFrame();
+    m_res = LightVideoFrame();
+    m_dst = NULL;
 }
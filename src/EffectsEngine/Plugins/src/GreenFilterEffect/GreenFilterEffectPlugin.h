@@ -43,9 +43,20 @@ class	GreenFilterEffectPlugin : public QObject, public IEffectPlugin
 
   void	render( void );
 
+  // SLICED RENDER
+
+  bool          isRowSeparable( void ) const { return true; }
+  quint32       beginRender( void );
+  void          render( quint32 firstRow, quint32 nbRows );
+  void          endRender( void );
+
  private:
 
   IEffectNode*                  m_ien;
+  LightVideoFrame               m_src;
+  LightVideoFrame               m_res;
+  /// The frame m_res is written through, or NULL if there's nothing to render
+  VideoFrame*                   m_dst;
 };
 
 #endif // GREENFILTEREFFECTPLUGIN_H_
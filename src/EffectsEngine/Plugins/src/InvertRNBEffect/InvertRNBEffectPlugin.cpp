@@ -21,9 +21,10 @@
  *****************************************************************************/
 
 #include "InvertRNBEffectPlugin.h"
+#include "PixelKernels.h"
 #include <QtDebug>
 
-InvertRNBEffectPlugin::InvertRNBEffectPlugin()
+InvertRNBEffectPlugin::InvertRNBEffectPlugin() : m_ien( NULL ), m_dst( NULL )
 {
 }
 
@@ -41,20 +42,40 @@ void            InvertRNBEffectPlugin::init(IEffectNode* ien)
 
 void    InvertRNBEffectPlugin::render( void )
 {
-    quint32		i;
-    LightVideoFrame	tmp;
-    quint8              tmpay;
-
-    (*m_ien->getStaticVideoInput(1)) >> tmp;
-    if (tmp->frame.octets != NULL)
-    {
-        for ( i = 0; i < tmp->nbpixels; ++i )
-        {
-            tmpay = tmp->frame.pixels[i].Red;
-            tmp->frame.pixels[i].Red = tmp->frame.pixels[i].Blue;
-            tmp->frame.pixels[i].Blue = tmpay;
-        }
-        (*m_ien->getStaticVideoOutput(1)) << tmp;
-    }
-    return ;
+    quint32     nbRows = beginRender();
+
+    if ( nbRows > 0 )
+        render( 0, nbRows );
+    endRender();
+}
+
+quint32 InvertRNBEffectPlugin::beginRender( void )
+{
+    (*m_ien->getStaticVideoInput(1)) >> m_src;
+    //Only read the input through a const reference, so it's never copied.
+    const LightVideoFrame&  src = m_src;
+    if (src->frame.octets == NULL)
+        return 0;
+    //The input is still referenced by the track, so the result is written
+    //to a new frame instead of a copy of the input.
+    m_res = src.allocateLike();
+    m_dst = &m_res.writable( Q_FUNC_INFO );
+    return src->height;
+}
+
+void    InvertRNBEffectPlugin::render( quint32 firstRow, quint32 nbRows )
+{
+    const LightVideoFrame&  src = m_src;
+
+    FrameKernels<VideoFrame::RGB24>::swapRB( *m_dst, *src, firstRow, nbRows );
+}
+
+void    InvertRNBEffectPlugin::endRender( void )
+{
+    if ( m_dst != NULL )
+        (*m_ien->getStaticVideoOutput(1)) << m_res;
+    //Don't keep a reference on the frames until the next render.
+    m_src = LightVideoFrame();
+    m_res = LightVideoFrame();
+    m_dst = NULL;
 }
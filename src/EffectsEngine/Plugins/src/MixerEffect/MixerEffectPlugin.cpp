@@ -37,9 +37,10 @@ MixerEffectPlugin::~MixerEffectPlugin()
 void    MixerEffectPlugin::init( IEffectNode* ien )
 {
     m_ien = ien;
-    for ( unsigned int i = 0; i < 64; ++i )
-        m_ien->createStaticVideoInput();
+    //The inputs are created by the host, one per layer, when it needs them.
     m_ien->createStaticVideoOutput();
+    m_inputs = VideoInputsHandle( m_ien->getActiveStaticsVideosInputsArray() );
+    m_output = m_ien->getStaticVideoOutput( 1 );
     return ;
 }
 
@@ -47,18 +48,20 @@ void	MixerEffectPlugin::render( void )
 {
   quint32                   i;
   quint32                   nbIns;
-  static LightVideoFrame    nullFrame;
 
-  nbIns = m_ien->getNBStaticsVideosInputs();
-  for ( i = nbIns; i > 0; --i )
+  //The inputs are stacked by track, the first one being the lowest.
+  //Only the inputs given a frame for this render are visited.
+  nbIns = m_inputs.size();
+  for ( i = 0; i < nbIns; ++i )
   {
-      const LightVideoFrame&   lvf = (*m_ien->getStaticVideoInput( i ));
-      if ( lvf->frame.octets != NULL )
-      {
-          (*m_ien->getStaticVideoOutput( 1 )) << lvf;
-          return ;
-      }
+      const LightVideoFrame&   lvf = (*m_inputs[i]);
+      m_compositor.addLayer( lvf );
   }
-  (*m_ien->getStaticVideoOutput( 1 )) << nullFrame;
+  (*m_output) << m_compositor.composite();
   return ;
 }
+
+quint32 MixerEffectPlugin::acceptedFormats( void ) const
+{
+  return VideoFrame::RGB24 | VideoFrame::I420 | VideoFrame::NV12;
+}
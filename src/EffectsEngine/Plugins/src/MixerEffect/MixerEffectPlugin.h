@@ -25,6 +25,7 @@
 
 #include "IEffectNode.h"
 #include "IEffectPlugin.h"
+#include "VideoCompositor.h"
 
 class	MixerEffectPlugin : public IEffectPlugin
 {
@@ -43,9 +44,16 @@ public:
 
   void	render( void );
 
+  // FORMATS
+
+  quint32       acceptedFormats( void ) const;
+
 private:
 
   IEffectNode*                  m_ien;
+  VideoInputsHandle             m_inputs;
+  VideoOutputHandle             m_output;
+  VideoCompositor               m_compositor;
 };
 
 #endif // MIXEREFFECTPLUGIN_H_
@@ -26,6 +26,12 @@
 #include "InSlot.hpp"
 #include "OutSlot.hpp"
 #include "LightVideoFrame.h"
+#include "SlotHandle.hpp"
+
+typedef SlotHandle< InSlot<LightVideoFrame> >           VideoInputHandle;
+typedef SlotHandle< OutSlot<LightVideoFrame> >          VideoOutputHandle;
+typedef SlotArrayHandle< InSlot<LightVideoFrame> >      VideoInputsHandle;
+typedef SlotArrayHandle< OutSlot<LightVideoFrame> >     VideoOutputsHandle;
 
 class	IEffectNode
 {
@@ -71,6 +77,18 @@ class	IEffectNode
     virtual QList<InSlot<LightVideoFrame>*>	getStaticsVideosInputsList( void ) const = 0;
     virtual QList<OutSlot<LightVideoFrame>*>	getStaticsVideosOutputsList( void ) const = 0;
 
+    /**
+     *  \brief  The slots by id, to build a VideoInputsHandle or a VideoOutputsHandle.
+     */
+    virtual const QVector<InSlot<LightVideoFrame>*>&    getStaticsVideosInputsArray( void ) const = 0;
+    virtual const QVector<OutSlot<LightVideoFrame>*>&   getStaticsVideosOutputsArray( void ) const = 0;
+    /**
+     *  \brief  The inputs that are given a frame, by increasing id, without any NULL.
+     *
+     *  Unless the host tells which inputs are active, these are all the inputs.
+     */
+    virtual const QVector<InSlot<LightVideoFrame>*>&    getActiveStaticsVideosInputsArray( void ) const = 0;
+
     // -------------- GET INFOS ON SLOTS --------------
 
     virtual QList<QString>                      getStaticsVideosInputsNamesList( void ) const = 0;
@@ -25,6 +25,7 @@
 #define IEFFECTPLUGIN_H_
 
 //#include "IEffectNode.h"
+#include "LightVideoFrame.h"
 
 class   IEffectNode;
 
@@ -41,6 +42,51 @@ class	IEffectPlugin
   virtual void	render( void ) = 0;
   virtual void  init( IEffectNode* ien ) = 0;
 
+  // FORMATS
+
+  /**
+   *  \return The VideoFrame::Format flags of the frames this plugin can process.
+   *
+   *  Frames are only produced in RGB24 when one of the plugins doesn't handle
+   *  anything else.
+   */
+  virtual quint32       acceptedFormats( void ) const { return VideoFrame::RGB24; }
+
+  // SLICED RENDER
+
+  /**
+   *  \return true if the rows of a frame can be rendered independently, ie. by
+   *          several threads at once.
+   *
+   *  The engine may then split a render in three: beginRender(), then
+   *  render( firstRow, nbRows ) on disjoint ranges covering all the rows, from
+   *  several threads, then endRender(). render() must still render a whole
+   *  frame on its own, as the engine only splits the frames when it has more
+   *  than one worker.
+   */
+  virtual bool          isRowSeparable( void ) const { return false; }
+  /**
+   *  \brief  Fetch the inputs, and prepare the outputs, of a sliced render.
+   *  \return The number of rows to render, or 0 if there's nothing to render.
+   */
+  virtual quint32       beginRender( void ) { return 0; }
+  /**
+   *  \brief  Render the rows [firstRow; firstRow + nbRows[.
+   *
+   *  This is called from several threads at once, so it must only write to
+   *  those rows of the outputs.
+   */
+  virtual void          render( quint32 firstRow, quint32 nbRows )
+  {
+    Q_UNUSED( firstRow );
+    Q_UNUSED( nbRows );
+  }
+  /**
+   *  \brief  Send the outputs of a sliced render. This is called after every
+   *          range is rendered, even if beginRender() returned 0.
+   */
+  virtual void          endRender( void ) {}
+
 };
 
 #endif // IEFFECTPLUGIN_H_
@@ -35,6 +35,6 @@ public:
     virtual IEffectPlugin*      createIEffectPluginInstance( void ) = 0;
 };
 
-Q_DECLARE_INTERFACE(IEffectPluginCreator, "IEffectPluginCreator/0.1")
+Q_DECLARE_INTERFACE(IEffectPluginCreator, "IEffectPluginCreator/0.2")
 
 #endif // IEFFECTPLUGINFACTORY_H_
@@ -30,10 +30,21 @@
 #include <QWriteLocker>
 #include <QReadLocker>
 
+#include <stdlib.h>
+
+IVideoFrameAllocator*   VideoFrame::s_defaultAllocator = NULL;
+QAtomicInt              VideoFrame::s_nbDeepCopies = QAtomicInt( 0 );
+bool                    VideoFrame::s_copyLogging = false;
+
 VideoFrame::~VideoFrame()
 {
   if ( frame.octets != NULL )
-    delete [] frame.octets;
+  {
+    if ( allocator != NULL )
+      allocator->release( frame.octets, width, height, nboctets );
+    else
+      alignedFree( frame.octets );
+  }
 }
 
 VideoFrame::VideoFrame( void )
@@ -44,18 +55,32 @@ VideoFrame::VideoFrame( void )
   width = 0;
   height = 0;
   ptsDiff = 0;
+  format = RGB24;
+  layout = Packed;
+  nbPlanes = 0;
+  allocator = NULL;
 }
 
 VideoFrame::VideoFrame( const VideoFrame& tocopy ) : QSharedData( tocopy )
 {
+    //Keep the original allocator, so that the buffer goes back to the main
+    //application even when a plugin detaches the frame.
+    allocator = tocopy.allocator;
+    format = tocopy.format;
+    layout = tocopy.layout;
     if ( tocopy.frame.octets != NULL )
     {
         nboctets = tocopy.nboctets;
-        nbpixels = tocopy.nboctets / Pixel::NbComposantes;
+        nbpixels = tocopy.nbpixels;
         width = tocopy.width;
         height = tocopy.height;
         ptsDiff = tocopy.ptsDiff;
-        frame.octets = new quint8[tocopy.nboctets];
+        nbPlanes = tocopy.nbPlanes;
+        memcpy( planes, tocopy.planes, sizeof( planes ) );
+        if ( allocator != NULL )
+            frame.octets = allocator->allocate( width, height, nboctets );
+        else
+            frame.octets = alignedAlloc( nboctets );
 
         memcpy( frame.octets, tocopy.frame.octets, nboctets );
     }
@@ -63,11 +88,154 @@ VideoFrame::VideoFrame( const VideoFrame& tocopy ) : QSharedData( tocopy )
     {
         nboctets = 0;
         nbpixels = 0;
+        width = 0;
+        height = 0;
         ptsDiff = 0;
+        nbPlanes = 0;
         frame.octets = NULL;
     }
 }
 
+quint32
+VideoFrame::computePlanes( Format format, Layout layout, quint32 width, quint32 height,
+                           Plane* planes, quint32* nbPlanes )
+{
+    Plane       tmp[MaxPlanes];
+    quint32     count;
+    quint32     offset = 0;
+
+    if ( planes == NULL )
+        planes = tmp;
+    planes[0].width = width;
+    planes[0].height = height;
+    planes[0].shift = 0;
+    if ( format == RGB24 )
+    {
+        planes[0].sampleSize = Pixel::NbComposantes;
+        planes[0].black = 0;
+        count = 1;
+    }
+    else
+    {
+        planes[0].sampleSize = 1;
+        planes[0].black = 16;
+        count = ( format == NV12 ? 2 : 3 );
+        for ( quint32 i = 1; i < count; ++i )
+        {
+            planes[i].width = ( width + 1 ) / 2;
+            planes[i].height = ( height + 1 ) / 2;
+            planes[i].shift = 1;
+            planes[i].sampleSize = ( format == NV12 ? 2 : 1 );
+            planes[i].black = 128;
+        }
+    }
+    for ( quint32 i = 0; i < count; ++i )
+    {
+        planes[i].pitch = planes[i].width * planes[i].sampleSize;
+        //As every pitch is a multiple of Alignment, so is every plane offset.
+        if ( layout == Aligned )
+            planes[i].pitch = ( planes[i].pitch + Alignment - 1 ) & ~( Alignment - 1 );
+        planes[i].offset = offset;
+        offset += planes[i].pitch * planes[i].height;
+    }
+    if ( nbPlanes != NULL )
+        *nbPlanes = count;
+    return offset;
+}
+
+quint32
+VideoFrame::frameSize( Format format, quint32 width, quint32 height,
+                       Layout layout /*= Packed*/ )
+{
+    return computePlanes( format, layout, width, height, NULL, NULL );
+}
+
+const char*
+VideoFrame::fourcc( Format format )
+{
+    switch ( format )
+    {
+    case I420:
+        return "I420";
+    case NV12:
+        return "NV12";
+    default:
+        return "RV24";
+    }
+}
+
+void
+VideoFrame::setDefaultAllocator( IVideoFrameAllocator* allocator )
+{
+    s_defaultAllocator = allocator;
+}
+
+quint8*
+VideoFrame::alignedAlloc( quint32 size )
+{
+    //Keep the address returned by malloc right before the aligned buffer.
+    quint32     padded = ( size + Alignment - 1 ) & ~( Alignment - 1 );
+    quint8*     raw = static_cast<quint8*>( malloc( padded + Alignment +
+                                                    sizeof( void* ) ) );
+    if ( raw == NULL )
+        return NULL;
+    quintptr    aligned = reinterpret_cast<quintptr>( raw + sizeof( void* ) );
+    aligned = ( aligned + Alignment - 1 ) & ~( quintptr )( Alignment - 1 );
+    reinterpret_cast<void**>( aligned )[-1] = raw;
+    return reinterpret_cast<quint8*>( aligned );
+}
+
+void
+VideoFrame::alignedFree( quint8* buffer )
+{
+    if ( buffer != NULL )
+        free( reinterpret_cast<void**>( buffer )[-1] );
+}
+
+int
+VideoFrame::nbDeepCopies()
+{
+    return s_nbDeepCopies;
+}
+
+void
+VideoFrame::setCopyLogging( bool enabled )
+{
+    s_copyLogging = enabled;
+}
+
+bool
+VideoFrame::copyLogging()
+{
+    return s_copyLogging;
+}
+
+void
+VideoFrame::reportCopy( const VideoFrame& frame, const char* callSite )
+{
+    if ( frame.allocator != NULL )
+    {
+        frame.allocator->copied( frame.width, frame.height, frame.nboctets, callSite );
+        return ;
+    }
+    s_nbDeepCopies.ref();
+    if ( s_copyLogging == true )
+        qDebug() << "Deep copy of a" << frame.width << 'x' << frame.height
+                << "frame, from" << callSite;
+}
+
+void
+VideoFrame::allocateOctets( IVideoFrameAllocator* frameAllocator )
+{
+    nbpixels = width * height;
+    nboctets = computePlanes( format, layout, width, height, planes, &nbPlanes );
+    allocator = frameAllocator;
+    if ( allocator != NULL )
+        frame.octets = allocator->allocate( width, height, nboctets );
+    else
+        frame.octets = alignedAlloc( nboctets );
+}
+
 //
 //
 //
@@ -79,7 +247,9 @@ LightVideoFrame::LightVideoFrame()
   m_videoFrame = new VideoFrame;
 }
 
-LightVideoFrame::LightVideoFrame( const LightVideoFrame& tocopy ) : m_videoFrame(tocopy.m_videoFrame)
+LightVideoFrame::LightVideoFrame( const LightVideoFrame& tocopy ) :
+    m_videoFrame(tocopy.m_videoFrame),
+    m_layer(tocopy.m_layer)
 {
 }
 
@@ -87,28 +257,31 @@ LightVideoFrame&
 LightVideoFrame::operator=( const LightVideoFrame& tocopy )
 {
   m_videoFrame = tocopy.m_videoFrame;
+  m_layer = tocopy.m_layer;
   return *this;
 }
 
-LightVideoFrame::LightVideoFrame( quint32 width, quint32 height )
+LightVideoFrame::LightVideoFrame( quint32 width, quint32 height,
+                                  VideoFrame::Format format,
+                                  VideoFrame::Layout layout )
 {
   m_videoFrame = new VideoFrame;
   m_videoFrame->width = width;
   m_videoFrame->height = height;
-  m_videoFrame->nbpixels = m_videoFrame->width * m_videoFrame->height;
-  m_videoFrame->nboctets = m_videoFrame->nbpixels * Pixel::NbComposantes;
-  m_videoFrame->frame.octets = new quint8[m_videoFrame->nboctets];
+  m_videoFrame->format = format;
+  m_videoFrame->layout = layout;
+  m_videoFrame->allocateOctets( VideoFrame::s_defaultAllocator );
   m_videoFrame->ptsDiff = 0;
 }
 
-LightVideoFrame::LightVideoFrame( const quint8 * tocopy, quint32 width, quint32 height )
+LightVideoFrame::LightVideoFrame( const quint8 * tocopy, quint32 width, quint32 height,
+                                  VideoFrame::Format format )
 {
     m_videoFrame = new VideoFrame;
     m_videoFrame->width = width;
     m_videoFrame->height = height;
-    m_videoFrame->nbpixels = m_videoFrame->width * m_videoFrame->height;
-    m_videoFrame->nboctets = m_videoFrame->nbpixels * Pixel::NbComposantes;
-    m_videoFrame->frame.octets = new quint8[m_videoFrame->nboctets];
+    m_videoFrame->format = format;
+    m_videoFrame->allocateOctets( VideoFrame::s_defaultAllocator );
     m_videoFrame->ptsDiff = 0;
 
     memcpy( m_videoFrame->frame.octets, tocopy, m_videoFrame->nboctets );
@@ -133,11 +306,247 @@ LightVideoFrame::operator*( void ) const
 VideoFrame*
 LightVideoFrame::operator->( void )
 {
-  return m_videoFrame.data();
+  return &writable( "an implicit write access" );
 }
 
 VideoFrame&
 LightVideoFrame::operator*( void )
 {
+  return writable( "an implicit write access" );
+}
+
+void
+LightVideoFrame::detach( const char* callSite )
+{
+  if ( m_videoFrame->ref == 1 )
+    return ;
+  if ( m_videoFrame->frame.octets != NULL )
+    VideoFrame::reportCopy( *m_videoFrame, callSite );
+  m_videoFrame.detach();
+}
+
+VideoFrame&
+LightVideoFrame::writable( const char* callSite )
+{
+  detach( callSite );
   return *m_videoFrame;
 }
+
+VideoFrame&
+LightVideoFrame::reallocateIfShared( void )
+{
+  if ( m_videoFrame->ref == 1 || m_videoFrame->frame.octets == NULL )
+  {
+    m_videoFrame.detach();
+    return *m_videoFrame;
+  }
+  *this = allocateLike();
+  return *m_videoFrame;
+}
+
+LightVideoFrame
+LightVideoFrame::allocateLike( void ) const
+{
+  LightVideoFrame   ret;
+
+  if ( m_videoFrame->frame.octets == NULL )
+    return ret;
+  VideoFrame*   frame = new VideoFrame;
+  const VideoFrame&   old = *m_videoFrame;
+
+  frame->width = old.width;
+  frame->height = old.height;
+  frame->format = old.format;
+  frame->layout = old.layout;
+  frame->ptsDiff = old.ptsDiff;
+  //Keep the buffer in the same allocator, as a detached frame would.
+  frame->allocateOctets( old.allocator );
+  ret.m_videoFrame = frame;
+  ret.m_layer = m_layer;
+  return ret;
+}
+
+LightVideoFrame
+LightVideoFrame::clone( const char* callSite ) const
+{
+  LightVideoFrame     ret( *this );
+
+  ret.detach( callSite );
+  return ret;
+}
+
+const VideoLayer&
+LightVideoFrame::layer( void ) const
+{
+  return m_layer;
+}
+
+void
+LightVideoFrame::setLayer( const VideoLayer& layer )
+{
+  m_layer = layer;
+}
+
+bool
+LightVideoFrame::isShared( void ) const
+{
+  return m_videoFrame->ref != 1;
+}
+
+/**
+ *  \brief  Locate the chroma samples on row y of the chroma planes of a YUV frame.
+ *
+ *  U and V samples of a chroma pixel are at data[u + i * step] and data[v + i * step].
+ */
+static void
+chromaRow( const VideoFrame& frame, quint32 y, quint32& u, quint32& v, quint32& step )
+{
+    u = frame.planes[1].offset + y * frame.planes[1].pitch;
+    if ( frame.format == VideoFrame::NV12 )
+    {
+        v = u + 1;
+        step = 2;
+    }
+    else
+    {
+        v = frame.planes[2].offset + y * frame.planes[2].pitch;
+        step = 1;
+    }
+}
+
+static inline quint8
+clip( int value )
+{
+    return value < 0 ? 0 : ( value > 255 ? 255 : value );
+}
+
+void
+LightVideoFrame::fillBlack( void )
+{
+    VideoFrame&     frame = reallocateIfShared();
+
+    if ( frame.frame.octets == NULL )
+        return ;
+    //The padding is filled as well, as there's no reason to skip it.
+    for ( quint32 i = 0; i < frame.nbPlanes; ++i )
+    {
+        const VideoFrame::Plane&    plane = frame.planes[i];
+
+        memset( frame.frame.octets + plane.offset, plane.black,
+                plane.pitch * plane.height );
+    }
+}
+
+LightVideoFrame
+LightVideoFrame::converted( VideoFrame::Format format ) const
+{
+    const VideoFrame&   src = *m_videoFrame;
+
+    if ( src.format == format || src.frame.octets == NULL )
+        return *this;
+
+    quint32             width = src.width;
+    quint32             height = src.height;
+    quint32             chromaWidth = ( width + 1 ) / 2;
+    LightVideoFrame     ret( width, height, format, src.layout );
+    VideoFrame&         dst = *ret.m_videoFrame;
+    quint32             u;
+    quint32             v;
+    quint32             step;
+
+    ret.m_layer = m_layer;
+    dst.ptsDiff = src.ptsDiff;
+    //Frames are BGR in memory.
+    if ( src.format == VideoFrame::RGB24 )
+    {
+        for ( quint32 y = 0; y < height; ++y )
+        {
+            const quint8*   in = src.scanLine( 0, y );
+            quint8*         out = dst.scanLine( 0, y );
+
+            for ( quint32 x = 0; x < width; ++x, in += 3 )
+                out[x] = ( ( 66 * in[2] + 129 * in[1] + 25 * in[0] + 128 ) >> 8 ) + 16;
+        }
+        //Each chroma sample is computed from the top left pixel of its 2x2 block.
+        for ( quint32 y = 0; y < height; y += 2 )
+        {
+            const quint8*   in = src.scanLine( 0, y );
+            quint8*         out = dst.frame.octets;
+
+            chromaRow( dst, y / 2, u, v, step );
+            for ( quint32 x = 0; x < chromaWidth; ++x )
+            {
+                const quint8*   p = in + x * 2 * 3;
+
+                out[u + x * step] = ( ( -38 * p[2] - 74 * p[1] + 112 * p[0] + 128 ) >> 8 )
+                                    + 128;
+                out[v + x * step] = ( ( 112 * p[2] - 94 * p[1] - 18 * p[0] + 128 ) >> 8 )
+                                    + 128;
+            }
+        }
+        return ret;
+    }
+    else if ( format == VideoFrame::RGB24 )
+    {
+        for ( quint32 y = 0; y < height; ++y )
+        {
+            const quint8*   in = src.scanLine( 0, y );
+            quint8*         out = dst.scanLine( 0, y );
+
+            chromaRow( src, y / 2, u, v, step );
+            for ( quint32 x = 0; x < width; ++x, out += 3 )
+            {
+                int         c = 298 * ( in[x] - 16 );
+                int         d = src.frame.octets[u + ( x / 2 ) * step] - 128;
+                int         e = src.frame.octets[v + ( x / 2 ) * step] - 128;
+
+                out[2] = clip( ( c + 409 * e + 128 ) >> 8 );
+                out[1] = clip( ( c - 100 * d - 208 * e + 128 ) >> 8 );
+                out[0] = clip( ( c + 516 * d + 128 ) >> 8 );
+            }
+        }
+        return ret;
+    }
+    //From one YUV layout to the other: the luma plane doesn't change.
+    quint32         srcU;
+    quint32         srcV;
+    quint32         srcStep;
+
+    for ( quint32 y = 0; y < height; ++y )
+        memcpy( dst.scanLine( 0, y ), src.scanLine( 0, y ), width );
+    for ( quint32 y = 0; y < ( height + 1 ) / 2; ++y )
+    {
+        chromaRow( src, y, srcU, srcV, srcStep );
+        chromaRow( dst, y, u, v, step );
+        for ( quint32 x = 0; x < chromaWidth; ++x )
+        {
+            dst.frame.octets[u + x * step] = src.frame.octets[srcU + x * srcStep];
+            dst.frame.octets[v + x * step] = src.frame.octets[srcV + x * srcStep];
+        }
+    }
+    return ret;
+}
+
+LightVideoFrame
+LightVideoFrame::relaid( VideoFrame::Layout layout ) const
+{
+    const VideoFrame&   src = *m_videoFrame;
+
+    if ( src.layout == layout || src.frame.octets == NULL )
+        return *this;
+
+    LightVideoFrame     ret( src.width, src.height, src.format, layout );
+    VideoFrame&         dst = *ret.m_videoFrame;
+
+    ret.m_layer = m_layer;
+    dst.ptsDiff = src.ptsDiff;
+    for ( quint32 i = 0; i < src.nbPlanes; ++i )
+    {
+        const VideoFrame::Plane&    plane = src.planes[i];
+
+        for ( quint32 y = 0; y < plane.height; ++y )
+            memcpy( dst.scanLine( i, y ), src.scanLine( i, y ),
+                    plane.width * plane.sampleSize );
+    }
+    return ret;
+}
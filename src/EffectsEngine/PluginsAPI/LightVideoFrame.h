@@ -25,6 +25,7 @@
 #ifndef LIGHTVIDEOFRAME_H_
 #define LIGHTVIDEOFRAME_H_
 
+#include <QAtomicInt>
 #include <QSharedDataPointer>
 
 struct	Pixel
@@ -44,39 +45,286 @@ union	RawVideoFrame
   quint8*	octets;
 };
 
+/**
+ *  \brief  Lets the host application provide the frames buffers.
+ *
+ *  A frame remembers the allocator its buffer comes from, so the buffer goes
+ *  back to it even when the frame is detached or destroyed from a plugin.
+ *  The buffers must be aligned, and padded, as VideoFrame::alignedAlloc() does.
+ */
+class   IVideoFrameAllocator
+{
+public:
+  virtual ~IVideoFrameAllocator() {}
+  virtual quint8*   allocate( quint32 width, quint32 height, quint32 nbOctets ) = 0;
+  virtual void      release( quint8* buffer, quint32 width, quint32 height,
+                             quint32 nbOctets ) = 0;
+  /**
+   *  \brief  Called each time a frame using this allocator is deep copied.
+   *
+   *  As the frame knows its allocator, the host is told about the copies made
+   *  from within a plugin as well.
+   *  \param  callSite    Where the copy comes from, usually a Q_FUNC_INFO.
+   */
+  virtual void      copied( quint32 width, quint32 height, quint32 nbOctets,
+                            const char* callSite )
+  {
+    Q_UNUSED( width );
+    Q_UNUSED( height );
+    Q_UNUSED( nbOctets );
+    Q_UNUSED( callSite );
+  }
+};
+
+/**
+ *  \brief  Where, and how, a frame is drawn over the frames below it.
+ *
+ *  This belongs to a reference on a frame, and not to the frame itself, so
+ *  changing it never detaches the frame.
+ */
+struct  VideoLayer
+{
+  enum
+    {
+      Opaque = 255
+    };
+  VideoLayer() : opacity( Opaque ), x( 0 ), y( 0 ) {}
+
+  quint8        opacity; ///< From 0 (invisible) to Opaque
+  qint32        x; ///< The frame position in the output, in pixels
+  qint32        y;
+};
+
 struct	VideoFrame : public QSharedData
 {
+  /**
+   *  \brief  The layout of a frame buffer.
+   *
+   *  The values are flags, so a plugin can tell all the formats it accepts at once.
+   *  The YUV formats are 4:2:0, with the chroma at half the width and height.
+   */
+  enum  Format
+    {
+      RGB24 = 1, ///< Packed, 3 octets per pixel, as mapped by Pixel
+      I420 = 2, ///< A Y plane, followed by a U plane and a V plane
+      NV12 = 4, ///< A Y plane, followed by a plane of interleaved U and V
+    };
+
+  /**
+   *  \brief  How the rows of a frame are laid out in its buffer.
+   */
+  enum  Layout
+    {
+      /// The rows are contiguous. This is what VLC reads and writes (through smem
+      /// and imem), so it's the layout of every frame coming from the workflow.
+      Packed,
+      /// Every row, and so every plane, starts on an Alignment boundary.
+      Aligned,
+    };
+  enum
+    {
+      /// Every buffer starts on a cache line, and its size is rounded up to it.
+      Alignment = 64,
+      MaxPlanes = 3,
+    };
+
+  /**
+   *  \brief  Where the samples of one plane are in a frame buffer.
+   */
+  struct  Plane
+  {
+    quint32     offset; ///< From the beginning of the buffer, in octets
+    quint32     pitch; ///< From one row to the next, in octets
+    quint32     width; ///< In samples
+    quint32     height;
+    quint32     sampleSize; ///< In octets
+    quint32     shift; ///< log2 of the subsampling, in both directions
+    quint8      black; ///< The value of a black sample's octets
+  };
+
   ~VideoFrame();
   VideoFrame( void );
   VideoFrame( const VideoFrame& tocopy);
 
+  /**
+   *  \brief  Describe the planes of a frame.
+   *
+   *  \param  planes  Filled with nbPlanes descriptors. It can be NULL.
+   *  \return The number of octets needed by a frame.
+   */
+  static quint32                computePlanes( Format format, Layout layout,
+                                               quint32 width, quint32 height,
+                                               Plane* planes, quint32* nbPlanes );
+  /**
+   *  \return The number of octets needed by a frame.
+   */
+  static quint32                frameSize( Format format, quint32 width, quint32 height,
+                                           Layout layout = Packed );
+  /**
+   *  \return The VLC fourcc for this format.
+   */
+  static const char*            fourcc( Format format );
+
+  /**
+   *  \brief  Set the allocator used by every frame created afterward.
+   *
+   *  When no allocator is set (which is the case from within a plugin), buffers
+   *  are allocated with alignedAlloc().
+   */
+  static void                   setDefaultAllocator( IVideoFrameAllocator* allocator );
+  /**
+   *  \brief  Allocate an Alignment aligned buffer, padded to a multiple of
+   *          Alignment, so a vector loop can always run past the last row.
+   *
+   *  This is used when no allocator is set, and by the allocators themselves.
+   *  The buffer must be freed with alignedFree().
+   */
+  static quint8*                alignedAlloc( quint32 size );
+  static void                   alignedFree( quint8* buffer );
+  /**
+   *  \return The number of deep copies of frames that don't have an allocator,
+   *          in the module (application or plugin) that calls this.
+   *
+   *  Copies of frames that have an allocator are reported to it instead.
+   */
+  static int                    nbDeepCopies();
+  /**
+   *  \brief  Log every deep copy counted by nbDeepCopies(), with its call site.
+   */
+  static void                   setCopyLogging( bool enabled );
+  static bool                   copyLogging();
+
+  /**
+   *  \return The first octet of row y of a plane.
+   */
+  quint8*                       scanLine( quint32 plane, quint32 y )
+  {
+    return frame.octets + planes[plane].offset + y * planes[plane].pitch;
+  }
+  const quint8*                 scanLine( quint32 plane, quint32 y ) const
+  {
+    return frame.octets + planes[plane].offset + y * planes[plane].pitch;
+  }
+
   RawVideoFrame	frame;
   quint32       width;
   quint32       height;
+  /// \warning  Only use nbpixels (and nboctets) to walk through a Packed frame.
   quint32	nbpixels;
   quint32	nboctets;
   qint64        ptsDiff;
+  Format        format;
+  Layout        layout;
+  quint32       nbPlanes;
+  Plane         planes[MaxPlanes];
+  IVideoFrameAllocator*         allocator;
+
+private:
+  friend class  LightVideoFrame;
+  /**
+   *  \brief  Compute the planes and the size of the frame, then allocate it.
+   */
+  void                          allocateOctets( IVideoFrameAllocator* allocator );
+  /**
+   *  \brief  Count a deep copy of frame, or hand it to the frame allocator.
+   */
+  static void                   reportCopy( const VideoFrame& frame,
+                                            const char* callSite );
+  static IVideoFrameAllocator*  s_defaultAllocator;
+  static QAtomicInt             s_nbDeepCopies;
+  static bool                   s_copyLogging;
 };
 
+/**
+ *  \brief  A reference on a frame.
+ *
+ *  Copying a LightVideoFrame only takes a new reference on the same buffer.
+ *  The buffer is written in place as long as it is referenced only once. When
+ *  it is shared, it has to be copied first: this is never done behind your back
+ *  by a read, but only by writable() and clone(), which report the copy along
+ *  with its call site (see VideoFrame::nbDeepCopies() and
+ *  IVideoFrameAllocator::copied()).
+ *  Read a frame through a const reference: the non const operators are kept
+ *  for compatibility, and behave as writable().
+ */
 class	LightVideoFrame
 {
 public:
 
   LightVideoFrame();
   LightVideoFrame( const LightVideoFrame& tocopy );
-  LightVideoFrame( quint32 width, quint32 height );
-  LightVideoFrame( const quint8* tocopy, quint32 width, quint32 height );
+  LightVideoFrame( quint32 width, quint32 height,
+                   VideoFrame::Format format = VideoFrame::RGB24,
+                   VideoFrame::Layout layout = VideoFrame::Packed );
+  /**
+   *  \param  tocopy  A Packed buffer. The frame is Packed as well.
+   */
+  LightVideoFrame( const quint8* tocopy, quint32 width, quint32 height,
+                   VideoFrame::Format format = VideoFrame::RGB24 );
   ~LightVideoFrame();
 
   LightVideoFrame&      operator=( const LightVideoFrame& tocopy );
   const VideoFrame*     operator->( void ) const;
   const VideoFrame&     operator*( void ) const;
+  /**
+   *  \brief  Same as writable(), without a call site.
+   */
   VideoFrame*           operator->( void );
   VideoFrame&           operator*( void );
 
+  /**
+   *  \brief  Give write access to the frame.
+   *
+   *  If the buffer is shared, it is deep copied first, and the copy is reported.
+   *  \param  callSite    Where the copy comes from. Q_FUNC_INFO will do.
+   */
+  VideoFrame&           writable( const char* callSite );
+  /**
+   *  \brief  Give write access to the frame, for a caller that overwrites all of it.
+   *
+   *  If the buffer is shared, a new buffer is allocated, but nothing is copied,
+   *  so the content of the frame is undefined.
+   */
+  VideoFrame&           reallocateIfShared( void );
+  /**
+   *  \brief  A new frame, with the same size, format, layout, layer and allocator.
+   *
+   *  Nothing is copied, so the content of the frame is undefined. This is what
+   *  an effect renders into, when it doesn't work in place.
+   */
+  LightVideoFrame       allocateLike( void ) const;
+  /**
+   *  \return A deep copy of the frame, which is reported as such.
+   */
+  LightVideoFrame       clone( const char* callSite ) const;
+
+  const VideoLayer&     layer( void ) const;
+  void                  setLayer( const VideoLayer& layer );
+  /**
+   *  \return true if the frame is referenced somewhere else, in which case
+   *          writing to it will copy it first.
+   */
+  bool                  isShared( void ) const;
+  /**
+   *  \brief  Paint the whole frame in black, according to its format.
+   */
+  void                  fillBlack( void );
+  /**
+   *  \brief  Return a copy of this frame, converted to another format.
+   *
+   *  This is a plain scalar conversion, using BT.601 limited range YUV. It's
+   *  meant for thumbnails and previews, not for every frame.
+   */
+  LightVideoFrame       converted( VideoFrame::Format format ) const;
+  /**
+   *  \brief  Return a copy of this frame, using another layout.
+   */
+  LightVideoFrame       relaid( VideoFrame::Layout layout ) const;
 private:
+  void                  detach( const char* callSite );
 
-  QSharedDataPointer<VideoFrame>	m_videoFrame;
+  QExplicitlySharedDataPointer<VideoFrame>	m_videoFrame;
+  VideoLayer                            m_layer;
 };
 
 #endif // VIDEOFRAME_H_
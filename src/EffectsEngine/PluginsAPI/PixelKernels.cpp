@@ -0,0 +1,796 @@
+/*****************************************************************************
+ * PixelKernels.cpp: Vectorized pixel processing primitives for the effects
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "PixelKernels.h"
+
+#include <QTime>
+
+#include <string.h>
+
+//The SIMD implementations are compiled for their own instruction set only, so
+//the rest of the code doesn't need any particular compiler flag.
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+# define PIXELKERNELS_X86
+# include <immintrin.h>
+# define TARGET( isa )   __attribute__(( target( isa ) ))
+#endif
+
+struct  PixelKernels::Impl
+{
+    void    (*copy)( quint8* dst, const quint8* src, quint32 nbOctets );
+    void    (*fill)( quint8* dst, quint8 value, quint32 nbOctets );
+    void    (*blend)( quint8* dst, const quint8* src, quint32 nbOctets, quint8 alpha );
+    void    (*addSaturate)( quint8* dst, const quint8* src, quint32 nbOctets );
+    void    (*swapRB)( quint8* dst, const quint8* src, quint32 nbPixels );
+    void    (*maskChannels)( quint8* dst, const quint8* src, quint32 nbPixels,
+                             quint32 channels );
+};
+
+const PixelKernels::Impl*   PixelKernels::s_impl = NULL;
+
+/**
+ *  \brief  Fill pattern with the octet masks of the given channels, for
+ *          size / 3 BGR pixels.
+ */
+static void
+channelsPattern( quint32 channels, quint8* pattern, quint32 size )
+{
+    for ( quint32 i = 0; i < size; i += Pixel::NbComposantes )
+    {
+        //Frames are BGR in memory.
+        pattern[i] = ( channels & PixelKernels::Blue ) ? 0xff : 0;
+        pattern[i + 1] = ( channels & PixelKernels::Green ) ? 0xff : 0;
+        pattern[i + 2] = ( channels & PixelKernels::Red ) ? 0xff : 0;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////
+// Scalar
+/////////////////////////////////////////////////////////////////////
+
+static void
+copyScalar( quint8* dst, const quint8* src, quint32 nbOctets )
+{
+    if ( dst != src )
+        memcpy( dst, src, nbOctets );
+}
+
+static void
+fillScalar( quint8* dst, quint8 value, quint32 nbOctets )
+{
+    memset( dst, value, nbOctets );
+}
+
+static void
+blendScalar( quint8* dst, const quint8* src, quint32 nbOctets, quint8 alpha )
+{
+    quint32     a = alpha;
+    quint32     invA = 255 - alpha;
+
+    //The division by 255 is rounded, using ( t + 128 + ( ( t + 128 ) >> 8 ) ) >> 8,
+    //which is exact for any t lower than 65536. Every path gives the same result.
+    for ( quint32 i = 0; i < nbOctets; ++i )
+    {
+        quint32     t = src[i] * a + dst[i] * invA + 128;
+
+        dst[i] = ( t + ( t >> 8 ) ) >> 8;
+    }
+}
+
+static void
+addSaturateScalar( quint8* dst, const quint8* src, quint32 nbOctets )
+{
+    for ( quint32 i = 0; i < nbOctets; ++i )
+    {
+        quint32     sum = dst[i] + src[i];
+
+        dst[i] = sum > 255 ? 255 : sum;
+    }
+}
+
+static void
+swapRBScalar( quint8* dst, const quint8* src, quint32 nbPixels )
+{
+    for ( quint32 i = 0; i < nbPixels; ++i, dst += 3, src += 3 )
+    {
+        quint8      b = src[0];
+
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = b;
+    }
+}
+
+static void
+maskChannelsScalar( quint8* dst, const quint8* src, quint32 nbPixels, quint32 channels )
+{
+    quint8      mask[Pixel::NbComposantes];
+
+    channelsPattern( channels, mask, Pixel::NbComposantes );
+    for ( quint32 i = 0; i < nbPixels; ++i, dst += 3, src += 3 )
+    {
+        dst[0] = src[0] & mask[0];
+        dst[1] = src[1] & mask[1];
+        dst[2] = src[2] & mask[2];
+    }
+}
+
+static const PixelKernels::Impl     scalarImpl =
+{
+    copyScalar,
+    fillScalar,
+    blendScalar,
+    addSaturateScalar,
+    swapRBScalar,
+    maskChannelsScalar,
+};
+
+#if defined( PIXELKERNELS_X86 )
+
+/////////////////////////////////////////////////////////////////////
+// SSE2
+/////////////////////////////////////////////////////////////////////
+
+TARGET( "sse2" ) static inline __m128i
+blend16SSE2( __m128i s, __m128i d, __m128i vA, __m128i vInvA )
+{
+    __m128i     zero = _mm_setzero_si128();
+    __m128i     round = _mm_set1_epi16( 128 );
+    __m128i     lo = _mm_add_epi16(
+            _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), vA ),
+                           _mm_mullo_epi16( _mm_unpacklo_epi8( d, zero ), vInvA ) ),
+            round );
+    __m128i     hi = _mm_add_epi16(
+            _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), vA ),
+                           _mm_mullo_epi16( _mm_unpackhi_epi8( d, zero ), vInvA ) ),
+            round );
+
+    lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+    hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+    return _mm_packus_epi16( lo, hi );
+}
+
+TARGET( "sse2" ) static void
+blendSSE2( quint8* dst, const quint8* src, quint32 nbOctets, quint8 alpha )
+{
+    quint32     i = 0;
+    __m128i     vA = _mm_set1_epi16( alpha );
+    __m128i     vInvA = _mm_set1_epi16( 255 - alpha );
+
+    for ( ; i + 16 <= nbOctets; i += 16 )
+    {
+        __m128i     s = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+        __m128i     d = _mm_loadu_si128( reinterpret_cast<const __m128i*>( dst + i ) );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ),
+                          blend16SSE2( s, d, vA, vInvA ) );
+    }
+    blendScalar( dst + i, src + i, nbOctets - i, alpha );
+}
+
+TARGET( "sse2" ) static void
+addSaturateSSE2( quint8* dst, const quint8* src, quint32 nbOctets )
+{
+    quint32     i = 0;
+
+    for ( ; i + 16 <= nbOctets; i += 16 )
+    {
+        __m128i     s = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+        __m128i     d = _mm_loadu_si128( reinterpret_cast<const __m128i*>( dst + i ) );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), _mm_adds_epu8( s, d ) );
+    }
+    addSaturateScalar( dst + i, src + i, nbOctets - i );
+}
+
+/**
+ *  Pixels straddle the 16 octets registers, so 4 whole pixels (12 octets) are
+ *  swapped at a time. The 4 remaining octets are stored unchanged, and are
+ *  rewritten by the next iteration, or by the scalar tail.
+ */
+TARGET( "sse2" ) static void
+swapRBSSE2( quint8* dst, const quint8* src, quint32 nbPixels )
+{
+    quint32     nbOctets = nbPixels * Pixel::NbComposantes;
+    quint32     i = 0;
+    __m128i     keep = _mm_setr_epi8( 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0,
+                                      -1, -1, -1, -1 );
+    __m128i     toBlue = _mm_setr_epi8( -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0,
+                                        0, 0, 0, 0 );
+    __m128i     toRed = _mm_slli_si128( toBlue, 2 );
+
+    for ( ; i + 16 <= nbOctets; i += 12 )
+    {
+        __m128i     v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+
+        v = _mm_or_si128( _mm_and_si128( v, keep ),
+                          _mm_or_si128( _mm_and_si128( _mm_srli_si128( v, 2 ), toBlue ),
+                                        _mm_and_si128( _mm_slli_si128( v, 2 ), toRed ) ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), v );
+    }
+    swapRBScalar( dst + i, src + i, nbPixels - i / Pixel::NbComposantes );
+}
+
+/**
+ *  The masks are repeated every 3 registers (16 pixels).
+ */
+TARGET( "sse2" ) static void
+maskChannelsSSE2( quint8* dst, const quint8* src, quint32 nbPixels, quint32 channels )
+{
+    quint32     nbOctets = nbPixels * Pixel::NbComposantes;
+    quint32     i = 0;
+    quint8      pattern[48];
+
+    channelsPattern( channels, pattern, sizeof( pattern ) );
+    __m128i     m0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pattern ) );
+    __m128i     m1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pattern + 16 ) );
+    __m128i     m2 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pattern + 32 ) );
+
+    for ( ; i + 48 <= nbOctets; i += 48 )
+    {
+        const __m128i*  s = reinterpret_cast<const __m128i*>( src + i );
+        __m128i*        d = reinterpret_cast<__m128i*>( dst + i );
+
+        _mm_storeu_si128( d, _mm_and_si128( _mm_loadu_si128( s ), m0 ) );
+        _mm_storeu_si128( d + 1, _mm_and_si128( _mm_loadu_si128( s + 1 ), m1 ) );
+        _mm_storeu_si128( d + 2, _mm_and_si128( _mm_loadu_si128( s + 2 ), m2 ) );
+    }
+    maskChannelsScalar( dst + i, src + i, nbPixels - i / Pixel::NbComposantes, channels );
+}
+
+static const PixelKernels::Impl     sse2Impl =
+{
+    copyScalar,
+    fillScalar,
+    blendSSE2,
+    addSaturateSSE2,
+    swapRBSSE2,
+    maskChannelsSSE2,
+};
+
+/////////////////////////////////////////////////////////////////////
+// SSSE3
+/////////////////////////////////////////////////////////////////////
+
+/**
+ *  Same as the SSE2 version, with a single shuffle instead of the shifts.
+ */
+TARGET( "ssse3" ) static void
+swapRBSSSE3( quint8* dst, const quint8* src, quint32 nbPixels )
+{
+    quint32     nbOctets = nbPixels * Pixel::NbComposantes;
+    quint32     i = 0;
+    __m128i     shuffle = _mm_setr_epi8( 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9,
+                                         12, 13, 14, 15 );
+
+    for ( ; i + 16 <= nbOctets; i += 12 )
+    {
+        __m128i     v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ),
+                          _mm_shuffle_epi8( v, shuffle ) );
+    }
+    swapRBScalar( dst + i, src + i, nbPixels - i / Pixel::NbComposantes );
+}
+
+//The other kernels have nothing to gain from SSSE3.
+static const PixelKernels::Impl     ssse3Impl =
+{
+    copyScalar,
+    fillScalar,
+    blendSSE2,
+    addSaturateSSE2,
+    swapRBSSSE3,
+    maskChannelsSSE2,
+};
+
+/////////////////////////////////////////////////////////////////////
+// AVX2
+/////////////////////////////////////////////////////////////////////
+
+/**
+ *  The unpacks and the pack both work on each 128 bits lane, so the octets
+ *  end up in order.
+ */
+TARGET( "avx2" ) static void
+blendAVX2( quint8* dst, const quint8* src, quint32 nbOctets, quint8 alpha )
+{
+    quint32     i = 0;
+    __m256i     zero = _mm256_setzero_si256();
+    __m256i     round = _mm256_set1_epi16( 128 );
+    __m256i     vA = _mm256_set1_epi16( alpha );
+    __m256i     vInvA = _mm256_set1_epi16( 255 - alpha );
+
+    for ( ; i + 32 <= nbOctets; i += 32 )
+    {
+        __m256i     s = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) );
+        __m256i     d = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( dst + i ) );
+        __m256i     lo = _mm256_add_epi16( _mm256_add_epi16(
+                _mm256_mullo_epi16( _mm256_unpacklo_epi8( s, zero ), vA ),
+                _mm256_mullo_epi16( _mm256_unpacklo_epi8( d, zero ), vInvA ) ), round );
+        __m256i     hi = _mm256_add_epi16( _mm256_add_epi16(
+                _mm256_mullo_epi16( _mm256_unpackhi_epi8( s, zero ), vA ),
+                _mm256_mullo_epi16( _mm256_unpackhi_epi8( d, zero ), vInvA ) ), round );
+
+        lo = _mm256_srli_epi16( _mm256_add_epi16( lo, _mm256_srli_epi16( lo, 8 ) ), 8 );
+        hi = _mm256_srli_epi16( _mm256_add_epi16( hi, _mm256_srli_epi16( hi, 8 ) ), 8 );
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( dst + i ),
+                             _mm256_packus_epi16( lo, hi ) );
+    }
+    blendScalar( dst + i, src + i, nbOctets - i, alpha );
+}
+
+TARGET( "avx2" ) static void
+addSaturateAVX2( quint8* dst, const quint8* src, quint32 nbOctets )
+{
+    quint32     i = 0;
+
+    for ( ; i + 32 <= nbOctets; i += 32 )
+    {
+        __m256i     s = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) );
+        __m256i     d = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( dst + i ) );
+
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( dst + i ),
+                             _mm256_adds_epu8( s, d ) );
+    }
+    addSaturateScalar( dst + i, src + i, nbOctets - i );
+}
+
+/**
+ *  The shuffle works on each 128 bits lane, so each lane is loaded with its own
+ *  4 pixels: 8 pixels (24 octets) are swapped at a time.
+ */
+TARGET( "avx2" ) static void
+swapRBAVX2( quint8* dst, const quint8* src, quint32 nbPixels )
+{
+    quint32     nbOctets = nbPixels * Pixel::NbComposantes;
+    quint32     i = 0;
+    __m256i     shuffle = _mm256_setr_epi8( 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9,
+                                            12, 13, 14, 15,
+                                            2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9,
+                                            12, 13, 14, 15 );
+
+    for ( ; i + 28 <= nbOctets; i += 24 )
+    {
+        __m128i     lo = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+        __m128i     hi = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>( src + i + 12 ) );
+        __m256i     v = _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 );
+
+        v = _mm256_shuffle_epi8( v, shuffle );
+        //The second store overwrites the 4 unchanged octets of the first one.
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ),
+                          _mm256_castsi256_si128( v ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i + 12 ),
+                          _mm256_extracti128_si256( v, 1 ) );
+    }
+    swapRBScalar( dst + i, src + i, nbPixels - i / Pixel::NbComposantes );
+}
+
+/**
+ *  The masks are repeated every 3 registers (32 pixels).
+ */
+TARGET( "avx2" ) static void
+maskChannelsAVX2( quint8* dst, const quint8* src, quint32 nbPixels, quint32 channels )
+{
+    quint32     nbOctets = nbPixels * Pixel::NbComposantes;
+    quint32     i = 0;
+    quint8      pattern[96];
+
+    channelsPattern( channels, pattern, sizeof( pattern ) );
+    const __m256i*  p = reinterpret_cast<const __m256i*>( pattern );
+    __m256i         m0 = _mm256_loadu_si256( p );
+    __m256i         m1 = _mm256_loadu_si256( p + 1 );
+    __m256i         m2 = _mm256_loadu_si256( p + 2 );
+
+    for ( ; i + 96 <= nbOctets; i += 96 )
+    {
+        const __m256i*  s = reinterpret_cast<const __m256i*>( src + i );
+        __m256i*        d = reinterpret_cast<__m256i*>( dst + i );
+
+        _mm256_storeu_si256( d, _mm256_and_si256( _mm256_loadu_si256( s ), m0 ) );
+        _mm256_storeu_si256( d + 1, _mm256_and_si256( _mm256_loadu_si256( s + 1 ), m1 ) );
+        _mm256_storeu_si256( d + 2, _mm256_and_si256( _mm256_loadu_si256( s + 2 ), m2 ) );
+    }
+    maskChannelsSSE2( dst + i, src + i, nbPixels - i / Pixel::NbComposantes, channels );
+}
+
+static const PixelKernels::Impl     avx2Impl =
+{
+    copyScalar,
+    fillScalar,
+    blendAVX2,
+    addSaturateAVX2,
+    swapRBAVX2,
+    maskChannelsAVX2,
+};
+
+#endif // PIXELKERNELS_X86
+
+/////////////////////////////////////////////////////////////////////
+// Dispatch
+/////////////////////////////////////////////////////////////////////
+
+bool
+PixelKernels::isSupported( Isa isa )
+{
+    if ( isa == Scalar )
+        return true;
+#if defined( PIXELKERNELS_X86 )
+    __builtin_cpu_init();
+    switch ( isa )
+    {
+    case SSE2:
+        return __builtin_cpu_supports( "sse2" );
+    case SSSE3:
+        return __builtin_cpu_supports( "ssse3" );
+    case AVX2:
+        return __builtin_cpu_supports( "avx2" );
+    default:
+        break ;
+    }
+#endif
+    return false;
+}
+
+const PixelKernels::Impl*
+PixelKernels::implementation( Isa isa )
+{
+    if ( isSupported( isa ) == false )
+        return NULL;
+#if defined( PIXELKERNELS_X86 )
+    switch ( isa )
+    {
+    case SSE2:
+        return &sse2Impl;
+    case SSSE3:
+        return &ssse3Impl;
+    case AVX2:
+        return &avx2Impl;
+    default:
+        break ;
+    }
+#endif
+    return &scalarImpl;
+}
+
+const PixelKernels::Impl*
+PixelKernels::impl()
+{
+    //Several threads may do this at once, but they all pick the same one.
+    if ( s_impl == NULL )
+    {
+        for ( int i = NbIsa - 1; i >= 0 && s_impl == NULL; --i )
+            s_impl = implementation( static_cast<Isa>( i ) );
+    }
+    return s_impl;
+}
+
+PixelKernels::Isa
+PixelKernels::isa()
+{
+    const Impl*     current = impl();
+
+    for ( int i = NbIsa - 1; i > 0; --i )
+    {
+        if ( implementation( static_cast<Isa>( i ) ) == current )
+            return static_cast<Isa>( i );
+    }
+    return Scalar;
+}
+
+bool
+PixelKernels::setIsa( Isa isa )
+{
+    const Impl*     implem = implementation( isa );
+
+    if ( implem == NULL )
+        return false;
+    s_impl = implem;
+    return true;
+}
+
+const char*
+PixelKernels::isaName( Isa isa )
+{
+    static const char*  names[NbIsa] = { "Scalar", "SSE2", "SSSE3", "AVX2" };
+
+    return names[isa];
+}
+
+const char*
+PixelKernels::kernelName( Kernel kernel )
+{
+    static const char*  names[NbKernels] = { "copy", "fill", "blend", "addSaturate",
+                                             "swapRB", "maskChannels" };
+
+    return names[kernel];
+}
+
+void
+PixelKernels::copy( quint8* dst, const quint8* src, quint32 nbOctets )
+{
+    impl()->copy( dst, src, nbOctets );
+}
+
+void
+PixelKernels::fill( quint8* dst, quint8 value, quint32 nbOctets )
+{
+    impl()->fill( dst, value, nbOctets );
+}
+
+void
+PixelKernels::blend( quint8* dst, const quint8* src, quint32 nbOctets, quint8 alpha )
+{
+    impl()->blend( dst, src, nbOctets, alpha );
+}
+
+void
+PixelKernels::addSaturate( quint8* dst, const quint8* src, quint32 nbOctets )
+{
+    impl()->addSaturate( dst, src, nbOctets );
+}
+
+void
+PixelKernels::swapRB( quint8* dst, const quint8* src, quint32 nbPixels )
+{
+    impl()->swapRB( dst, src, nbPixels );
+}
+
+void
+PixelKernels::maskChannels( quint8* dst, const quint8* src, quint32 nbPixels,
+                            quint32 channels )
+{
+    impl()->maskChannels( dst, src, nbPixels, channels );
+}
+
+double
+PixelKernels::measure( Kernel kernel, Isa isa, quint32 nbOctets /*= 8 * 1024 * 1024*/ )
+{
+    const Impl*     implem = implementation( isa );
+
+    if ( implem == NULL || nbOctets == 0 )
+        return 0;
+    quint32         nbPixels = nbOctets / Pixel::NbComposantes;
+    quint8*         src = VideoFrame::alignedAlloc( nbOctets );
+    quint8*         dst = VideoFrame::alignedAlloc( nbOctets );
+    QTime           timer;
+    int             nbRuns = 0;
+    int             elapsed;
+
+    //Make sure the pages are mapped before measuring anything.
+    memset( src, 0x55, nbOctets );
+    memset( dst, 0xaa, nbOctets );
+    timer.start();
+    do
+    {
+        switch ( kernel )
+        {
+        case Copy:
+            implem->copy( dst, src, nbOctets );
+            break ;
+        case Fill:
+            implem->fill( dst, 0x10, nbOctets );
+            break ;
+        case Blend:
+            implem->blend( dst, src, nbOctets, 0x80 );
+            break ;
+        case AddSaturate:
+            implem->addSaturate( dst, src, nbOctets );
+            break ;
+        case SwapRB:
+            implem->swapRB( dst, src, nbPixels );
+            break ;
+        case MaskChannels:
+            implem->maskChannels( dst, src, nbPixels, Green );
+            break ;
+        default:
+            break ;
+        }
+        ++nbRuns;
+        elapsed = timer.elapsed();
+    } while ( elapsed < 50 );
+    VideoFrame::alignedFree( src );
+    VideoFrame::alignedFree( dst );
+    return (double)nbOctets * nbRuns / ( elapsed / 1000.0 ) / 1e9;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Frame kernels
+/////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    /**
+     *  \brief  A row kernel, applied by forEachRow().
+     */
+    struct  RowOp
+    {
+        virtual ~RowOp() {}
+        virtual void    operator()( quint8* dst, const quint8* src,
+                                    quint32 nbOctets ) const = 0;
+    };
+
+    struct  CopyOp : public RowOp
+    {
+        virtual void    operator()( quint8* dst, const quint8* src,
+                                    quint32 nbOctets ) const
+        {
+            PixelKernels::copy( dst, src, nbOctets );
+        }
+    };
+
+    struct  BlendOp : public RowOp
+    {
+        BlendOp( quint8 a ) : alpha( a ) {}
+        virtual void    operator()( quint8* dst, const quint8* src,
+                                    quint32 nbOctets ) const
+        {
+            PixelKernels::blend( dst, src, nbOctets, alpha );
+        }
+        quint8  alpha;
+    };
+
+    struct  AddSaturateOp : public RowOp
+    {
+        virtual void    operator()( quint8* dst, const quint8* src,
+                                    quint32 nbOctets ) const
+        {
+            PixelKernels::addSaturate( dst, src, nbOctets );
+        }
+    };
+
+    struct  SwapRBOp : public RowOp
+    {
+        virtual void    operator()( quint8* dst, const quint8* src,
+                                    quint32 nbOctets ) const
+        {
+            PixelKernels::swapRB( dst, src, nbOctets / Pixel::NbComposantes );
+        }
+    };
+
+    struct  MaskChannelsOp : public RowOp
+    {
+        MaskChannelsOp( quint32 c ) : channels( c ) {}
+        virtual void    operator()( quint8* dst, const quint8* src,
+                                    quint32 nbOctets ) const
+        {
+            PixelKernels::maskChannels( dst, src, nbOctets / Pixel::NbComposantes,
+                                        channels );
+        }
+        quint32 channels;
+    };
+}
+
+/**
+ *  \brief  Apply op to the rows of planes [first; last[, which are in the rows
+ *          [firstRow; firstRow + nbRows[ of the first plane.
+ *
+ *  The rows of a subsampled plane are rounded up on both ends, so consecutive
+ *  ranges of rows never share a chroma row.
+ *  When both frames are Packed, the rows are contiguous, so op is called once
+ *  per plane instead.
+ */
+static void
+forEachRow( VideoFrame& dst, const VideoFrame& src, quint32 first, quint32 last,
+            quint32 firstRow, quint32 nbRows, const RowOp& op )
+{
+    Q_ASSERT( dst.format == src.format && dst.width == src.width &&
+              dst.height == src.height );
+    Q_ASSERT( firstRow + nbRows <= src.height );
+    if ( dst.frame.octets == NULL || src.frame.octets == NULL )
+        return ;
+    for ( quint32 p = first; p < last; ++p )
+    {
+        const VideoFrame::Plane&    plane = src.planes[p];
+        quint32                     rowSize = plane.width * plane.sampleSize;
+        quint32                     round = ( 1 << plane.shift ) - 1;
+        quint32                     y = ( firstRow + round ) >> plane.shift;
+        quint32                     end = ( firstRow + nbRows + round ) >> plane.shift;
+
+        if ( y >= end )
+            continue ;
+        if ( dst.layout == VideoFrame::Packed && src.layout == VideoFrame::Packed )
+            op( dst.scanLine( p, y ), src.scanLine( p, y ), rowSize * ( end - y ) );
+        else
+        {
+            for ( ; y < end; ++y )
+                op( dst.scanLine( p, y ), src.scanLine( p, y ), rowSize );
+        }
+    }
+}
+
+void
+PlaneKernels::copy( VideoFrame& dst, const VideoFrame& src )
+{
+    forEachRow( dst, src, 0, src.nbPlanes, 0, src.height, CopyOp() );
+}
+
+void
+PlaneKernels::fillBlack( VideoFrame& dst )
+{
+    if ( dst.frame.octets == NULL )
+        return ;
+    //A plane is contiguous, padding included.
+    for ( quint32 p = 0; p < dst.nbPlanes; ++p )
+    {
+        const VideoFrame::Plane&    plane = dst.planes[p];
+
+        PixelKernels::fill( dst.frame.octets + plane.offset, plane.black,
+                            plane.pitch * plane.height );
+    }
+}
+
+void
+PlaneKernels::blend( VideoFrame& dst, const VideoFrame& src, quint8 alpha )
+{
+    forEachRow( dst, src, 0, src.nbPlanes, 0, src.height, BlendOp( alpha ) );
+}
+
+void
+PlaneKernels::addSaturate( VideoFrame& dst, const VideoFrame& src )
+{
+    forEachRow( dst, src, 0, src.nbPlanes, 0, src.height, AddSaturateOp() );
+}
+
+void
+PlaneKernels::grayscale( VideoFrame& dst, const VideoFrame& src )
+{
+    forEachRow( dst, src, 0, 1, 0, src.height, CopyOp() );
+    for ( quint32 p = 1; p < dst.nbPlanes; ++p )
+    {
+        const VideoFrame::Plane&    plane = dst.planes[p];
+
+        PixelKernels::fill( dst.frame.octets + plane.offset, plane.black,
+                            plane.pitch * plane.height );
+    }
+}
+
+void
+FrameKernels<VideoFrame::RGB24>::swapRB( VideoFrame& dst, const VideoFrame& src )
+{
+    swapRB( dst, src, 0, src.height );
+}
+
+void
+FrameKernels<VideoFrame::RGB24>::swapRB( VideoFrame& dst, const VideoFrame& src,
+                                         quint32 firstRow, quint32 nbRows )
+{
+    Q_ASSERT( src.format == VideoFrame::RGB24 );
+    forEachRow( dst, src, 0, 1, firstRow, nbRows, SwapRBOp() );
+}
+
+void
+FrameKernels<VideoFrame::RGB24>::maskChannels( VideoFrame& dst, const VideoFrame& src,
+                                               quint32 channels )
+{
+    maskChannels( dst, src, channels, 0, src.height );
+}
+
+void
+FrameKernels<VideoFrame::RGB24>::maskChannels( VideoFrame& dst, const VideoFrame& src,
+                                               quint32 channels, quint32 firstRow,
+                                               quint32 nbRows )
+{
+    Q_ASSERT( src.format == VideoFrame::RGB24 );
+    forEachRow( dst, src, 0, 1, firstRow, nbRows, MaskChannelsOp( channels ) );
+}
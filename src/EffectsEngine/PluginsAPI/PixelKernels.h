@@ -0,0 +1,196 @@
+/*****************************************************************************
+ * PixelKernels.h: Vectorized pixel processing primitives for the effects
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef PIXELKERNELS_H_
+#define PIXELKERNELS_H_
+
+#include "LightVideoFrame.h"
+
+/**
+ *  \brief  Row kernels, implemented for several instruction sets.
+ *
+ *  The best implementation the CPU supports is picked the first time a kernel
+ *  is used, so a plugin never has to write intrinsics nor to check the CPU
+ *  itself. Every implementation gives the exact same results.
+ *  A kernel can run in place (dst == src), but the buffers must not partially
+ *  overlap. The buffers don't have to be aligned, although aligned buffers
+ *  (as given by VideoFrame) are faster.
+ */
+class   PixelKernels
+{
+public:
+    enum    Isa
+    {
+        Scalar,
+        SSE2,
+        SSSE3,
+        AVX2,
+        NbIsa,
+    };
+    enum    Kernel
+    {
+        Copy,
+        Fill,
+        Blend,
+        AddSaturate,
+        SwapRB,
+        MaskChannels,
+        NbKernels,
+    };
+    /**
+     *  \brief  The channels of an RGB24 pixel, as flags.
+     */
+    enum    Channel
+    {
+        Red = 1,
+        Green = 2,
+        Blue = 4,
+    };
+
+    /**
+     *  \return The instruction set the kernels currently use.
+     */
+    static Isa              isa();
+    /**
+     *  \return true if the CPU, and the compiler, support this instruction set.
+     */
+    static bool             isSupported( Isa isa );
+    /**
+     *  \brief  Force an instruction set, ie. to compare the implementations.
+     *
+     *  \return false if it's not supported, in which case nothing changes.
+     */
+    static bool             setIsa( Isa isa );
+    static const char*      isaName( Isa isa );
+    static const char*      kernelName( Kernel kernel );
+
+    /**
+     *  \brief  copy() and fill() are memcpy and memset, which libc already
+     *          vectorizes better than a plain loop would.
+     */
+    static void             copy( quint8* dst, const quint8* src, quint32 nbOctets );
+    static void             fill( quint8* dst, quint8 value, quint32 nbOctets );
+    /**
+     *  \brief  dst = ( src * alpha + dst * ( 255 - alpha ) ) / 255, rounded.
+     */
+    static void             blend( quint8* dst, const quint8* src, quint32 nbOctets,
+                                   quint8 alpha );
+    /**
+     *  \brief  dst = min( dst + src, 255 )
+     */
+    static void             addSaturate( quint8* dst, const quint8* src,
+                                         quint32 nbOctets );
+    /**
+     *  \brief  Swap the red and blue channels of RGB24 pixels.
+     */
+    static void             swapRB( quint8* dst, const quint8* src, quint32 nbPixels );
+    /**
+     *  \brief  Keep the given channels of RGB24 pixels, and zero the others.
+     *  \param  channels    A combination of Channel flags.
+     */
+    static void             maskChannels( quint8* dst, const quint8* src,
+                                          quint32 nbPixels, quint32 channels );
+
+    /**
+     *  \brief  Measure the throughput of a kernel, with a given instruction set.
+     *
+     *  The kernel runs on nbOctets long buffers (which should be larger than
+     *  the caches to measure the memory throughput) for at least 50ms.
+     *  \return The number of GB processed per second, or 0 if the instruction
+     *          set isn't supported.
+     */
+    static double           measure( Kernel kernel, Isa isa,
+                                     quint32 nbOctets = 8 * 1024 * 1024 );
+
+    struct  Impl;
+
+private:
+    static const Impl*      impl();
+    static const Impl*      implementation( Isa isa );
+
+    static const Impl*      s_impl;
+};
+
+/**
+ *  \brief  Frame kernels, which apply the row kernels to each plane.
+ *
+ *  They take care of the planes and of their pitch, so they work with any
+ *  layout. The source and destination frames must have the same size and
+ *  format, but not necessarily the same layout.
+ */
+class   PlaneKernels
+{
+public:
+    static void             copy( VideoFrame& dst, const VideoFrame& src );
+    static void             fillBlack( VideoFrame& dst );
+    static void             blend( VideoFrame& dst, const VideoFrame& src, quint8 alpha );
+    static void             addSaturate( VideoFrame& dst, const VideoFrame& src );
+
+protected:
+    /**
+     *  \brief  Copy the luma, and set the chroma to neutral: what's left is gray.
+     */
+    static void             grayscale( VideoFrame& dst, const VideoFrame& src );
+};
+
+/**
+ *  \brief  The frame kernels that make sense for a given pixel format.
+ *
+ *  Using a kernel with a format that doesn't support it (ie. swapping the red
+ *  and blue channels of a YUV frame) doesn't compile.
+ */
+template <int Format>
+class   FrameKernels;
+
+template <>
+class   FrameKernels<VideoFrame::RGB24> : public PlaneKernels
+{
+public:
+    static void             swapRB( VideoFrame& dst, const VideoFrame& src );
+    static void             maskChannels( VideoFrame& dst, const VideoFrame& src,
+                                          quint32 channels );
+    /**
+     *  \brief  Only process the rows [firstRow; firstRow + nbRows[, so a frame
+     *          can be split between several threads.
+     */
+    static void             swapRB( VideoFrame& dst, const VideoFrame& src,
+                                    quint32 firstRow, quint32 nbRows );
+    static void             maskChannels( VideoFrame& dst, const VideoFrame& src,
+                                          quint32 channels, quint32 firstRow,
+                                          quint32 nbRows );
+};
+
+template <>
+class   FrameKernels<VideoFrame::I420> : public PlaneKernels
+{
+public:
+    using PlaneKernels::grayscale;
+};
+
+template <>
+class   FrameKernels<VideoFrame::NV12> : public PlaneKernels
+{
+public:
+    using PlaneKernels::grayscale;
+};
+
+#endif // PIXELKERNELS_H_
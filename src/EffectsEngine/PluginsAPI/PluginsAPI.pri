@@ -3,6 +3,11 @@ HEADERS	+=  InSlot.hpp \
             LightVideoFrame.h \
             IEffectNode.h \
             IEffectPluginCreator.h \
-            IEffectPlugin.h
+            IEffectPlugin.h \
+            VideoCompositor.h \
+            PixelKernels.h \
+            SlotHandle.hpp
 
-SOURCES	+=    LightVideoFrame.cpp
+SOURCES	+=    LightVideoFrame.cpp \
+              VideoCompositor.cpp \
+              PixelKernels.cpp
@@ -0,0 +1,93 @@
+/*****************************************************************************
+ * SlotHandle.hpp: Slots resolved once, for the plugins render methods
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef SLOTHANDLE_HPP_
+#define SLOTHANDLE_HPP_
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ *  \brief  A slot resolved once, usually in IEffectPlugin::init().
+ *
+ *  Getting a slot by name or by id goes through a map, which isn't something
+ *  to do on every frame. Getting it through a handle is a pointer dereference.
+ *  A handle stays valid until its slot is removed.
+ */
+template<typename T>
+class	SlotHandle
+{
+public:
+
+  SlotHandle( void ) : m_slot( NULL ) {}
+  SlotHandle( T* slot ) : m_slot( slot ) {}
+
+  T&            operator*( void ) const
+  {
+    Q_ASSERT( m_slot != NULL );
+    return *m_slot;
+  }
+  T*            operator->( void ) const
+  {
+    Q_ASSERT( m_slot != NULL );
+    return m_slot;
+  }
+  bool          isValid( void ) const { return m_slot != NULL; }
+
+private:
+
+  T*            m_slot;
+};
+
+/**
+ *  \brief  All the slots of a kind, by id, resolved once.
+ *
+ *  The slot with id i is at index i - 1, and is NULL if it has been removed.
+ *  The array is the one of the node, so it follows the slots created and
+ *  removed after the handle has been resolved.
+ */
+template<typename T>
+class	SlotArrayHandle
+{
+public:
+
+  SlotArrayHandle( void ) : m_slots( NULL ) {}
+  explicit SlotArrayHandle( const QVector<T*>& array ) : m_slots( &array ) {}
+
+  quint32       size( void ) const
+  {
+    Q_ASSERT( m_slots != NULL );
+    return m_slots->size();
+  }
+  T*            operator[]( quint32 index ) const
+  {
+    Q_ASSERT( m_slots != NULL );
+    return m_slots->at( index );
+  }
+  bool          isValid( void ) const { return m_slots != NULL; }
+
+private:
+
+  const QVector<T*>*    m_slots;
+};
+
+#endif // SLOTHANDLE_HPP_
@@ -0,0 +1,218 @@
+/*****************************************************************************
+ * VideoCompositor.cpp: Blends the stacked video layers together
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "VideoCompositor.h"
+#include "PixelKernels.h"
+
+#include <string.h>
+
+/**
+ *  \brief  Convert a position to a subsampled plane, rounding it down even when
+ *          it's negative.
+ */
+static inline qint64
+subsample( qint64 position, quint32 shift )
+{
+    if ( position >= 0 )
+        return position >> shift;
+    return -( ( -position + ( 1 << shift ) - 1 ) >> shift );
+}
+
+VideoCompositor::VideoCompositor() :
+        m_currentOutput( 0 )
+{
+    m_layers.reserve( 64 );
+    resetStats();
+}
+
+void
+VideoCompositor::addLayer( const LightVideoFrame& frame )
+{
+    m_layers.append( &frame );
+}
+
+const LightVideoFrame&
+VideoCompositor::composite()
+{
+    quint32             width = 0;
+    quint32             height = 0;
+    int                 nbLayers = m_layers.size();
+    int                 base = -1;
+    int                 top = -1;
+    VideoFrame::Format  format = VideoFrame::RGB24;
+
+    for ( int i = nbLayers - 1; i >= 0 && top == -1; --i )
+    {
+        if ( (*m_layers[i])->frame.octets != NULL && m_layers[i]->layer().opacity != 0 )
+        {
+            top = i;
+            format = (*m_layers[i])->format;
+        }
+    }
+    if ( top == -1 )
+    {
+        m_layers.clear();
+        return m_nullFrame;
+    }
+    foreach ( const LightVideoFrame* frame, m_layers )
+    {
+        if ( isVisible( *frame, format ) == false )
+            continue ;
+        if ( (*frame)->width > width )
+            width = (*frame)->width;
+        if ( (*frame)->height > height )
+            height = (*frame)->height;
+    }
+    //Look for the highest layer that hides all the others.
+    for ( int i = top; i >= 0; --i )
+    {
+        if ( isVisible( *m_layers[i], format ) == true &&
+             covers( *m_layers[i], width, height ) == true )
+        {
+            base = i;
+            break ;
+        }
+    }
+    for ( int i = 0; i < base; ++i )
+    {
+        if ( isVisible( *m_layers[i], format ) == true )
+            ++m_stats.nbOccludedLayers;
+    }
+    const LightVideoFrame&  topFrame = *m_layers[top];
+    if ( base == top && topFrame.layer().x == 0 && topFrame.layer().y == 0 &&
+         topFrame->width == width && topFrame->height == height )
+    {
+        ++m_stats.nbForwarded;
+        m_layers.clear();
+        return topFrame;
+    }
+
+    LightVideoFrame&        out = outputFrame( width, height, format );
+    //The output frame isn't shared, so this never copies it.
+    VideoFrame&             outFrame = out.writable( Q_FUNC_INFO );
+    quint8*                 output = outFrame.frame.octets;
+    int                     first = ( base == -1 ? 0 : base );
+
+    for ( quint32 p = 0; p < outFrame.nbPlanes; ++p )
+    {
+        const VideoFrame::Plane&    plane = outFrame.planes[p];
+        quint32                     rowSize = plane.width * plane.sampleSize;
+
+        for ( quint32 y = 0; y < plane.height; ++y )
+        {
+            quint8*     row = output + plane.offset + y * plane.pitch;
+
+            if ( base == -1 )
+                PixelKernels::fill( row, plane.black, rowSize );
+            for ( int i = first; i <= top; ++i )
+            {
+                if ( isVisible( *m_layers[i], format ) == true )
+                    drawRow( row, p, y, plane, *m_layers[i] );
+            }
+        }
+    }
+    for ( int i = first; i <= top; ++i )
+    {
+        if ( isVisible( *m_layers[i], format ) == true )
+            ++m_stats.nbBlendedLayers;
+    }
+    outFrame.ptsDiff = topFrame->ptsDiff;
+    ++m_stats.nbComposited;
+    m_layers.clear();
+    return out;
+}
+
+LightVideoFrame&
+VideoCompositor::outputFrame( quint32 width, quint32 height, VideoFrame::Format format )
+{
+    //Don't write in a frame that's still used downstream, as it would be copied.
+    for ( int i = 0; i < NbOutputFrames; ++i )
+    {
+        m_currentOutput = ( m_currentOutput + 1 ) % NbOutputFrames;
+        LightVideoFrame&        out = m_outputs[m_currentOutput];
+        const LightVideoFrame&  constOut = out;
+
+        if ( out.isShared() == false && constOut->frame.octets != NULL &&
+             constOut->width == width && constOut->height == height &&
+             constOut->format == format && constOut->layout == VideoFrame::Packed )
+            return out;
+    }
+    LightVideoFrame&    out = m_outputs[m_currentOutput];
+    out = LightVideoFrame( width, height, format );
+    return out;
+}
+
+bool
+VideoCompositor::isVisible( const LightVideoFrame& frame, VideoFrame::Format format )
+{
+    return frame->frame.octets != NULL && frame.layer().opacity != 0 &&
+            frame->format == format;
+}
+
+bool
+VideoCompositor::covers( const LightVideoFrame& frame, quint32 width, quint32 height )
+{
+    const VideoLayer&   layer = frame.layer();
+
+    return layer.opacity == VideoLayer::Opaque && layer.x <= 0 && layer.y <= 0 &&
+            layer.x + (qint64)frame->width >= width &&
+            layer.y + (qint64)frame->height >= height;
+}
+
+void
+VideoCompositor::drawRow( quint8* dst, int plane, quint32 y,
+                          const VideoFrame::Plane& outPlane,
+                          const LightVideoFrame& frame )
+{
+    const VideoLayer&           layer = frame.layer();
+    const VideoFrame::Plane&    src = frame->planes[plane];
+    qint64                      x = subsample( layer.x, src.shift );
+    qint64                      srcY = (qint64)y - subsample( layer.y, src.shift );
+    qint64                      begin;
+    qint64                      end;
+
+    begin = qMax( (qint64)0, x );
+    end = qMin( (qint64)outPlane.width, x + (qint64)src.width );
+    if ( srcY < 0 || srcY >= src.height || begin >= end )
+        return ;
+    const quint8*   data = frame->scanLine( plane, srcY ) +
+                           ( begin - x ) * src.sampleSize;
+    quint32         nbOctets = ( end - begin ) * src.sampleSize;
+
+    dst += begin * src.sampleSize;
+    if ( layer.opacity == VideoLayer::Opaque )
+        PixelKernels::copy( dst, data, nbOctets );
+    else
+        PixelKernels::blend( dst, data, nbOctets, layer.opacity );
+}
+
+VideoCompositor::Stats
+VideoCompositor::stats() const
+{
+    return m_stats;
+}
+
+void
+VideoCompositor::resetStats()
+{
+    memset( &m_stats, 0, sizeof( m_stats ) );
+}
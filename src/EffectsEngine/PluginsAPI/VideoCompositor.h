@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * VideoCompositor.h: Blends the stacked video layers together
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VIDEOCOMPOSITOR_H_
+#define VIDEOCOMPOSITOR_H_
+
+#include "LightVideoFrame.h"
+
+#include <QVector>
+
+/**
+ *  \brief  Draws a stack of frames over each other, according to their layer.
+ *
+ *  The layers are added from the bottom one to the top one, then composited in
+ *  a single pass: each output row is written once, with every layer blended
+ *  into it while it's still in cache.
+ *  Whatever is below a fully opaque layer that covers the whole output is
+ *  never read. When that layer is the only one visible, and exactly fits the
+ *  output, it is forwarded as is, without any copy.
+ *  The output has the size and the format of the largest visible layer.
+ *  Uncovered areas are black. Layers of another format than the top one are
+ *  ignored, as they can't be converted on the fly.
+ */
+class   VideoCompositor
+{
+public:
+    /**
+     *  \brief  The number of output frames that are reused.
+     *
+     *  An output frame is still referenced downstream for a while (at least by
+     *  the output slot, until the next frame). A new frame is only allocated
+     *  when all of them are still in use.
+     */
+    static const int        NbOutputFrames = 4;
+
+    struct  Stats
+    {
+        /// \brief  The frames that had to be blended.
+        qint64      nbComposited;
+        /// \brief  The frames that were forwarded without any copy.
+        qint64      nbForwarded;
+        qint64      nbBlendedLayers;
+        /// \brief  The layers that were skipped, because an opaque layer hid them.
+        qint64      nbOccludedLayers;
+    };
+
+    VideoCompositor();
+
+    /**
+     *  \brief  Stack a layer over the previous ones.
+     *
+     *  The frame is not copied, so it must stay valid until composite() is called.
+     */
+    void                    addLayer( const LightVideoFrame& frame );
+    /**
+     *  \brief  Composite the stacked layers, and empty the stack.
+     *
+     *  \return The composited frame, which may be one of the layers. This is
+     *          a null frame when there was nothing to draw.
+     */
+    const LightVideoFrame&  composite();
+
+    Stats                   stats() const;
+    void                    resetStats();
+
+private:
+    /**
+     *  \brief  Return an output frame that isn't used anymore.
+     *
+     *  The output frames are Packed, as they're usually given to imem.
+     */
+    LightVideoFrame&        outputFrame( quint32 width, quint32 height,
+                                         VideoFrame::Format format );
+    static bool             isVisible( const LightVideoFrame& frame,
+                                       VideoFrame::Format format );
+    /**
+     *  \return true if the frame hides everything below it.
+     */
+    static bool             covers( const LightVideoFrame& frame, quint32 width,
+                                    quint32 height );
+    /**
+     *  \brief  Draw the part of a layer that is on row y of an output plane.
+     */
+    static void             drawRow( quint8* dst, int plane, quint32 y,
+                                     const VideoFrame::Plane& outPlane,
+                                     const LightVideoFrame& frame );
+
+private:
+    QVector<const LightVideoFrame*>     m_layers;
+    LightVideoFrame                     m_outputs[NbOutputFrames];
+    int                                 m_currentOutput;
+    LightVideoFrame                     m_nullFrame;
+    Stats                               m_stats;
+};
+
+#endif // VIDEOCOMPOSITOR_H_
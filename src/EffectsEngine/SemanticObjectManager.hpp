@@ -28,6 +28,7 @@
 #include <QDebug>
 #include <QString>
 #include <QMap>
+#include <QVector>
 
 class EffectNode;
 
@@ -122,6 +123,9 @@ public:
         m_objectByName[ objectName ] = newObject;
         m_objectById[ objectId ] = newObject;
         m_nameById[ objectId ] = objectName;
+        if ( objectId > (quint32)m_objects.size() )
+            m_objects.resize( objectId );
+        m_objects[ objectId - 1 ] = newObject;
     }
 
     inline void                        createObject( const QString & objectName )
@@ -149,6 +153,9 @@ public:
         m_objectByName[ objectName ] = newObject;
         m_objectById[ objectId ] = newObject;
         m_nameById[ objectId ] = objectName;
+        if ( objectId > (quint32)m_objects.size() )
+            m_objects.resize( objectId );
+        m_objects[ objectId - 1 ] = newObject;
     }
 
     inline bool                        deleteObject( quint32 objectId )
@@ -172,12 +179,14 @@ public:
                 if ( objectId <  ( m_higherFreeId - 1 ) )
                 {
                     m_objectById[ objectId ] = NULL;
+                    m_objects[ objectId - 1 ] = NULL;
                     ++m_mapHoles;
                 }
                 else
                 {
                     m_objectById.erase( itid );
                     --m_higherFreeId;
+                    m_objects.resize( m_higherFreeId - 1 );
                 }
             }
             else
@@ -220,12 +229,14 @@ public:
                 if ( objectId <  ( m_higherFreeId - 1 ) )
                 {
                     m_objectById[ objectId ] = NULL;
+                    m_objects[ objectId - 1 ] = NULL;
                     ++m_mapHoles;
                 }
                 else
                 {
                     m_objectById.erase( itid );
                     --m_higherFreeId;
+                    m_objects.resize( m_higherFreeId - 1 );
                 }
             }
             else
@@ -250,11 +261,9 @@ public:
 
     inline T*                          getObject( quint32 objectId ) const
     {
-        typename QMap<quint32, T*>::const_iterator    it = m_objectById.find( objectId );
-
-        if ( it != m_objectById.end() )
-            return it.value();
-        return NULL;
+        if ( objectId == 0 || objectId > (quint32)m_objects.size() )
+            return NULL;
+        return m_objects[ objectId - 1 ];
     }
 
     inline T*                          getObject( const QString & objectName ) const
@@ -271,11 +280,23 @@ public:
         return m_objectByName.values();
     }
 
+    /**
+     *  \brief  The objects by id: the object with id i is at index i - 1, and
+     *          is NULL if it has been deleted.
+     *
+     *  The array is kept up to date, so a reference on it can be kept.
+     */
+    inline const QVector<T*>&          getObjectsArray( void ) const
+    {
+        return m_objects;
+    }
+
 private:
 
     QMap<quint32, T*>           m_objectById;
     QMap<QString, T*>           m_objectByName;
     QMap<quint32, QString>      m_nameById;
+    QVector<T*>                 m_objects;
     quint32                     m_higherFreeId;
     quint32                     m_mapHoles;
     EffectNode*                 m_father;
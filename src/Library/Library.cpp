@@ -31,7 +31,10 @@
 #include "Library.h"
 #include "Media.h"
 #include "MetaDataManager.h"
+#include "ProxyManager.h"
+#include "SeekIndex.h"
 
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QDomElement>
@@ -62,12 +65,23 @@ Library::clip( const QUuid& uuid )
         return clip;
     }
 
+    Media*  parent = m_clipParents.value( uuid, NULL );
+    if ( parent != NULL )
+    {
+        if ( parent->clips()->contains( uuid ) )
+            return getElementByUuid( *parent->clips(), uuid );
+        m_clipParents.remove( uuid );
+    }
+
     QUuid mediaUuid;
     foreach( mediaUuid, m_medias.keys() )
     {
         Media* media = m_medias.value( mediaUuid );
         if ( media != NULL && media->clips()->contains( uuid ) )
+        {
+            m_clipParents[uuid] = media;
             return getElementByUuid( *media->clips(), uuid );
+        }
     }
     return NULL;
 }
@@ -96,22 +110,23 @@ void
 Library::deleteMedia( const QUuid& uuid )
 {
     if ( m_medias.contains( uuid ) )
-        delete m_medias.take( uuid );
+    {
+        Media*  media = m_medias.take( uuid );
+        m_mediasByPath.remove( media->fileInfo()->absoluteFilePath() );
+        foreach( const QUuid& clipUuid, media->clips()->keys() )
+            m_clipParents.remove( clipUuid );
+        ProxyManager::getInstance()->cancel( media );
+        delete media;
+    }
 }
 
 void
 Library::addMedia( const QFileInfo& fileInfo, const QString& uuid )
 {
+    if ( mediaAlreadyLoaded( fileInfo ) == true )
+        return ;
     Media* media = new Media( fileInfo.filePath(), uuid );
 
-    foreach( Media* it, m_medias.values() )
-    {
-        if ( it->fileInfo()->filePath() == media->fileInfo()->filePath() )
-        {
-            delete media;
-            return;
-        }
-    }
     MetaDataManager::getInstance()->computeMediaMetadata( media );
     addMedia( media );
 }
@@ -121,6 +136,8 @@ void
 Library::addMedia( Media *media )
 {
     m_medias[media->uuid()] = media;
+    m_mediasByPath[media->fileInfo()->absoluteFilePath()] = media;
+    ProxyManager::getInstance()->requestProxy( media );
     emit newMediaLoaded( media );
 }
 
@@ -129,17 +146,13 @@ Library::addClip( Clip* clip )
 {
     Media* media = m_medias[clip->getParent()->uuid()];
     media->addClip( clip );
+    m_clipParents[clip->uuid()] = media;
 }
 
 bool
 Library::mediaAlreadyLoaded( const QFileInfo& fileInfo )
 {
-    foreach( Media* media, m_medias.values() )
-    {
-        if ( media->fileInfo()->filePath() == fileInfo.filePath() )
-            return true;
-    }
-    return false;
+    return m_mediasByPath.contains( fileInfo.absoluteFilePath() );
 }
 
 void
@@ -158,6 +171,8 @@ Library::loadProject( const QDomElement& medias )
         QDomElement mediaProperty = elem.firstChild().toElement();
         QString     path;
         QString     uuid;
+        QDomElement seekIndex;
+        QDomElement proxy;
 
         while ( mediaProperty.isNull() == false )
         {
@@ -166,6 +181,10 @@ Library::loadProject( const QDomElement& medias )
                 path = mediaProperty.text();
             else if ( tagName == "uuid" )
                 uuid = mediaProperty.text();
+            else if ( tagName == "seekIndex" )
+                seekIndex = mediaProperty;
+            else if ( tagName == "proxy" )
+                proxy = mediaProperty;
             else if ( tagName == "clips" )
             {
                 QDomElement clip = mediaProperty.firstChild().toElement();
@@ -180,28 +199,29 @@ Library::loadProject( const QDomElement& medias )
             mediaProperty = mediaProperty.nextSibling().toElement();
         }
         //FIXME: This is verry redondant...
-        if ( mediaAlreadyLoaded( path ) == true )
+        QString absolutePath = QFileInfo( path ).absoluteFilePath();
+        Media*  loadedMedia = m_mediasByPath.value( absolutePath, NULL );
+        if ( loadedMedia != NULL )
         {
-            Media*   media;
-            QHash<QUuid, Media*>::iterator   it = m_medias.begin();
-            QHash<QUuid, Media*>::iterator   end = m_medias.end();
-
-            for ( ; it != end; ++it )
-            {
-                if ( it.value()->fileInfo()->absoluteFilePath() == path )
-                {
-                    media = it.value();
-                    media->setUuid( QUuid( uuid ) );
-                    m_medias.erase( it );
-                    m_medias[media->uuid()] = media;
-                    break ;
-                }
-            }
+            //The path stays the same, so only the uuid index has to be updated.
+            m_medias.remove( loadedMedia->uuid() );
+            loadedMedia->setUuid( QUuid( uuid ) );
+            m_medias[loadedMedia->uuid()] = loadedMedia;
         }
         else
         {
             addMedia( path, uuid );
         }
+        Media*  parsedMedia = m_medias.value( QUuid( uuid ), NULL );
+        if ( parsedMedia != NULL && seekIndex.isNull() == false )
+            parsedMedia->seekIndex()->load( seekIndex );
+        if ( parsedMedia != NULL && proxy.isNull() == false )
+        {
+            QString     sourceDate = proxy.attribute( "sourceDate" );
+            ProxyManager::getInstance()->loadProxy( parsedMedia,
+                    proxy.attribute( "path" ),
+                    QDateTime::fromString( sourceDate, Qt::ISODate ) );
+        }
         if ( clipList.size() != 0 )
         {
             foreach( QDomElement clip, clipList )
@@ -219,6 +239,7 @@ Library::loadProject( const QDomElement& medias )
                         {
                             Clip* clip = new Clip( media, beg.toInt(), end.toInt(), QUuid( clipUuid ) );
                             media->addClip( clip );
+                            m_clipParents[clip->uuid()] = media;
                         }
                     }
                 }
@@ -256,6 +277,15 @@ Library::saveProject( QDomDocument& doc, QDomElement& rootNode )
 
         media.appendChild( mrl );
         media.appendChild( uuid );
+        it.value()->seekIndex()->save( doc, media );
+        if ( it.value()->proxyState() == Media::ProxyReady )
+        {
+            QDomElement proxy = doc.createElement( "proxy" );
+            proxy.setAttribute( "path", it.value()->proxyPath() );
+            proxy.setAttribute( "sourceDate",
+                                it.value()->proxySourceDate().toString( Qt::ISODate ) );
+            media.appendChild( proxy );
+        }
         //Creating the clip branch
         if ( it.value()->clips()->size() != 0 )
         {
@@ -284,10 +314,13 @@ Library::clear()
     while ( it != end )
     {
         emit mediaRemoved( it.key() );
+        ProxyManager::getInstance()->cancel( it.value() );
         delete it.value();
         ++it;
     }
     m_medias.clear();
+    m_mediasByPath.clear();
+    m_clipParents.clear();
 }
 
 void
@@ -301,4 +334,5 @@ Library::removeClip( const QUuid& mediaId, const QUuid& clipId )
 
     if ( med->clips()->contains( clipId ) )
         med->removeClip( clipId );
+    m_clipParents.remove( clipId );
 }
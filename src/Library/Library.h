@@ -132,6 +132,18 @@ private:
      *  \brief The List of medias loaded into the library
      */
     QHash<QUuid, Media*>    m_medias;
+    /**
+     *  \brief The same medias, indexed by their absolute file path.
+     */
+    QHash<QString, Media*>  m_mediasByPath;
+    /**
+     *  \brief The parent media of each known clip, indexed by the clip uuid.
+     *
+     *  Clips can be added to a media without going through the library, so
+     *  this is only a cache, and clip( const QUuid& ) will still scan the
+     *  medias when a clip can't be found here.
+     */
+    QHash<QUuid, Media*>    m_clipParents;
     /**
      *  \brief  This method allows to get whereas Media or clip by uuid
      *  \param container The type of container used for storage, where T is Clip or Media
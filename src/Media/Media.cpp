@@ -27,11 +27,13 @@
   */
 
 #include <QtDebug>
+#include <QMutex>
 #include <QUrl>
 #include "Media.h"
 #include "MetaDataManager.h"
 #include "VLCMedia.h"
 #include "Clip.h"
+#include "SeekIndex.h"
 
 QPixmap*        Media::defaultSnapshot = NULL;
 const QString   Media::VideoExtensions = "*.mov *.avi *.mkv *.mpg *.mpeg *.wmv *.mp4 *.ogg *.ogv";
@@ -50,8 +52,12 @@ Media::Media( const QString& filePath, const QString& uuid /*= QString()*/ )
     m_fps( .0f ),
     m_baseClip( NULL ),
     m_nbAudioTracks( 0 ),
-    m_nbVideoTracks( 0 )
+    m_nbVideoTracks( 0 ),
+    m_seekIndex( NULL ),
+    m_proxyState( Media::NoProxy )
 {
+    m_seekIndex = new SeekIndex;
+    m_proxyMutex = new QMutex;
     if ( uuid.length() == 0 )
         m_uuid = QUuid::createUuid();
     else
@@ -91,6 +97,8 @@ Media::~Media()
         delete m_snapshot;
     if ( m_fileInfo )
         delete m_fileInfo;
+    delete m_seekIndex;
+    delete m_proxyMutex;
 }
 
 void        Media::setFileType()
@@ -132,6 +140,14 @@ void        Media::setSnapshot( QPixmap* snapshot )
     if ( m_snapshot != NULL )
         delete m_snapshot;
     m_snapshot = snapshot;
+    if ( snapshot != NULL )
+        m_snapshotImage = snapshot->toImage();
+}
+
+const QImage&
+Media::snapshotImage() const
+{
+    return m_snapshotImage;
 }
 
 const QPixmap&    Media::snapshot() const
@@ -313,3 +329,72 @@ Media::nbVideoTracks() const
 {
     return m_nbVideoTracks;
 }
+
+Media::ProxyState
+Media::proxyState() const
+{
+    QMutexLocker    lock( m_proxyMutex );
+
+    return m_proxyState;
+}
+
+void
+Media::setProxyState( Media::ProxyState state )
+{
+    {
+        QMutexLocker    lock( m_proxyMutex );
+
+        if ( m_proxyState == state )
+            return ;
+        m_proxyState = state;
+    }
+    emit proxyStateChanged( this );
+}
+
+QString
+Media::proxyPath() const
+{
+    QMutexLocker    lock( m_proxyMutex );
+
+    return m_proxyPath;
+}
+
+QDateTime
+Media::proxySourceDate() const
+{
+    QMutexLocker    lock( m_proxyMutex );
+
+    return m_proxySourceDate;
+}
+
+void
+Media::setProxy( const QString& path, const QDateTime& sourceDate )
+{
+    QMutexLocker    lock( m_proxyMutex );
+
+    m_proxyPath = path;
+    m_proxySourceDate = sourceDate;
+}
+
+bool
+Media::isProxyFresh() const
+{
+    QMutexLocker    lock( m_proxyMutex );
+
+    if ( m_fileInfo == NULL || m_proxyPath.isEmpty() == true ||
+         QFileInfo( m_proxyPath ).exists() == false )
+        return false;
+    //The date is saved in the project without the milliseconds.
+    return QFileInfo( m_fileInfo->absoluteFilePath() ).lastModified().toTime_t() ==
+            m_proxySourceDate.toTime_t();
+}
+
+QString
+Media::proxyMrl() const
+{
+    QMutexLocker    lock( m_proxyMutex );
+
+    if ( m_proxyState != Media::ProxyReady )
+        return QString();
+    return "file:///" + QUrl::toPercentEncoding( m_proxyPath, "/" );
+}
@@ -29,8 +29,10 @@
 #ifndef MEDIA_H__
 #define MEDIA_H__
 
+#include <QDateTime>
 #include <QList>
 #include <QString>
+#include <QImage>
 #include <QPixmap>
 #include <QUuid>
 #include <QObject>
@@ -42,6 +44,9 @@ namespace LibVLCpp
     class   Media;
 }
 class Clip;
+class SeekIndex;
+
+class QMutex;
 
 /**
   * Represents a basic container for media informations.
@@ -66,6 +71,18 @@ public:
         File,
         Stream
     };
+    /**
+     *  \brief The state of the low resolution copy used for previews.
+     *  \sa    ProxyManager
+     */
+    enum    ProxyState
+    {
+        NoProxy,
+        ProxyQueued,
+        ProxyGenerating,
+        ProxyReady,
+        ProxyFailed
+    };
     Media( const QString& filePath, const QString& uuid = QString() );
     virtual ~Media();
 
@@ -83,6 +100,11 @@ public:
 
     void                        setSnapshot( QPixmap* snapshot );
     const QPixmap               &snapshot() const;
+    /**
+     *  \brief  A copy of the snapshot that, unlike a QPixmap, can be used out of
+     *          the GUI thread. It is null until a snapshot has been computed.
+     */
+    const QImage                &snapshotImage() const;
 
     const QFileInfo             *fileInfo() const;
     const QString               &mrl() const;
@@ -149,6 +171,30 @@ public:
 
     const Clip*                 baseClip() const { return m_baseClip; }
 
+    /**
+     *  \brief  The measured seek costs of this media.
+     */
+    SeekIndex*                  seekIndex() const { return m_seekIndex; }
+
+    ProxyState                  proxyState() const;
+    void                        setProxyState( ProxyState state );
+    QString                     proxyPath() const;
+    /**
+     *  \return The modification date of this media's file when the proxy was
+     *          generated.
+     */
+    QDateTime                   proxySourceDate() const;
+    void                        setProxy( const QString& path, const QDateTime& sourceDate );
+    /**
+     *  \return true if the proxy file exists, and this media's file hasn't been
+     *          modified since the proxy was generated.
+     */
+    bool                        isProxyFresh() const;
+    /**
+     *  \return The proxy mrl, or an empty string if the proxy isn't ready.
+     */
+    QString                     proxyMrl() const;
+
 private:
     void                        setFileType();
 
@@ -158,6 +204,7 @@ protected:
     QString                     m_mrl;
     QList<QString>              m_volatileParameters;
     QPixmap*                    m_snapshot;
+    QImage                      m_snapshotImage;
     QUuid                       m_uuid;
     QFileInfo*                  m_fileInfo;
     qint64                      m_lengthMS;
@@ -174,11 +221,18 @@ protected:
     QList<int>*                 m_audioValueList;
     int                         m_nbAudioTracks;
     int                         m_nbVideoTracks;
+    SeekIndex*                  m_seekIndex;
+    /// \brief  The proxy is generated in the GUI thread, and used by the renderers.
+    mutable QMutex*             m_proxyMutex;
+    ProxyState                  m_proxyState;
+    QString                     m_proxyPath;
+    QDateTime                   m_proxySourceDate;
 
 signals:
     void                        metaDataComputed( const Media* );
     void                        snapshotComputed( const Media* );
     void                        audioSpectrumComputed( const QUuid& );
+    void                        proxyStateChanged( const Media* );
 };
 
 #endif // CLIP_H__
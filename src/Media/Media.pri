@@ -1,6 +1,8 @@
 HEADERS	+=	Clip.h	\
-		Media.h
+		Media.h	\
+		SeekIndex.h
 
 SOURCES	+=	Clip.cpp	\
-		Media.cpp
+		Media.cpp	\
+		SeekIndex.cpp
 
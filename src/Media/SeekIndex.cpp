@@ -0,0 +1,147 @@
+/*****************************************************************************
+ * SeekIndex.cpp : Measured seek costs of a media
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "SeekIndex.h"
+
+#include <QDomDocument>
+#include <QDomElement>
+#include <QMutex>
+
+SeekIndex::SeekIndex() :
+        m_meanCost( -1 ),
+        m_nbMeasures( 0 )
+{
+    m_mutex = new QMutex;
+}
+
+SeekIndex::~SeekIndex()
+{
+    delete m_mutex;
+}
+
+void
+SeekIndex::seekMeasured( qint64 time, qint64 cost )
+{
+    if ( time < 0 || cost < 0 )
+        return ;
+    QMutexLocker    lock( m_mutex );
+    qint64          slice = time / SliceDuration;
+
+    QMap<qint64, qint64>::iterator  it = m_slices.find( slice );
+    if ( it != m_slices.end() )
+        it.value() += ( cost - it.value() ) / 4;
+    else if ( m_slices.count() < MaxSlices )
+        m_slices.insert( slice, cost );
+    if ( m_meanCost < 0 )
+        m_meanCost = cost;
+    else
+        m_meanCost += ( cost - m_meanCost ) / 8;
+    ++m_nbMeasures;
+}
+
+qint64
+SeekIndex::estimatedCost( qint64 time ) const
+{
+    QMutexLocker    lock( m_mutex );
+    qint64          slice = time / SliceDuration;
+
+    QMap<qint64, qint64>::const_iterator    it = m_slices.find( slice );
+    if ( it != m_slices.end() )
+        return it.value();
+    //The neighbour slices are likely to be in the same GOP, so they're a better
+    //guess than the average.
+    it = m_slices.find( slice - 1 );
+    if ( it != m_slices.end() )
+        return it.value();
+    it = m_slices.find( slice + 1 );
+    if ( it != m_slices.end() )
+        return it.value();
+    return m_meanCost;
+}
+
+qint64
+SeekIndex::meanCost() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_meanCost;
+}
+
+qint64
+SeekIndex::extraCost( qint64 time ) const
+{
+    qint64      cost = estimatedCost( time );
+    qint64      mean = meanCost();
+
+    if ( cost < 0 || mean < 0 )
+        return 0;
+    return qMax( cost - mean, Q_INT64_C( 0 ) );
+}
+
+int
+SeekIndex::nbMeasures() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_nbMeasures;
+}
+
+void
+SeekIndex::save( QDomDocument& doc, QDomElement& mediaNode ) const
+{
+    QMutexLocker    lock( m_mutex );
+
+    if ( m_meanCost < 0 )
+        return ;
+    QDomElement     seekIndex = doc.createElement( "seekIndex" );
+    seekIndex.setAttribute( "mean", m_meanCost );
+    seekIndex.setAttribute( "nbMeasures", m_nbMeasures );
+
+    QMap<qint64, qint64>::const_iterator    it = m_slices.begin();
+    QMap<qint64, qint64>::const_iterator    end = m_slices.end();
+    for ( ; it != end; ++it )
+    {
+        QDomElement     seek = doc.createElement( "seek" );
+        seek.setAttribute( "time", it.key() * SliceDuration );
+        seek.setAttribute( "cost", it.value() );
+        seekIndex.appendChild( seek );
+    }
+    mediaNode.appendChild( seekIndex );
+}
+
+void
+SeekIndex::load( const QDomElement& seekIndexNode )
+{
+    QMutexLocker    lock( m_mutex );
+
+    m_slices.clear();
+    m_meanCost = seekIndexNode.attribute( "mean", "-1" ).toLongLong();
+    m_nbMeasures = seekIndexNode.attribute( "nbMeasures", "0" ).toInt();
+
+    QDomElement     seek = seekIndexNode.firstChild().toElement();
+    while ( seek.isNull() == false && m_slices.count() < MaxSlices )
+    {
+        qint64      time = seek.attribute( "time", "-1" ).toLongLong();
+        qint64      cost = seek.attribute( "cost", "-1" ).toLongLong();
+        if ( time >= 0 && cost >= 0 )
+            m_slices.insert( time / SliceDuration, cost );
+        seek = seek.nextSibling().toElement();
+    }
+}
@@ -0,0 +1,89 @@
+/*****************************************************************************
+ * SeekIndex.h : Measured seek costs of a media
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef SEEKINDEX_H
+#define SEEKINDEX_H
+
+#include <QMap>
+#include <QtGlobal>
+
+class   QDomDocument;
+class   QDomElement;
+class   QMutex;
+
+/**
+ *  \brief  Remembers how long seeking to each part of a media takes.
+ *
+ *  libvlc doesn't let us look at the keyframes of a media, but the time a seek
+ *  takes to produce its first frame mostly depends on the distance between its
+ *  target and the preceding keyframe. Costs are measured each time a clip seeks
+ *  (including at import time, for the snapshot) and grouped by slices of the
+ *  media, so a position that has been reached once can be predicted accurately.
+ *  Positions that have never been reached use the media average.
+ *  The index is saved with the project.
+ */
+class   SeekIndex
+{
+    public:
+        /// \brief  The duration (in ms) of the slices measures are grouped by.
+        static const qint64     SliceDuration = 250;
+        /// \brief  Past this number of slices, only the known slices are updated.
+        static const int        MaxSlices = 4096;
+
+        SeekIndex();
+        ~SeekIndex();
+
+        /**
+         *  \param  time    The seek target, in ms.
+         *  \param  cost    The time (in µs) it took to get a frame after seeking.
+         */
+        void                    seekMeasured( qint64 time, qint64 cost );
+        /**
+         *  \return The time (in µs) a seek to this position should take, or -1
+         *          if no seek has been measured for this media.
+         */
+        qint64                  estimatedCost( qint64 time ) const;
+        /**
+         *  \return The average seek cost (in µs), or -1 if unknown.
+         */
+        qint64                  meanCost() const;
+        /**
+         *  \return How much longer (in µs) than the average a seek to this
+         *          position should take. This is never negative.
+         */
+        qint64                  extraCost( qint64 time ) const;
+        int                     nbMeasures() const;
+
+        void                    save( QDomDocument& doc, QDomElement& mediaNode ) const;
+        void                    load( const QDomElement& seekIndexNode );
+
+    private:
+        Q_DISABLE_COPY( SeekIndex )
+
+        mutable QMutex*         m_mutex;
+        /// \brief  The smoothed cost of each known slice
+        QMap<qint64, qint64>    m_slices;
+        qint64                  m_meanCost;
+        int                     m_nbMeasures;
+};
+
+#endif // SEEKINDEX_H
@@ -31,6 +31,8 @@
 #include "VLCMediaPlayer.h"
 #include "VLCMedia.h"
 #include "Clip.h"
+#include "SeekIndex.h"
+#include "mdate.h"
 
 #include <QThreadPool>
 #include <QRunnable>
@@ -40,7 +42,9 @@ MetaDataWorker::MetaDataWorker( LibVLCpp::MediaPlayer* mediaPlayer, Media* media
         m_media( media ),
         m_mediaIsPlaying( false),
         m_lengthHasChanged( false ),
-        m_audioBuffer( NULL )
+        m_audioBuffer( NULL ),
+        m_seekTarget( -1 ),
+        m_seekDate( -1 )
 {
 }
 
@@ -154,7 +158,9 @@ MetaDataWorker::metaDataAvailable()
          m_media->fileType() == Media::Image )
     {
         connect( m_mediaPlayer, SIGNAL( positionChanged( float ) ), this, SLOT( renderSnapshot() ) );
-        m_mediaPlayer->setTime( m_mediaPlayer->getLength() / 3 );
+        m_seekTarget = m_mediaPlayer->getLength() / 3;
+        m_seekDate = mdate();
+        m_mediaPlayer->setTime( m_seekTarget );
     }
     else
         finalize();
@@ -166,6 +172,11 @@ MetaDataWorker::renderSnapshot()
     if ( m_media->fileType() == Media::Video ||
          m_media->fileType() == Media::Audio )
         disconnect( m_mediaPlayer, SIGNAL( positionChanged( float ) ), this, SLOT( renderSnapshot() ) );
+    if ( m_media->fileType() == Media::Video && m_seekDate >= 0 )
+    {
+        m_media->seekIndex()->seekMeasured( m_seekTarget, mdate() - m_seekDate );
+        m_seekDate = -1;
+    }
     QTemporaryFile tmp;
     tmp.setAutoRemove( false );
     tmp.open();
@@ -70,6 +70,9 @@ class MetaDataWorker : public QObject
 
         unsigned char*              m_audioBuffer;
         QTime                       m_timer;
+        /// \brief  The snapshot seek is the first measure of the media seek index
+        qint64                      m_seekTarget;
+        qint64                      m_seekDate;
 
     private slots:
         void    renderSnapshot();
@@ -1,6 +1,8 @@
 HEADERS	+=	MetaDataManager.h	\
-		MetaDataWorker.h
+		MetaDataWorker.h	\
+		ProxyManager.h
 
 SOURCES	+=	MetaDataManager.cpp	\
-		MetaDataWorker.cpp
+		MetaDataWorker.cpp	\
+		ProxyManager.cpp
 
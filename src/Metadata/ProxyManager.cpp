@@ -0,0 +1,228 @@
+/*****************************************************************************
+ * ProxyManager.cpp: Generates low resolution copies of the medias, for previews
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "ProxyManager.h"
+#include "vlmc.h"
+#include "Clip.h"
+#include "Media.h"
+#include "SettingsManager.h"
+#include "VLCMedia.h"
+#include "VLCMediaPlayer.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QtDebug>
+
+ProxyManager::ProxyManager() :
+        m_current( NULL ),
+        m_vlcMedia( NULL ),
+        m_mediaPlayer( NULL )
+{
+}
+
+ProxyManager::~ProxyManager()
+{
+    releaseGenerating();
+}
+
+void
+ProxyManager::requestProxy( Media* media )
+{
+    //The media size is needed to generate the proxy.
+    if ( media->baseClip() == NULL )
+    {
+        if ( m_waitingMedias.contains( media ) == false )
+        {
+            m_waitingMedias.append( media );
+            connect( media, SIGNAL( metaDataComputed( const Media* ) ),
+                     this, SLOT( metaDataComputed( const Media* ) ),
+                     Qt::QueuedConnection );
+        }
+        return ;
+    }
+    if ( media->isProxyFresh() == true )
+    {
+        media->setProxyState( Media::ProxyReady );
+        return ;
+    }
+    if ( needsProxy( media ) == false || m_current == media ||
+         m_queue.contains( media ) == true )
+        return ;
+    media->setProxyState( Media::ProxyQueued );
+    m_queue.enqueue( media );
+    generateNext();
+}
+
+void
+ProxyManager::loadProxy( Media* media, const QString& path, const QDateTime& sourceDate )
+{
+    if ( media->proxyState() == Media::ProxyReady || m_current == media )
+        return ;
+    media->setProxy( path, sourceDate );
+    if ( media->isProxyFresh() == false )
+        return ;
+    m_queue.removeAll( media );
+    media->setProxyState( Media::ProxyReady );
+}
+
+void
+ProxyManager::cancel( Media* media )
+{
+    if ( m_waitingMedias.removeAll( media ) != 0 )
+        disconnect( media, SIGNAL( metaDataComputed( const Media* ) ),
+                    this, SLOT( metaDataComputed( const Media* ) ) );
+    m_queue.removeAll( media );
+    if ( m_current == media )
+    {
+        releaseGenerating();
+        QFile::remove( m_partialPath );
+        media->setProxyState( Media::NoProxy );
+        generateNext();
+    }
+}
+
+void
+ProxyManager::metaDataComputed( const Media* media )
+{
+    foreach ( Media* m, m_waitingMedias )
+    {
+        if ( m == media )
+        {
+            m_waitingMedias.removeAll( m );
+            disconnect( m, SIGNAL( metaDataComputed( const Media* ) ),
+                        this, SLOT( metaDataComputed( const Media* ) ) );
+            requestProxy( m );
+            return ;
+        }
+    }
+}
+
+bool
+ProxyManager::needsProxy( const Media* media ) const
+{
+    int     proxyHeight = VLMC_GET_INT( "general/ProxyHeight" );
+
+    //A proxy wouldn't be any cheaper to decode than a small media.
+    return proxyHeight > 0 && media->fileType() == Media::Video &&
+            media->inputType() == Media::File && media->height() > proxyHeight;
+}
+
+QString
+ProxyManager::proxyPath( const Media* media ) const
+{
+    QDir        dir( VLMC_PROJECT_GET_STRING( "general/VLMCWorkspace" ) );
+    QByteArray  hash = QCryptographicHash::hash(
+            media->fileInfo()->absoluteFilePath().toUtf8(), QCryptographicHash::Md5 );
+
+    if ( dir.exists( "proxies" ) == false )
+        dir.mkdir( "proxies" );
+    return dir.absoluteFilePath( "proxies/" + hash.toHex() + ".avi" );
+}
+
+void
+ProxyManager::generateNext()
+{
+    if ( m_current != NULL || m_queue.isEmpty() == true )
+        return ;
+    m_current = m_queue.dequeue();
+
+    QString     path = proxyPath( m_current );
+    int         height = VLMC_GET_INT( "general/ProxyHeight" ) & ~1;
+    int         width = ( m_current->width() * height / m_current->height() ) & ~1;
+    QString     sout;
+
+    m_partialPath = path + ".part";
+    m_current->setProxy( path,
+            QFileInfo( m_current->fileInfo()->absoluteFilePath() ).lastModified() );
+    //Same chain as the transcoding dialog, with an intra only codec so that
+    //seeking in the proxy is cheap.
+    sout = QString( ":sout=#transcode{vcodec=mjpg,vb=8000,scale=1,width=%1,height=%2" )
+           .arg( width ).arg( height );
+    if ( m_current->fps() > 0.0f )
+        sout += QString( ",fps=%1" ).arg( m_current->fps() );
+    sout += ":std{access=file,mux=avi,dst=\"" + m_partialPath + "\"}";
+
+    m_vlcMedia = new LibVLCpp::Media( m_current->mrl() );
+    m_vlcMedia->addOption( ":no-audio" );
+    m_vlcMedia->addOption( ":no-sout-audio" );
+    m_vlcMedia->addOption( sout.toStdString().c_str() );
+    m_mediaPlayer = new LibVLCpp::MediaPlayer( m_vlcMedia );
+    //Those are emitted from VLC's thread, and the player can't be deleted from there.
+    connect( m_mediaPlayer, SIGNAL( endReached() ),
+             this, SLOT( generationCompleted() ), Qt::QueuedConnection );
+    connect( m_mediaPlayer, SIGNAL( errorEncountered() ),
+             this, SLOT( generationFailed() ), Qt::QueuedConnection );
+    m_current->setProxyState( Media::ProxyGenerating );
+    m_mediaPlayer->play();
+}
+
+void
+ProxyManager::releaseGenerating()
+{
+    if ( m_mediaPlayer != NULL )
+    {
+        m_mediaPlayer->stop();
+        delete m_mediaPlayer;
+        m_mediaPlayer = NULL;
+    }
+    delete m_vlcMedia;
+    m_vlcMedia = NULL;
+    m_current = NULL;
+}
+
+void
+ProxyManager::generationCompleted()
+{
+    //This transcoding may have been canceled while the signal was queued.
+    if ( m_current == NULL || sender() != m_mediaPlayer )
+        return ;
+    Media*      media = m_current;
+    QString     path = media->proxyPath();
+
+    releaseGenerating();
+    QFile::remove( path );
+    if ( QFile::rename( m_partialPath, path ) == true )
+        media->setProxyState( Media::ProxyReady );
+    else
+    {
+        qWarning() << "Can't move the proxy to" << path;
+        QFile::remove( m_partialPath );
+        media->setProxyState( Media::ProxyFailed );
+    }
+    generateNext();
+}
+
+void
+ProxyManager::generationFailed()
+{
+    if ( m_current == NULL || sender() != m_mediaPlayer )
+        return ;
+    Media*      media = m_current;
+
+    qWarning() << "Failed to generate the proxy of" << media->fileName();
+    releaseGenerating();
+    QFile::remove( m_partialPath );
+    media->setProxyState( Media::ProxyFailed );
+    generateNext();
+}
@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * ProxyManager.h: Generates low resolution copies of the medias, for previews
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef PROXYMANAGER_H
+#define PROXYMANAGER_H
+
+#include "Singleton.hpp"
+
+#include <QList>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+
+class   QDateTime;
+
+class   Media;
+namespace LibVLCpp
+{
+    class   Media;
+    class   MediaPlayer;
+}
+
+/**
+ *  \brief  Generates the proxies of the video medias, one after the other.
+ *
+ *  A proxy is an intra only (MJPEG), reduced size copy of a media, which is much
+ *  cheaper to decode and seek than the original. Previews decode the proxy once
+ *  it's ready, renders to a file always decode the original.
+ *  Proxies are written to the "proxies" directory of the workspace, and their
+ *  location is saved in the project, along with the modification date of the
+ *  original, so they're only generated again when the original changed.
+ *  This must only be used from the GUI thread.
+ */
+class   ProxyManager : public QObject, public Singleton<ProxyManager>
+{
+    Q_OBJECT
+    Q_DISABLE_COPY( ProxyManager );
+
+    public:
+        /**
+         *  \brief  Generate the media proxy, unless it already has an up to date one.
+         *
+         *  If the media metadata are not computed yet, the proxy will be generated
+         *  once they are.
+         */
+        void                    requestProxy( Media* media );
+        /**
+         *  \brief  Use a proxy generated before (ie from a saved project)
+         *
+         *  This is ignored if the proxy isn't fresh anymore, and the media will
+         *  get a new one.
+         */
+        void                    loadProxy( Media* media, const QString& path,
+                                           const QDateTime& sourceDate );
+        /**
+         *  \brief  Stop generating the media proxy. This must be called before
+         *          deleting a media.
+         */
+        void                    cancel( Media* media );
+
+    private:
+        ProxyManager();
+        ~ProxyManager();
+
+        bool                    needsProxy( const Media* media ) const;
+        QString                 proxyPath( const Media* media ) const;
+        void                    generateNext();
+        /**
+         *  \brief  Stop and delete the current transcoding.
+         */
+        void                    releaseGenerating();
+
+    private:
+        QQueue<Media*>          m_queue;
+        /// \brief  The medias waiting for their metadata
+        QList<Media*>           m_waitingMedias;
+        Media*                  m_current;
+        /// \brief  The proxy is written there, and renamed once completed.
+        QString                 m_partialPath;
+        LibVLCpp::Media*        m_vlcMedia;
+        LibVLCpp::MediaPlayer*  m_mediaPlayer;
+
+        friend class            Singleton<ProxyManager>;
+
+    private slots:
+        void                    metaDataComputed( const Media* media );
+        void                    generationCompleted();
+        void                    generationFailed();
+};
+
+#endif // PROXYMANAGER_H
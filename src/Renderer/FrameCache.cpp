@@ -0,0 +1,173 @@
+/*****************************************************************************
+ * FrameCache.cpp: Keeps the last composited frames, for scrubbing and replay
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "FrameCache.h"
+
+#include <QMutex>
+#include <QVariant>
+
+FrameCache::FrameCache( quint64 budget, QObject* parent ) :
+        QObject( parent ),
+        m_budget( budget ),
+        m_revision( 0 )
+{
+    m_mutex = new QMutex;
+    m_stats.nbFrames = 0;
+    m_stats.bytesUsed = 0;
+    resetStats();
+}
+
+FrameCache::~FrameCache()
+{
+    delete m_mutex;
+}
+
+bool
+FrameCache::get( qint64 frameNumber, LightVideoFrame& frame )
+{
+    QMutexLocker    lock( m_mutex );
+
+    QMap<qint64, Entry>::iterator   it = m_frames.find( frameNumber );
+    if ( it == m_frames.end() )
+    {
+        ++m_stats.nbMisses;
+        return false;
+    }
+    ++m_stats.nbHits;
+    m_lru.erase( it.value().lruPos );
+    it.value().lruPos = m_lru.insert( m_lru.end(), frameNumber );
+    frame = it.value().frame;
+    return true;
+}
+
+void
+FrameCache::insert( qint64 frameNumber, int revision, const LightVideoFrame& frame )
+{
+    QMutexLocker    lock( m_mutex );
+
+    //The timeline has been edited since this frame was rendered.
+    if ( revision < m_revision )
+        return ;
+    m_revision = revision;
+    QMap<qint64, Entry>::iterator   it = m_frames.find( frameNumber );
+    if ( it != m_frames.end() )
+        remove( it );
+    //Never let a single frame flush the whole cache.
+    if ( frame->nboctets > m_budget )
+        return ;
+    Entry   entry;
+    entry.frame = frame;
+    entry.lruPos = m_lru.insert( m_lru.end(), frameNumber );
+    m_frames.insert( frameNumber, entry );
+    ++m_stats.nbInsertions;
+    ++m_stats.nbFrames;
+    m_stats.bytesUsed += frame->nboctets;
+    evict();
+}
+
+QMap<qint64, FrameCache::Entry>::iterator
+FrameCache::remove( QMap<qint64, Entry>::iterator it )
+{
+    m_stats.bytesUsed -= it.value().frame->nboctets;
+    --m_stats.nbFrames;
+    m_lru.erase( it.value().lruPos );
+    return m_frames.erase( it );
+}
+
+void
+FrameCache::evict()
+{
+    while ( m_stats.bytesUsed > m_budget && m_lru.isEmpty() == false )
+    {
+        remove( m_frames.find( m_lru.first() ) );
+        ++m_stats.nbEvictions;
+    }
+}
+
+void
+FrameCache::invalidate( qint64 begin, qint64 end, int revision )
+{
+    QMutexLocker    lock( m_mutex );
+
+    if ( revision > m_revision )
+        m_revision = revision;
+    QMap<qint64, Entry>::iterator   it = m_frames.lowerBound( begin );
+    while ( it != m_frames.end() && ( end < 0 || it.key() < end ) )
+    {
+        it = remove( it );
+        ++m_stats.nbInvalidations;
+    }
+}
+
+void
+FrameCache::clear()
+{
+    QMutexLocker    lock( m_mutex );
+
+    m_frames.clear();
+    m_lru.clear();
+    m_stats.nbFrames = 0;
+    m_stats.bytesUsed = 0;
+}
+
+void
+FrameCache::setBudget( quint64 budget )
+{
+    QMutexLocker    lock( m_mutex );
+
+    m_budget = budget;
+    evict();
+}
+
+quint64
+FrameCache::budget() const
+{
+    QMutexLocker    lock( m_mutex );
+
+    return m_budget;
+}
+
+void
+FrameCache::budgetChanged( const QVariant& budget )
+{
+    setBudget( budget.toULongLong() * 1024 * 1024 );
+}
+
+FrameCache::Stats
+FrameCache::stats() const
+{
+    QMutexLocker    lock( m_mutex );
+
+    return m_stats;
+}
+
+void
+FrameCache::resetStats()
+{
+    QMutexLocker    lock( m_mutex );
+
+    m_stats.nbHits = 0;
+    m_stats.nbMisses = 0;
+    m_stats.nbInsertions = 0;
+    m_stats.nbEvictions = 0;
+    m_stats.nbInvalidations = 0;
+}
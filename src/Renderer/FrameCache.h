@@ -0,0 +1,127 @@
+/*****************************************************************************
+ * FrameCache.h: Keeps the last composited frames, for scrubbing and replay
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include "LightVideoFrame.h"
+
+#include <QLinkedList>
+#include <QMap>
+#include <QObject>
+
+class   QMutex;
+class   QVariant;
+
+/**
+ *  \brief  Keeps the last composited frames, by timeline frame.
+ *
+ *  The frames are shared with the renderer, so caching a frame doesn't copy it.
+ *  The least recently used frames are dropped once the cache takes more than
+ *  budget() bytes.
+ *  A frame is only inserted if it has been rendered with the latest timeline
+ *  revision, and each timeline edit drops the frames it changed.
+ *  \sa     MainWorkflow::timelineChanged( qint64, qint64, int )
+ */
+class   FrameCache : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY( FrameCache )
+
+    public:
+        struct  Stats
+        {
+            int         nbHits;
+            int         nbMisses;
+            int         nbInsertions;
+            /// \brief  The number of frames dropped to stay under the budget
+            int         nbEvictions;
+            /// \brief  The number of frames dropped by timeline edits
+            int         nbInvalidations;
+            int         nbFrames;
+            quint64     bytesUsed;
+        };
+
+        FrameCache( quint64 budget, QObject* parent = NULL );
+        ~FrameCache();
+
+        /**
+         *  \brief  Get a cached frame.
+         *  \return true if the frame was cached. Otherwise, frame isn't modified.
+         */
+        bool                    get( qint64 frameNumber, LightVideoFrame& frame );
+        /**
+         *  \brief  Cache a frame.
+         *
+         *  \param  frameNumber The timeline frame.
+         *  \param  revision    The timeline revision this frame has been rendered with.
+         *                      Frames rendered with an outdated revision are ignored.
+         */
+        void                    insert( qint64 frameNumber, int revision,
+                                        const LightVideoFrame& frame );
+        void                    clear();
+
+        void                    setBudget( quint64 budget );
+        quint64                 budget() const;
+        Stats                   stats() const;
+        void                    resetStats();
+
+    private:
+        struct  Entry
+        {
+            LightVideoFrame                 frame;
+            QLinkedList<qint64>::iterator   lruPos;
+        };
+        /**
+         *  \brief  Drop the least recently used frames until the cache fits in
+         *          the budget.
+         *  \warning    The cache mutex must be locked.
+         */
+        void                    evict();
+        /**
+         *  \warning    The cache mutex must be locked.
+         */
+        QMap<qint64, Entry>::iterator   remove( QMap<qint64, Entry>::iterator it );
+
+    private:
+        mutable QMutex*         m_mutex;
+        QMap<qint64, Entry>     m_frames;
+        /// \brief  The most recently used frames are at the end.
+        QLinkedList<qint64>     m_lru;
+        quint64                 m_budget;
+        int                     m_revision;
+        Stats                   m_stats;
+
+    public slots:
+        /**
+         *  \brief  Drop the frames between begin (included) and end (excluded).
+         *
+         *  If end is -1, every frame after begin is dropped.
+         */
+        void                    invalidate( qint64 begin, qint64 end, int revision );
+        /**
+         *  \brief  Used to watch the budget preference, which is expressed in MB
+         */
+        void                    budgetChanged( const QVariant& budget );
+};
+
+#endif // FRAMECACHE_H
@@ -1,9 +1,11 @@
 HEADERS	+=	ClipRenderer.h	\
+		FrameCache.h	\
 		GenericRenderer.h	\
 		WorkflowFileRenderer.h	\
 		WorkflowRenderer.h
 
 SOURCES	+=	ClipRenderer.cpp	\
+		FrameCache.cpp	\
 		WorkflowFileRenderer.cpp	\
 		WorkflowRenderer.cpp
 
@@ -34,6 +34,8 @@ WorkflowFileRenderer::WorkflowFileRenderer() :
         WorkflowRenderer(),
         m_image( NULL )
 {
+    //Each frame is rendered once, caching them would only waste memory.
+    m_cacheFrames = false;
 }
 
 WorkflowFileRenderer::~WorkflowFileRenderer()
@@ -89,7 +91,7 @@ void        WorkflowFileRenderer::run()
     m_audioPts = 0;
 
     m_mainWorkflow->setFullSpeedRender( true );
-    m_mainWorkflow->startRender( width, height );
+    m_mainWorkflow->startRender( width, height, m_videoFormat );
     m_mediaPlayer->play();
 }
 
@@ -127,7 +129,12 @@ WorkflowFileRenderer::lock( void *datas, qint64 *dts, qint64 *pts, quint32 *flag
     if ( self->m_time.isValid() == false ||
         self->m_time.elapsed() >= 1000 )
     {
-        self->emit imageUpdated( (uchar*)self->m_renderVideoFrame );
+        //Keep a reference on the frame, so the preview buffer stays valid
+        //until the next update. The preview is displayed as RGB.
+        const LightVideoFrame&  last = self->m_lastVideoFrame;
+        self->m_previewFrame = last.converted( VideoFrame::RGB24 );
+        const LightVideoFrame&  preview = self->m_previewFrame;
+        self->emit imageUpdated( preview->frame.octets );
         self->m_time.restart();
     }
     return ret;
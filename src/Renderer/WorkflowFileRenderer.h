@@ -53,6 +53,7 @@ private:
     WorkflowFileRendererDialog* m_dialog;
     QImage*                     m_image;
     QTime                       m_time;
+    LightVideoFrame             m_previewFrame;
 
 protected:
     virtual void*               getLockCallback();
@@ -21,10 +21,13 @@
  *****************************************************************************/
 
 #include <QtDebug>
+#include <QMutex>
 #include <QThread>
 #include <QWaitCondition>
 
 #include "WorkflowRenderer.h"
+#include "EffectsEngine.h"
+#include "FrameCache.h"
 #include "timeline/Timeline.h"
 #include "SettingsManager.h"
 #include "LightVideoFrame.h"
@@ -40,12 +43,17 @@ WorkflowRenderer::WorkflowRenderer() :
             m_stopping( false ),
             m_outputFps( 0.0f ),
             m_oldLength( 0 ),
-            m_renderVideoFrame( NULL ),
             m_media( NULL ),
             m_width( 0 ),
             m_height( 0 ),
+            m_videoFormat( VideoFrame::RGB24 ),
+            m_cacheFrames( true ),
+            m_effectsRevision( 0 ),
             m_silencedAudioBuffer( NULL )
 {
+    m_heldFramesMutex = new QMutex;
+    m_frameCache = new FrameCache(
+            (quint64)VLMC_GET_UINT( "general/FrameCacheSize" ) * 1024 * 1024, this );
 }
 
 void    WorkflowRenderer::initializeRenderer()
@@ -66,6 +74,12 @@ void    WorkflowRenderer::initializeRenderer()
              this, SIGNAL( frameChanged( qint64, MainWorkflow::FrameChangedReason ) ) );
     connect( m_mainWorkflow, SIGNAL( lengthChanged( qint64 ) ),
              this, SLOT(mainWorkflowLenghtChanged(qint64) ) );
+    connect( m_mainWorkflow, SIGNAL( timelineChanged( qint64, qint64, int ) ),
+             m_frameCache, SLOT( invalidate( qint64, qint64, int ) ),
+             Qt::DirectConnection );
+    SettingsManager::getInstance()->watchValue( "general/FrameCacheSize", m_frameCache,
+                                                SLOT( budgetChanged( const QVariant& ) ),
+                                                SettingsManager::Vlmc );
 }
 
 WorkflowRenderer::~WorkflowRenderer()
@@ -75,6 +89,7 @@ WorkflowRenderer::~WorkflowRenderer()
     delete m_videoEsHandler;
     delete m_audioEsHandler;
     delete m_media;
+    delete m_heldFramesMutex;
 }
 
 void
@@ -85,17 +100,20 @@ WorkflowRenderer::setupRenderer( quint32 width, quint32 height, double fps )
     char        audioParameters[256];
     char        callbacks[64];
 
-    if ( m_renderVideoFrame != NULL )
-        delete m_renderVideoFrame;
-    m_renderVideoFrame = new unsigned char[width * height * Pixel::NbComposantes];
+    //RGB is only used if an effect requires it.
+    m_videoFormat = m_mainWorkflow->getEffectsEngine()->videoFormat();
+    //Clean any previous render. This frame is not shared yet, so it can be written.
+    m_lastVideoFrame = LightVideoFrame( width, height, m_videoFormat );
+    m_lastVideoFrame.fillBlack();
+    //The cached frames may not have the right size anymore.
+    m_frameCache->clear();
+    m_effectsRevision = m_mainWorkflow->getEffectsEngine()->revision();
     m_audioEsHandler->fps = fps;
     m_videoEsHandler->fps = fps;
-    //Clean any previous render.
-    memset( m_renderVideoFrame, 0, m_width * m_height * Pixel::NbComposantes );
 
     sprintf( videoString, "width=%i:height=%i:dar=%s:fps=%s:data=%lld:codec=%s:cat=2:caching=0",
              width, height, "16/9", "30/1",
-             (qint64)m_videoEsHandler, "RV24" );
+             (qint64)m_videoEsHandler, VideoFrame::fourcc( m_videoFormat ) );
     sprintf( audioParameters, "data=%lld:cat=1:codec=f32l:samplerate=%u:channels=%u:caching=0",
              (qint64)m_audioEsHandler, m_rate, m_nbChannels );
     strcpy( inputSlave, ":input-slave=imem://" );
@@ -143,17 +161,44 @@ WorkflowRenderer::lock( void *datas, qint64 *dts, qint64 *pts, quint32 *flags,
 int
 WorkflowRenderer::lockVideo( EsHandler *handler, qint64 *pts, size_t *bufferSize, void **buffer )
 {
-    qint64 ptsDiff = 0;
+    qint64                  ptsDiff = 0;
+    const LightVideoFrame&  frame = m_lastVideoFrame;
 
     if ( m_stopping == false )
     {
-        MainWorkflow::OutputBuffers* ret =
-                m_mainWorkflow->getOutput( MainWorkflow::VideoTrack, m_paused );
-        memcpy( m_renderVideoFrame,
-                (*(ret->video))->frame.octets,
-                (*(ret->video))->nboctets );
-        m_videoBuffSize = (*(ret->video))->nboctets;
-        ptsDiff = (*(ret->video))->ptsDiff;
+        //A cached frame's ptsDiff belongs to another render, so the theoretical
+        //pts is used instead.
+        qint64  currentFrame = m_mainWorkflow->getCurrentFrame();
+        int     effectsRevision = m_mainWorkflow->getEffectsEngine()->revision();
+
+        //Bypassing the effects, or editing them, changes every frame.
+        if ( effectsRevision != m_effectsRevision )
+        {
+            m_frameCache->clear();
+            m_effectsRevision = effectsRevision;
+        }
+        if ( m_cacheFrames == true &&
+             m_frameCache->get( currentFrame, m_lastVideoFrame ) == true )
+        {
+            //The clips still have to follow the playback, and the end of the
+            //timeline has to be detected, even though nothing is rendered.
+            m_mainWorkflow->schedule( MainWorkflow::VideoTrack );
+        }
+        else
+        {
+            MainWorkflow::OutputBuffers* ret =
+                    m_mainWorkflow->getOutput( MainWorkflow::VideoTrack, m_paused );
+            //Don't copy the frame, just take a reference on it. Whoever writes to
+            //this frame while imem is reading it will detach it first.
+            m_lastVideoFrame = *(ret->video);
+            ptsDiff = frame->ptsDiff;
+            //Frames rendered while a clip wasn't ready would be wrong once it is.
+            if ( m_cacheFrames == true && ret->videoExact == true )
+                m_frameCache->insert( ret->videoFrame, ret->revision, frame );
+        }
+        //imem reads the frame as a single block, so it can't have padded rows.
+        if ( frame->layout != VideoFrame::Packed )
+            m_lastVideoFrame = frame.relaid( VideoFrame::Packed );
     }
     if ( ptsDiff == 0 )
     {
@@ -163,8 +208,13 @@ WorkflowRenderer::lockVideo( EsHandler *handler, qint64 *pts, size_t *bufferSize
         ptsDiff = 1000000 / handler->fps;
     } 
     m_pts = *pts = ptsDiff + m_pts;
-    *buffer = m_renderVideoFrame;
-    *bufferSize = m_videoBuffSize;
+    {
+        QMutexLocker    lock( m_heldFramesMutex );
+        m_heldFrames.append( frame );
+    }
+    //imem only reads this buffer, until it calls the release callback.
+    *buffer = frame->frame.octets;
+    *bufferSize = frame->nboctets;
     return 0;
 }
 
@@ -205,15 +255,40 @@ WorkflowRenderer::lockAudio( EsHandler *handler, qint64 *pts, size_t *bufferSize
     return 0;
 }
 
-void    WorkflowRenderer::unlock( void*, size_t, void* )
+void
+WorkflowRenderer::unlock( void *datas, size_t, void *buffer )
 {
+    EsHandler*      handler = reinterpret_cast<EsHandler*>( datas );
+
+    if ( handler->type == Video )
+        handler->self->releaseVideoFrame( buffer );
+}
+
+void
+WorkflowRenderer::releaseVideoFrame( void *buffer )
+{
+    QMutexLocker    lock( m_heldFramesMutex );
+
+    //Buffers should be released in the order they were given, but the same
+    //frame can be held more than once when paused.
+    for ( int i = 0; i < m_heldFrames.size(); ++i )
+    {
+        const LightVideoFrame&  frame = m_heldFrames.at( i );
+        if ( frame->frame.octets == buffer )
+        {
+            m_heldFrames.removeAt( i );
+            return ;
+        }
+    }
+    qWarning() << "Releasing an unknown video buffer:" << buffer;
 }
 
 void        WorkflowRenderer::startPreview()
 {
     if ( m_mainWorkflow->getLengthFrame() <= 0 )
         return ;
-    if ( paramsHasChanged( m_width, m_height, m_outputFps ) == true )
+    if ( paramsHasChanged( m_width, m_height, m_outputFps ) == true ||
+         m_mainWorkflow->getEffectsEngine()->videoFormat() != m_videoFormat )
     {
         m_width = width();
         m_height = height();
@@ -229,7 +304,7 @@ void        WorkflowRenderer::startPreview()
     connect( m_mediaPlayer, SIGNAL( stopped() ),    this,   SIGNAL( endReached() ) );
 
     m_mainWorkflow->setFullSpeedRender( false );
-    m_mainWorkflow->startRender( m_width, m_height );
+    m_mainWorkflow->startRender( m_width, m_height, m_videoFormat );
     m_isRendering = true;
     m_paused = false;
     m_stopping = false;
@@ -295,6 +370,11 @@ WorkflowRenderer::killRenderer()
     m_paused = false;
     m_stopping = true;
     m_mediaPlayer->stop();
+    {
+        //imem is stopped, so it won't release the frames it still had.
+        QMutexLocker    lock( m_heldFramesMutex );
+        m_heldFrames.clear();
+    }
     m_mainWorkflow->stop();
     delete[] m_silencedAudioBuffer;
     m_silencedAudioBuffer = NULL;
@@ -25,11 +25,14 @@
 
 #include "AudioClipWorkflow.h"
 #include "GenericRenderer.h"
+#include "LightVideoFrame.h"
 #include "MainWorkflow.h"
 
+#include <QList>
 #include <QObject>
 
 class   Clip;
+class   FrameCache;
 
 class   QWidget;
 class   QWaitCondition;
@@ -212,6 +215,12 @@ class   WorkflowRenderer : public GenericRenderer
          *  \param  buffer      The buffer to be released
          */
         static void         unlock( void *data, size_t buffSize, void *buffer );
+        /**
+         *  \brief  Drop the reference held on the frame that was injected in buffer.
+         *
+         *  \param  buffer      The video buffer imem is done with.
+         */
+        void                releaseVideoFrame( void *buffer );
         /**
          *  \brief  Return the renderer specific width
          *
@@ -257,7 +266,14 @@ class   WorkflowRenderer : public GenericRenderer
         LibVLCpp::Media*    m_media;
         bool                m_stopping;
         float               m_outputFps;
-        unsigned char*	    m_renderVideoFrame;
+        /**
+         *  \brief          The last frame injected in imem.
+         *
+         *  This is a shared reference on the composited frame, so it must only be
+         *  accessed through a const reference. Using the non const accessors would
+         *  detach it, and copy the whole frame.
+         */
+        LightVideoFrame     m_lastVideoFrame;
         /**
          *  \brief          This isn't exactly the current PTS.
          *                  It's the number of frame rendered since the render has started.
@@ -266,6 +282,23 @@ class   WorkflowRenderer : public GenericRenderer
         qint64              m_audioPts;
         quint32             m_width;
         quint32             m_height;
+        /**
+         *  \brief          The format negotiated with the effects engine.
+         */
+        VideoFrame::Format  m_videoFormat;
+        /**
+         *  \brief          The frames already rendered, for scrubbing and replay.
+         */
+        FrameCache*         m_frameCache;
+        /**
+         *  \brief          If false, the frame cache is neither read nor filled.
+         */
+        bool                m_cacheFrames;
+        /**
+         *  \brief          The effects engine revision the cached frames were
+         *                  rendered with.
+         */
+        int                 m_effectsRevision;
 
     private:
         /**
@@ -273,7 +306,15 @@ class   WorkflowRenderer : public GenericRenderer
          *                  be injected
          */
         quint8              *m_silencedAudioBuffer;
-        size_t              m_videoBuffSize;
+        /**
+         *  \brief          The frames imem is currently reading from.
+         *
+         *  The composited frames are not copied anymore, but given to imem as is.
+         *  A reference is held here until imem releases the buffer, so the frame
+         *  can't go back to its pool while it's still being read.
+         */
+        QList<LightVideoFrame>  m_heldFrames;
+        QMutex*             m_heldFramesMutex;
         EsHandler*          m_videoEsHandler;
         EsHandler*          m_audioEsHandler;
         quint32             m_nbChannels;
@@ -0,0 +1,250 @@
+/*****************************************************************************
+ * FrameArena.cpp: Process wide video frame allocator
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+
+#include "FrameArena.h"
+#include "mdate.h"
+
+#include <QMutex>
+#include <QVariant>
+#include <QtDebug>
+
+uint
+qHash( const FrameArena::SizeClass& sc )
+{
+    return ( sc.width << 16 ) ^ sc.height ^ ( sc.size << 7 );
+}
+
+FrameArena::FrameArena() :
+        m_budget( 0 ),
+        m_bytesInUse( 0 ),
+        m_bytesIdle( 0 ),
+        m_highWaterMark( 0 ),
+        m_overBudget( false ),
+        m_nbCopies( 0 ),
+        m_copyLogging( false )
+{
+    m_mutex = new QMutex;
+}
+
+FrameArena::~FrameArena()
+{
+    trim( 0 );
+    delete m_mutex;
+}
+
+quint8*
+FrameArena::allocate( quint32 width, quint32 height, quint32 nbOctets )
+{
+    QMutexLocker    lock( m_mutex );
+    SizeClass       sc( width, height, nbOctets );
+
+    QHash<SizeClass, QList<IdleBuffer> >::iterator   it = m_idleBuffers.find( sc );
+    if ( it != m_idleBuffers.end() && it.value().isEmpty() == false )
+    {
+        m_bytesIdle -= nbOctets;
+        m_bytesInUse += nbOctets;
+        return it.value().takeLast().buffer;
+    }
+    makeRoom( nbOctets );
+    quint8*     buffer = VideoFrame::alignedAlloc( nbOctets );
+    if ( buffer == NULL )
+    {
+        qCritical() << "Can't allocate a" << width << 'x' << height << "frame";
+        return NULL;
+    }
+    m_bytesInUse += nbOctets;
+    updateHighWaterMark();
+    return buffer;
+}
+
+void
+FrameArena::release( quint8* buffer, quint32 width, quint32 height, quint32 nbOctets )
+{
+    QMutexLocker    lock( m_mutex );
+
+    m_bytesInUse -= nbOctets;
+    if ( m_budget != 0 && m_bytesInUse + m_bytesIdle + nbOctets > m_budget )
+    {
+        VideoFrame::alignedFree( buffer );
+        return ;
+    }
+    QList<IdleBuffer>&  idle = m_idleBuffers[SizeClass( width, height, nbOctets )];
+    IdleBuffer          ib;
+    ib.buffer = buffer;
+    ib.since = mdate();
+    //Opportunistically drop the oldest buffer of this class if it expired.
+    if ( idle.isEmpty() == false && ib.since - idle.first().since > DefaultIdleTimeout )
+    {
+        VideoFrame::alignedFree( idle.takeFirst().buffer );
+        m_bytesIdle -= nbOctets;
+    }
+    idle.append( ib );
+    m_bytesIdle += nbOctets;
+}
+
+void
+FrameArena::copied( quint32 width, quint32 height, quint32 nbOctets,
+                    const char* callSite )
+{
+    QMutexLocker    lock( m_mutex );
+
+    ++m_nbCopies;
+    if ( m_copyLogging == true )
+        qDebug() << "Frame arena: deep copy of a" << width << 'x' << height << "frame ("
+                << nbOctets << "bytes), from" << callSite;
+}
+
+void
+FrameArena::makeRoom( quint64 size )
+{
+    if ( m_budget == 0 )
+        return ;
+    while ( m_bytesInUse + m_bytesIdle + size > m_budget && m_bytesIdle > 0 )
+    {
+        //Find the oldest idle buffer, whatever its size class.
+        QHash<SizeClass, QList<IdleBuffer> >::iterator  it = m_idleBuffers.begin();
+        QHash<SizeClass, QList<IdleBuffer> >::iterator  ite = m_idleBuffers.end();
+        QHash<SizeClass, QList<IdleBuffer> >::iterator  oldest = ite;
+        for ( ; it != ite; ++it )
+        {
+            if ( it.value().isEmpty() == true )
+                continue ;
+            if ( oldest == ite || it.value().first().since < oldest.value().first().since )
+                oldest = it;
+        }
+        if ( oldest == ite )
+            break ;
+        VideoFrame::alignedFree( oldest.value().takeFirst().buffer );
+        m_bytesIdle -= oldest.key().size;
+    }
+    if ( m_bytesInUse + m_bytesIdle + size > m_budget )
+    {
+        if ( m_overBudget == false )
+            qWarning() << "Frame arena is over its budget:" << m_bytesInUse + size
+                    << "bytes are in use, budget is" << m_budget;
+        m_overBudget = true;
+    }
+    else
+        m_overBudget = false;
+}
+
+void
+FrameArena::updateHighWaterMark()
+{
+    if ( m_bytesInUse + m_bytesIdle > m_highWaterMark )
+        m_highWaterMark = m_bytesInUse + m_bytesIdle;
+}
+
+void
+FrameArena::trim( qint64 maxIdleTime /*= DefaultIdleTimeout*/ )
+{
+    QMutexLocker    lock( m_mutex );
+    qint64          now = mdate();
+    quint64         freed = 0;
+
+    QHash<SizeClass, QList<IdleBuffer> >::iterator  it = m_idleBuffers.begin();
+    while ( it != m_idleBuffers.end() )
+    {
+        QList<IdleBuffer>&  idle = it.value();
+        while ( idle.isEmpty() == false && now - idle.first().since >= maxIdleTime )
+        {
+            VideoFrame::alignedFree( idle.takeFirst().buffer );
+            freed += it.key().size;
+        }
+        if ( idle.isEmpty() == true )
+            it = m_idleBuffers.erase( it );
+        else
+            ++it;
+    }
+    m_bytesIdle -= freed;
+}
+
+void
+FrameArena::setBudget( quint64 budget )
+{
+    QMutexLocker    lock( m_mutex );
+    m_budget = budget;
+    makeRoom( 0 );
+}
+
+void
+FrameArena::budgetChanged( const QVariant& budget )
+{
+    setBudget( budget.toULongLong() * 1024 * 1024 );
+}
+
+quint64
+FrameArena::budget() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_budget;
+}
+
+quint64
+FrameArena::bytesInUse() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_bytesInUse;
+}
+
+quint64
+FrameArena::bytesIdle() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_bytesIdle;
+}
+
+quint64
+FrameArena::highWaterMark() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_highWaterMark;
+}
+
+void
+FrameArena::resetHighWaterMark()
+{
+    QMutexLocker    lock( m_mutex );
+    m_highWaterMark = m_bytesInUse + m_bytesIdle;
+}
+
+quint64
+FrameArena::nbCopies() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_nbCopies;
+}
+
+void
+FrameArena::setCopyLogging( bool enabled )
+{
+    QMutexLocker    lock( m_mutex );
+    m_copyLogging = enabled;
+}
+
+bool
+FrameArena::copyLogging() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_copyLogging;
+}
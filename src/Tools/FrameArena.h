@@ -0,0 +1,140 @@
+/*****************************************************************************
+ * FrameArena.h: Process wide video frame allocator
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include "LightVideoFrame.h"
+#include "Singleton.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+
+class   QMutex;
+class   QVariant;
+
+/**
+ *  \brief  Hands out aligned frame buffers, and keeps released ones for later use.
+ *
+ *  Buffers are sorted in size classes, keyed by the frame's width, height, and
+ *  size (which depends on the frame format).
+ *  The total amount of memory (used and idle buffers) is kept under a budget, by
+ *  freeing idle buffers instead of parking them. Buffers that stay idle for too
+ *  long are freed as well.
+ *  This is used as the default VideoFrame allocator by the MainWorkflow.
+ *  Buffers come from VideoFrame::alignedAlloc(), so they meet the alignment
+ *  requirements of the vectorized kernels.
+ */
+class   FrameArena : public QObject, public IVideoFrameAllocator,
+                     public Singleton<FrameArena>
+{
+    Q_OBJECT
+
+    public:
+        /// \brief  Idle buffers older than this are freed when trimming (in µs)
+        static const qint64     DefaultIdleTimeout = 10000000;
+
+        virtual quint8*         allocate( quint32 width, quint32 height, quint32 nbOctets );
+        virtual void            release( quint8* buffer, quint32 width, quint32 height,
+                                         quint32 nbOctets );
+        virtual void            copied( quint32 width, quint32 height, quint32 nbOctets,
+                                        const char* callSite );
+
+        /**
+         *  \brief  Free every buffer that has been idle for longer than maxIdleTime
+         *  \param  maxIdleTime The maximum idle time, in microseconds.
+         *                      0 frees every idle buffer.
+         */
+        void                    trim( qint64 maxIdleTime = DefaultIdleTimeout );
+
+        void                    setBudget( quint64 budget );
+        quint64                 budget() const;
+        /// \brief  Bytes currently handed out to frames
+        quint64                 bytesInUse() const;
+        /// \brief  Bytes currently parked in the arena
+        quint64                 bytesIdle() const;
+        /// \brief  The highest amount of memory ever held by the arena
+        quint64                 highWaterMark() const;
+        void                    resetHighWaterMark();
+        /// \brief  The number of deep copies of the frames allocated by the arena
+        quint64                 nbCopies() const;
+        /**
+         *  \brief  Log every deep copy of an arena frame, along with its call site.
+         */
+        void                    setCopyLogging( bool enabled );
+        bool                    copyLogging() const;
+
+    private:
+        FrameArena();
+        virtual ~FrameArena();
+
+        struct  SizeClass
+        {
+            SizeClass( quint32 w, quint32 h, quint32 s ) :
+                    width( w ), height( h ), size( s ) {}
+            bool    operator==( const SizeClass& sc ) const
+            {
+                return width == sc.width && height == sc.height && size == sc.size;
+            }
+            quint32     width;
+            quint32     height;
+            quint32     size;
+        };
+        struct  IdleBuffer
+        {
+            quint8*     buffer;
+            qint64      since;
+        };
+        friend uint             qHash( const SizeClass& sc );
+
+        /**
+         *  \brief  Free idle buffers, oldest first, until size more bytes fit
+         *          in the budget.
+         *  \warning    The arena mutex must be locked.
+         */
+        void                    makeRoom( quint64 size );
+        void                    updateHighWaterMark();
+
+    private:
+        QMutex*                                 m_mutex;
+        /// \brief  Most recently released buffers are at the end of each list
+        QHash<SizeClass, QList<IdleBuffer> >    m_idleBuffers;
+        quint64                                 m_budget;
+        quint64                                 m_bytesInUse;
+        quint64                                 m_bytesIdle;
+        quint64                                 m_highWaterMark;
+        bool                                    m_overBudget;
+        quint64                                 m_nbCopies;
+        bool                                    m_copyLogging;
+
+    private slots:
+        /**
+         *  \brief  Used to watch the budget preference, which is expressed in MB
+         */
+        void                    budgetChanged( const QVariant& budget );
+
+        friend class    Singleton<FrameArena>;
+};
+
+#endif // FRAMEARENA_H
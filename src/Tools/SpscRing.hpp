@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * SpscRing.hpp: Bounded lock-free single producer / single consumer ring
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#include <QAtomicInt>
+#include <QtGlobal>
+
+/**
+ *  \brief  A bounded ring buffer that can be used without any lock, as long as
+ *          there is only one thread pushing, and one thread popping at a time.
+ *
+ *  The producer only writes m_tail, the consumer only writes m_head. Each side
+ *  publishes its index with a release barrier, and reads the other side's index
+ *  with an acquire barrier, so a slot is never read before it has been written.
+ *  One slot is always left empty to tell a full ring from an empty one.
+ */
+template <typename T>
+class       SpscRing
+{
+public:
+    SpscRing( quint32 capacity ) :
+        m_head( 0 ),
+        m_tail( 0 ),
+        m_nbEmpty( 0 ),
+        m_nbFull( 0 )
+    {
+        //Round the capacity (plus the sentinel slot) up to a power of two.
+        quint32     size = 2;
+        while ( size < capacity + 1 )
+            size <<= 1;
+        m_mask = size - 1;
+        m_slots = new T[size];
+    }
+    ~SpscRing()
+    {
+        delete[] m_slots;
+    }
+    /**
+     *  \brief  Producer side only.
+     *  \return false if the ring was full. The value is not inserted in this case.
+     */
+    bool        push( const T& value )
+    {
+        int     tail = m_tail;
+        int     next = ( tail + 1 ) & m_mask;
+
+        if ( next == m_head.fetchAndAddAcquire( 0 ) )
+        {
+            m_nbFull.ref();
+            return false;
+        }
+        m_slots[tail] = value;
+        m_tail.fetchAndStoreRelease( next );
+        return true;
+    }
+    /**
+     *  \brief  Consumer side only.
+     *  \return false if the ring was empty.
+     */
+    bool        pop( T& value )
+    {
+        int     head = m_head;
+
+        if ( head == m_tail.fetchAndAddAcquire( 0 ) )
+        {
+            m_nbEmpty.ref();
+            return false;
+        }
+        value = m_slots[head];
+        m_head.fetchAndStoreRelease( ( head + 1 ) & m_mask );
+        return true;
+    }
+    /**
+     *  \brief  Consumer side only. Same as pop(), but the value stays in the ring.
+     */
+    bool        peek( T& value )
+    {
+        int     head = m_head;
+
+        if ( head == m_tail.fetchAndAddAcquire( 0 ) )
+        {
+            m_nbEmpty.ref();
+            return false;
+        }
+        value = m_slots[head];
+        return true;
+    }
+    /**
+     *  \brief  Can be called from any thread, but the result is only a snapshot.
+     */
+    quint32     count() const
+    {
+        return ( (int)m_tail - (int)m_head ) & m_mask;
+    }
+    bool        isEmpty() const
+    {
+        return count() == 0;
+    }
+    quint32     capacity() const
+    {
+        return m_mask;
+    }
+    /**
+     *  \return The number of times pop() or peek() found the ring empty.
+     */
+    int         nbEmpty() const
+    {
+        return m_nbEmpty;
+    }
+    /**
+     *  \return The number of times push() found the ring full.
+     */
+    int         nbFull() const
+    {
+        return m_nbFull;
+    }
+
+private:
+    Q_DISABLE_COPY( SpscRing )
+
+    T*                  m_slots;
+    int                 m_mask;
+    QAtomicInt          m_head;
+    QAtomicInt          m_tail;
+    QAtomicInt          m_nbEmpty;
+    QAtomicInt          m_nbFull;
+};
+
+#endif // SPSCRING_HPP
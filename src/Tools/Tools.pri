@@ -1,10 +1,12 @@
-HEADERS += MemoryPool.hpp \
+HEADERS += FrameArena.h \
     QSingleton.hpp \
     Singleton.hpp \
+    SpscRing.hpp \
     Toggleable.hpp \
     WaitCondition.hpp \
     VlmcDebug.h \
     Pool.hpp \
     mdate.h \
     SynchronisationHelper.hpp
-SOURCES += VlmcDebug.cpp
+SOURCES += FrameArena.cpp \
+    VlmcDebug.cpp
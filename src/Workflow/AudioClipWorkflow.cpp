@@ -23,12 +23,18 @@
 #include <QtDebug>
 
 #include "AudioClipWorkflow.h"
+#include "BufferDepthController.h"
 #include "VLCMedia.h"
 
 AudioClipWorkflow::AudioClipWorkflow( Clip *clip ) :
-        ClipWorkflow( clip )
+        ClipWorkflow( clip ),
+        m_samplePoolHandler( this )
 {
-    for ( quint32 i = 0; i < AudioClipWorkflow::nbBuffers; ++i )
+    m_stackedBufferPool = new StackedBufferPool<AudioSample*>( &m_samplePoolHandler );
+    m_depthController = new BufferDepthController( AudioClipWorkflow::minBuffers,
+                                                   AudioClipWorkflow::maxBuffers,
+                                                   AudioClipWorkflow::initialBuffers );
+    for ( quint32 i = 0; i < AudioClipWorkflow::initialBuffers; ++i )
     {
         AudioSample *as = new AudioSample;
         as->buff = NULL;
@@ -40,6 +46,8 @@ AudioClipWorkflow::AudioClipWorkflow( Clip *clip ) :
 
 AudioClipWorkflow::~AudioClipWorkflow()
 {
+    //Handles still owned by the renderer will delete the pool once released.
+    m_stackedBufferPool->detach();
     while ( m_availableBuffers.isEmpty() == false )
         delete m_availableBuffers.dequeue();
     while ( m_computedBuffers.isEmpty() == false )
@@ -70,8 +78,8 @@ AudioClipWorkflow::getOutput( ClipWorkflow::GetMode mode )
         return NULL;
     if ( mode == ClipWorkflow::Get )
         qCritical() << "A sound buffer should never be asked with 'Get' mode";
-    ::StackedBuffer<AudioSample*> *buff = new StackedBuffer(
-            m_computedBuffers.dequeue(), this, true );
+    ::StackedBuffer<AudioSample*> *buff = m_stackedBufferPool->get(
+            m_computedBuffers.dequeue(), true );
     postGetOutput();
     return buff;
 }
@@ -160,7 +168,7 @@ AudioClipWorkflow::getNbComputedBuffers() const
 quint32
 AudioClipWorkflow::getMaxComputedBuffers() const
 {
-    return AudioClipWorkflow::nbBuffers;
+    return m_depthController->depth();
 }
 
 void
@@ -182,18 +190,13 @@ AudioClipWorkflow::flushComputedBuffers()
     }
 }
 
-AudioClipWorkflow::StackedBuffer::StackedBuffer( AudioClipWorkflow::AudioSample *as,
-                                                AudioClipWorkflow *poolHandler,
-                                                bool mustBeReleased) :
-    ::StackedBuffer<AudioClipWorkflow::AudioSample*>( as, mustBeReleased ),
-    m_poolHandler( poolHandler )
+AudioClipWorkflow::SamplePoolHandler::SamplePoolHandler( AudioClipWorkflow *clipWorkflow ) :
+    m_clipWorkflow( clipWorkflow )
 {
 }
 
 void
-AudioClipWorkflow::StackedBuffer::release()
+AudioClipWorkflow::SamplePoolHandler::releaseBuffer( AudioClipWorkflow::AudioSample *sample )
 {
-    if ( m_mustRelease == true && m_poolHandler.isNull() == false )
-        m_poolHandler->releaseBuffer( m_buff );
-    delete this;
+    m_clipWorkflow->releaseBuffer( sample );
 }
@@ -26,7 +26,7 @@
 #include "ClipWorkflow.h"
 #include "StackedBuffer.hpp"
 
-#include <QPointer>
+#include <QQueue>
 
 class   AudioClipWorkflow : public ClipWorkflow
 {
@@ -42,14 +42,19 @@ class   AudioClipWorkflow : public ClipWorkflow
             qint64          ptsDiff;
             quint32         debugId;
         };
-        class   StackedBuffer : public ::StackedBuffer<AudioSample*>
+        /**
+         *  \brief  Gives the samples back to their AudioClipWorkflow
+         *
+         *  As AudioSample has to be declared before the handler, the workflow
+         *  can't implement the handler itself.
+         */
+        class   SamplePoolHandler : public StackedBufferPool<AudioSample*>::Handler
         {
             public:
-                StackedBuffer( AudioSample* lvf, AudioClipWorkflow* poolHandler,
-                                    bool mustBeReleased = true);
-                virtual void        release();
+                SamplePoolHandler( AudioClipWorkflow* clipWorkflow );
+                virtual void        releaseBuffer( AudioSample* sample );
             private:
-                QPointer<AudioClipWorkflow>     m_poolHandler;
+                AudioClipWorkflow*  m_clipWorkflow;
         };
 
         AudioClipWorkflow( Clip* clip );
@@ -69,6 +74,8 @@ class   AudioClipWorkflow : public ClipWorkflow
     private:
         QQueue<AudioSample*>        m_computedBuffers;
         QQueue<AudioSample*>        m_availableBuffers;
+        SamplePoolHandler           m_samplePoolHandler;
+        StackedBufferPool<AudioSample*>     *m_stackedBufferPool;
         void                        initVlcOutput();
         AudioSample*                createBuffer( size_t size );
         static void                 lock( AudioClipWorkflow* clipWorkflow,
@@ -79,8 +86,13 @@ class   AudioClipWorkflow : public ClipWorkflow
                                             quint32 bits_per_sample,
                                             quint32 size, qint64 pts );
 
-        //FIXME: this is totally random powered ! Please adjust with a value that does make sense...
-        static const quint32   nbBuffers = 256;
+        /**
+         *  \brief  Bounds of the adaptive buffer depth
+         *  \sa     BufferDepthController
+         */
+        static const quint32   minBuffers = 16;
+        static const quint32   maxBuffers = 256;
+        static const quint32   initialBuffers = 64;
 };
 
 #endif // AUDIOCLIPWORKFLOW_H
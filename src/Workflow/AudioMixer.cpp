@@ -0,0 +1,456 @@
+/*****************************************************************************
+ * AudioMixer.cpp: Mixes the audio tracks together
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "AudioMixer.h"
+
+#include <QMutex>
+#include <QtDebug>
+
+#include <string.h>
+
+//The SIMD implementations are compiled for their own instruction set only, so
+//the rest of the code doesn't need any particular compiler flag.
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+# define AUDIOMIXER_X86
+# include <immintrin.h>
+# define TARGET( isa )   __attribute__(( target( isa ) ))
+#endif
+
+AudioMixer::AudioMixer( unsigned int nbTracks ) :
+        m_nbTracks( nbTracks ),
+        m_currentBlock( 0 )
+{
+    m_mutex = new QMutex;
+    m_tracks = new Track[nbTracks];
+    for ( unsigned int i = 0; i < nbTracks; ++i )
+    {
+        m_tracks[i].samples = NULL;
+        m_tracks[i].capacity = 0;
+        m_tracks[i].count = 0;
+        m_tracks[i].gain = 1.0f;
+        m_tracks[i].muted = false;
+        m_tracks[i].fed = false;
+    }
+    for ( int i = 0; i < NbOutputBlocks; ++i )
+    {
+        m_blocks[i].buffer = NULL;
+        m_blocks[i].capacity = 0;
+        m_blocks[i].sample.buff = NULL;
+        m_blocks[i].sample.size = 0;
+        m_blocks[i].sample.nbSample = 0;
+        m_blocks[i].sample.nbChannels = NbChannels;
+        m_blocks[i].sample.ptsDiff = 0;
+        m_blocks[i].sample.debugId = -1;
+    }
+    resetStats();
+}
+
+AudioMixer::~AudioMixer()
+{
+    for ( unsigned int i = 0; i < m_nbTracks; ++i )
+        delete[] m_tracks[i].samples;
+    delete[] m_tracks;
+    for ( int i = 0; i < NbOutputBlocks; ++i )
+        delete[] m_blocks[i].buffer;
+    delete m_mutex;
+}
+
+void
+AudioMixer::setGain( unsigned int trackId, float gain )
+{
+    QMutexLocker    lock( m_mutex );
+
+    Q_ASSERT( trackId < m_nbTracks );
+    m_tracks[trackId].gain = gain;
+}
+
+float
+AudioMixer::gain( unsigned int trackId ) const
+{
+    QMutexLocker    lock( m_mutex );
+
+    Q_ASSERT( trackId < m_nbTracks );
+    return m_tracks[trackId].gain;
+}
+
+void
+AudioMixer::setMuted( unsigned int trackId, bool muted )
+{
+    QMutexLocker    lock( m_mutex );
+
+    Q_ASSERT( trackId < m_nbTracks );
+    m_tracks[trackId].muted = muted;
+}
+
+bool
+AudioMixer::isMuted( unsigned int trackId ) const
+{
+    QMutexLocker    lock( m_mutex );
+
+    Q_ASSERT( trackId < m_nbTracks );
+    return m_tracks[trackId].muted;
+}
+
+void
+AudioMixer::reserve( float*& buffer, quint32& capacity, quint32 size, quint32 nbKept )
+{
+    if ( size <= capacity )
+        return ;
+    float*  newBuffer = new float[size];
+    if ( nbKept > 0 )
+        memcpy( newBuffer, buffer, nbKept * sizeof( float ) );
+    delete[] buffer;
+    buffer = newBuffer;
+    capacity = size;
+}
+
+void
+AudioMixer::addInput( unsigned int trackId, const AudioClipWorkflow::AudioSample* sample )
+{
+    QMutexLocker    lock( m_mutex );
+
+    Q_ASSERT( trackId < m_nbTracks );
+    if ( sample->nbChannels != NbChannels )
+    {
+        qWarning() << "Can't mix a buffer with" << sample->nbChannels << "channels";
+        return ;
+    }
+    Track&      track = m_tracks[trackId];
+    quint32     nbSamples = sample->nbSample * NbChannels;
+    quint32     maxSamples = MaxQueuedFrames * NbChannels;
+
+    track.fed = true;
+    //Keep the most recent samples if the track produced far more than it consumed.
+    if ( nbSamples > maxSamples )
+    {
+        m_stats.nbDroppedFrames += ( nbSamples - maxSamples ) / NbChannels;
+        nbSamples = maxSamples;
+    }
+    if ( track.count + nbSamples > maxSamples )
+    {
+        quint32     nbDropped = track.count + nbSamples - maxSamples;
+        memmove( track.samples, track.samples + nbDropped,
+                 ( track.count - nbDropped ) * sizeof( float ) );
+        track.count -= nbDropped;
+        m_stats.nbDroppedFrames += nbDropped / NbChannels;
+    }
+    reserve( track.samples, track.capacity, track.count + nbSamples, track.count );
+    const float*    src = reinterpret_cast<const float*>( sample->buff ) +
+                          sample->nbSample * NbChannels - nbSamples;
+    memcpy( track.samples + track.count, src, nbSamples * sizeof( float ) );
+    track.count += nbSamples;
+}
+
+quint32
+AudioMixer::nbQueuedFrames( unsigned int trackId ) const
+{
+    QMutexLocker    lock( m_mutex );
+
+    Q_ASSERT( trackId < m_nbTracks );
+    return m_tracks[trackId].count / NbChannels;
+}
+
+bool
+AudioMixer::isHeard( const Track& track ) const
+{
+    return track.count > 0 && track.muted == false && track.gain != 0.0f;
+}
+
+AudioClipWorkflow::AudioSample*
+AudioMixer::mix( quint32 nbFrames )
+{
+    QMutexLocker    lock( m_mutex );
+
+    if ( nbFrames == 0 )
+        return NULL;
+
+    OutputBlock&    block = m_blocks[m_currentBlock];
+    quint32         nbSamples = nbFrames * NbChannels;
+    int             lastHeard = -1;
+
+    m_currentBlock = ( m_currentBlock + 1 ) % NbOutputBlocks;
+    reserve( block.buffer, block.capacity, nbSamples, 0 );
+    memset( block.buffer, 0, nbSamples * sizeof( float ) );
+    for ( unsigned int i = 0; i < m_nbTracks; ++i )
+    {
+        if ( isHeard( m_tracks[i] ) == true )
+            lastHeard = i;
+    }
+    for ( unsigned int i = 0; i < m_nbTracks; ++i )
+    {
+        Track&      track = m_tracks[i];
+
+        if ( track.count == 0 )
+        {
+            track.fed = false;
+            continue ;
+        }
+        if ( track.count < nbSamples )
+        {
+            if ( track.fed == true )
+                ++m_stats.nbUnderruns;
+            reserve( track.samples, track.capacity, nbSamples, track.count );
+            memset( track.samples + track.count, 0,
+                    ( nbSamples - track.count ) * sizeof( float ) );
+            track.count = nbSamples;
+        }
+        //The last track heard clips the sum, so the block is only walked once
+        //per track.
+        if ( (int)i == lastHeard )
+            m_stats.nbClippedSamples += accumulateAndClip( block.buffer, track.samples,
+                                                           nbSamples, track.gain,
+                                                           m_stats.peak );
+        else if ( isHeard( track ) == true )
+            accumulate( block.buffer, track.samples, nbSamples, track.gain );
+        track.count -= nbSamples;
+        memmove( track.samples, track.samples + nbSamples,
+                 track.count * sizeof( float ) );
+        track.fed = false;
+    }
+    ++m_stats.nbBlocks;
+    block.sample.buff = reinterpret_cast<unsigned char*>( block.buffer );
+    block.sample.size = nbSamples * sizeof( float );
+    block.sample.nbSample = nbFrames;
+    block.sample.ptsDiff = (qint64)nbFrames * 1000000 / Rate;
+    return &block.sample;
+}
+
+void
+AudioMixer::flush()
+{
+    QMutexLocker    lock( m_mutex );
+
+    for ( unsigned int i = 0; i < m_nbTracks; ++i )
+    {
+        m_tracks[i].count = 0;
+        m_tracks[i].fed = false;
+    }
+}
+
+AudioMixer::Stats
+AudioMixer::stats() const
+{
+    QMutexLocker    lock( m_mutex );
+
+    return m_stats;
+}
+
+void
+AudioMixer::resetStats()
+{
+    QMutexLocker    lock( m_mutex );
+
+    m_stats.nbBlocks = 0;
+    m_stats.nbClippedSamples = 0;
+    m_stats.peak = 0.0f;
+    m_stats.nbUnderruns = 0;
+    m_stats.nbDroppedFrames = 0;
+}
+
+static void
+accumulateScalar( float* dst, const float* src, quint32 nbSamples, float gain )
+{
+    for ( quint32 i = 0; i < nbSamples; ++i )
+        dst[i] += src[i] * gain;
+}
+
+static quint32
+accumulateAndClipScalar( float* dst, const float* src, quint32 nbSamples,
+                         float gain, float& peak )
+{
+    quint32     nbClipped = 0;
+
+    for ( quint32 i = 0; i < nbSamples; ++i )
+    {
+        float   v = dst[i] + src[i] * gain;
+        float   abs = v < 0.0f ? -v : v;
+
+        if ( abs > peak )
+            peak = abs;
+        if ( abs > 1.0f )
+        {
+            ++nbClipped;
+            v = v < 0.0f ? -1.0f : 1.0f;
+        }
+        dst[i] = v;
+    }
+    return nbClipped;
+}
+
+#if defined( AUDIOMIXER_X86 )
+
+//Number of bits set in a 4 bits mask.
+static const quint32    nbBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3,
+                                       1, 2, 2, 3, 2, 3, 3, 4 };
+
+TARGET( "sse2" ) static void
+accumulateSSE2( float* dst, const float* src, quint32 nbSamples, float gain )
+{
+    quint32     i = 0;
+    __m128      g = _mm_set1_ps( gain );
+
+    for ( ; i + 8 <= nbSamples; i += 8 )
+    {
+        __m128  a = _mm_loadu_ps( dst + i );
+        __m128  b = _mm_loadu_ps( dst + i + 4 );
+
+        a = _mm_add_ps( a, _mm_mul_ps( _mm_loadu_ps( src + i ), g ) );
+        b = _mm_add_ps( b, _mm_mul_ps( _mm_loadu_ps( src + i + 4 ), g ) );
+        _mm_storeu_ps( dst + i, a );
+        _mm_storeu_ps( dst + i + 4, b );
+    }
+    accumulateScalar( dst + i, src + i, nbSamples - i, gain );
+}
+
+TARGET( "sse2" ) static quint32
+accumulateAndClipSSE2( float* dst, const float* src, quint32 nbSamples,
+                       float gain, float& peak )
+{
+    quint32     i = 0;
+    quint32     nbClipped = 0;
+    __m128      g = _mm_set1_ps( gain );
+    __m128      one = _mm_set1_ps( 1.0f );
+    __m128      minusOne = _mm_set1_ps( -1.0f );
+    __m128      signMask = _mm_set1_ps( -0.0f );
+    __m128      peaks = _mm_setzero_ps();
+
+    for ( ; i + 4 <= nbSamples; i += 4 )
+    {
+        __m128  v = _mm_add_ps( _mm_loadu_ps( dst + i ),
+                                _mm_mul_ps( _mm_loadu_ps( src + i ), g ) );
+        __m128  abs = _mm_andnot_ps( signMask, v );
+
+        peaks = _mm_max_ps( peaks, abs );
+        nbClipped += nbBits[_mm_movemask_ps( _mm_cmpgt_ps( abs, one ) )];
+        _mm_storeu_ps( dst + i, _mm_max_ps( _mm_min_ps( v, one ), minusOne ) );
+    }
+    float       p[4];
+    _mm_storeu_ps( p, peaks );
+    for ( int j = 0; j < 4; ++j )
+    {
+        if ( p[j] > peak )
+            peak = p[j];
+    }
+    return nbClipped + accumulateAndClipScalar( dst + i, src + i, nbSamples - i,
+                                                gain, peak );
+}
+
+TARGET( "avx2" ) static void
+accumulateAVX2( float* dst, const float* src, quint32 nbSamples, float gain )
+{
+    quint32     i = 0;
+    __m256      g = _mm256_set1_ps( gain );
+
+    for ( ; i + 16 <= nbSamples; i += 16 )
+    {
+        __m256  a = _mm256_loadu_ps( dst + i );
+        __m256  b = _mm256_loadu_ps( dst + i + 8 );
+
+        a = _mm256_add_ps( a, _mm256_mul_ps( _mm256_loadu_ps( src + i ), g ) );
+        b = _mm256_add_ps( b, _mm256_mul_ps( _mm256_loadu_ps( src + i + 8 ), g ) );
+        _mm256_storeu_ps( dst + i, a );
+        _mm256_storeu_ps( dst + i + 8, b );
+    }
+    accumulateScalar( dst + i, src + i, nbSamples - i, gain );
+}
+
+TARGET( "avx2" ) static quint32
+accumulateAndClipAVX2( float* dst, const float* src, quint32 nbSamples,
+                       float gain, float& peak )
+{
+    quint32     i = 0;
+    quint32     nbClipped = 0;
+    __m256      g = _mm256_set1_ps( gain );
+    __m256      one = _mm256_set1_ps( 1.0f );
+    __m256      minusOne = _mm256_set1_ps( -1.0f );
+    __m256      signMask = _mm256_set1_ps( -0.0f );
+    __m256      peaks = _mm256_setzero_ps();
+
+    for ( ; i + 8 <= nbSamples; i += 8 )
+    {
+        __m256  v = _mm256_add_ps( _mm256_loadu_ps( dst + i ),
+                                   _mm256_mul_ps( _mm256_loadu_ps( src + i ), g ) );
+        __m256  abs = _mm256_andnot_ps( signMask, v );
+        int     clipped = _mm256_movemask_ps( _mm256_cmp_ps( abs, one, _CMP_GT_OQ ) );
+
+        peaks = _mm256_max_ps( peaks, abs );
+        nbClipped += nbBits[clipped & 15] + nbBits[clipped >> 4];
+        _mm256_storeu_ps( dst + i, _mm256_max_ps( _mm256_min_ps( v, one ), minusOne ) );
+    }
+    float       p[8];
+    _mm256_storeu_ps( p, peaks );
+    for ( int j = 0; j < 8; ++j )
+    {
+        if ( p[j] > peak )
+            peak = p[j];
+    }
+    return nbClipped + accumulateAndClipScalar( dst + i, src + i, nbSamples - i,
+                                                gain, peak );
+}
+
+#endif // AUDIOMIXER_X86
+
+struct  MixKernels
+{
+    void    (*accumulate)( float* dst, const float* src, quint32 nbSamples, float gain );
+    quint32 (*accumulateAndClip)( float* dst, const float* src, quint32 nbSamples,
+                                  float gain, float& peak );
+};
+
+static const MixKernels     scalarKernels = { accumulateScalar, accumulateAndClipScalar };
+#if defined( AUDIOMIXER_X86 )
+static const MixKernels     sse2Kernels = { accumulateSSE2, accumulateAndClipSSE2 };
+static const MixKernels     avx2Kernels = { accumulateAVX2, accumulateAndClipAVX2 };
+#endif
+
+static const MixKernels*
+selectMixKernels()
+{
+#if defined( AUDIOMIXER_X86 )
+    //This runs before main(), maybe before libgcc initialized the cpu model.
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) )
+        return &avx2Kernels;
+    if ( __builtin_cpu_supports( "sse2" ) )
+        return &sse2Kernels;
+#endif
+    return &scalarKernels;
+}
+
+/**
+ *  \brief  Chosen once, during the static initialization, so that the mixing
+ *          threads only ever read it.
+ */
+static const MixKernels* const  s_mixKernels = selectMixKernels();
+
+void
+AudioMixer::accumulate( float* dst, const float* src, quint32 nbSamples, float gain )
+{
+    s_mixKernels->accumulate( dst, src, nbSamples, gain );
+}
+
+quint32
+AudioMixer::accumulateAndClip( float* dst, const float* src, quint32 nbSamples,
+                               float gain, float& peak )
+{
+    return s_mixKernels->accumulateAndClip( dst, src, nbSamples, gain, peak );
+}
@@ -0,0 +1,152 @@
+/*****************************************************************************
+ * AudioMixer.h: Mixes the audio tracks together
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include "AudioClipWorkflow.h"
+
+class   QMutex;
+
+/**
+ *  \brief  Sums the audio tracks outputs into one block.
+ *
+ *  Tracks don't produce buffers of the same size, so each track's samples are
+ *  queued, and a block only takes as many samples from each track as the
+ *  block size. What remains is used by the next block. A track that can't fill
+ *  a block is padded with silence.
+ *  Every buffer is expected to be interleaved stereo 32 bits float, at 48kHz,
+ *  as configured by AudioClipWorkflow.
+ */
+class   AudioMixer
+{
+    public:
+        static const quint32    NbChannels = 2;
+        static const quint32    Rate = 48000;
+        /// \brief  A track can't queue more frames than this. The oldest are dropped.
+        static const quint32    MaxQueuedFrames = 16384;
+
+        struct  Stats
+        {
+            qint64      nbBlocks;
+            /// \brief  The number of samples that were out of the [-1;1] range.
+            qint64      nbClippedSamples;
+            /// \brief  The highest absolute sample value, before clipping.
+            float       peak;
+            /// \brief  The number of times a track had to be padded with silence.
+            qint64      nbUnderruns;
+            qint64      nbDroppedFrames;
+        };
+
+        AudioMixer( unsigned int nbTracks );
+        ~AudioMixer();
+
+        void                    setGain( unsigned int trackId, float gain );
+        float                   gain( unsigned int trackId ) const;
+        /**
+         *  \brief  A muted track still consumes its samples, but isn't heard.
+         */
+        void                    setMuted( unsigned int trackId, bool muted );
+        bool                    isMuted( unsigned int trackId ) const;
+
+        /**
+         *  \brief  Queue a track output. The samples are copied, so the buffer
+         *          can be released right after this call.
+         */
+        void                    addInput( unsigned int trackId,
+                                          const AudioClipWorkflow::AudioSample* sample );
+        /**
+         *  \return The number of frames queued for this track.
+         */
+        quint32                 nbQueuedFrames( unsigned int trackId ) const;
+        /**
+         *  \brief  Mix nbFrames frames of every track.
+         *
+         *  \return The mixed block, or NULL if nbFrames is 0. The block is valid
+         *          until mix() has been called NbOutputBlocks more times.
+         */
+        AudioClipWorkflow::AudioSample*     mix( quint32 nbFrames );
+        /**
+         *  \brief  Drop every queued sample, ie. when the render stops.
+         */
+        void                    flush();
+
+        Stats                   stats() const;
+        void                    resetStats();
+
+        /**
+         *  \brief  dst[i] += src[i] * gain
+         *
+         *  The best instruction set the CPU supports is picked on the first call.
+         */
+        static void             accumulate( float* dst, const float* src,
+                                            quint32 nbSamples, float gain );
+        /**
+         *  \brief  Same as accumulate(), but the result is clamped in [-1;1].
+         *
+         *  \param  peak    Updated with the highest absolute value, before clamping.
+         *  \return The number of samples that had to be clamped.
+         */
+        static quint32          accumulateAndClip( float* dst, const float* src,
+                                                   quint32 nbSamples, float gain,
+                                                   float& peak );
+
+    private:
+        Q_DISABLE_COPY( AudioMixer )
+
+        static const int        NbOutputBlocks = 4;
+
+        struct  Track
+        {
+            float*      samples;
+            /// \brief  In samples, not in frames
+            quint32     capacity;
+            quint32     count;
+            float       gain;
+            bool        muted;
+            /// \brief  true if the track has been given some samples since the last mix
+            bool        fed;
+        };
+        struct  OutputBlock
+        {
+            AudioClipWorkflow::AudioSample  sample;
+            float*                          buffer;
+            quint32                         capacity;
+        };
+
+        /**
+         *  \brief  Grow buffer to size samples, keeping its nbKept first samples.
+         */
+        static void             reserve( float*& buffer, quint32& capacity, quint32 size,
+                                         quint32 nbKept );
+        bool                    isHeard( const Track& track ) const;
+
+    private:
+        Track*                  m_tracks;
+        unsigned int            m_nbTracks;
+        OutputBlock             m_blocks[NbOutputBlocks];
+        int                     m_currentBlock;
+        Stats                   m_stats;
+        mutable QMutex*         m_mutex;
+};
+
+#endif // AUDIOMIXER_H
@@ -0,0 +1,197 @@
+/*****************************************************************************
+ * BufferDepthController.cpp: Adaptive clip buffer depth
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+
+#include "BufferDepthController.h"
+#include "mdate.h"
+
+BufferDepthController::BufferDepthController( quint32 minDepth, quint32 maxDepth,
+                                              quint32 initialDepth ) :
+        m_minDepth( minDepth ),
+        m_maxDepth( maxDepth ),
+        m_depth( qBound( minDepth, initialDepth, maxDepth ) ),
+        m_nbUnderruns( 0 ),
+        m_nbPauses( 0 ),
+        m_lastProduced( -1 ),
+        m_producerReset( 0 ),
+        m_produceInterval( 0 ),
+        m_jitter( 0 ),
+        m_consumeInterval( 0 )
+{
+    reset();
+}
+
+void
+BufferDepthController::reset()
+{
+    m_producerReset.fetchAndStoreOrdered( 1 );
+    m_lastConsumed = -1;
+    m_windowLength = 0;
+    m_windowMinLevel = m_maxDepth;
+}
+
+void
+BufferDepthController::produced()
+{
+    qint64  now = mdate();
+
+    if ( m_producerReset.fetchAndStoreOrdered( 0 ) == 1 )
+        m_lastProduced = -1;
+    if ( m_lastProduced != -1 )
+    {
+        qint64  interval = now - m_lastProduced;
+        //Don't take the time spent in pause into account.
+        if ( interval < MaxInterval )
+        {
+            int     average = m_produceInterval;
+            if ( average == 0 )
+                average = interval;
+            qint64  deviation = qAbs( interval - average );
+            m_produceInterval = average + (int)( ( interval - average ) / 8 );
+            int     jitter = m_jitter;
+            m_jitter = jitter + (int)( ( deviation - jitter ) / 8 );
+        }
+    }
+    m_lastProduced = now;
+}
+
+void
+BufferDepthController::consumed( quint32 nbComputedBuffers )
+{
+    qint64  now = mdate();
+
+    if ( m_lastConsumed != -1 )
+    {
+        qint64  interval = now - m_lastConsumed;
+        if ( interval >= IdleDelay )
+        {
+            //The clip was idle, don't keep more than what it strictly needs.
+            setDepth( minimalDepth() );
+            m_windowLength = 0;
+            m_windowMinLevel = m_maxDepth;
+        }
+        else if ( interval < MaxInterval )
+        {
+            if ( m_consumeInterval == 0 )
+                m_consumeInterval = interval;
+            m_consumeInterval += ( interval - m_consumeInterval ) / 8;
+        }
+    }
+    m_lastConsumed = now;
+
+    m_windowMinLevel = qMin( m_windowMinLevel, nbComputedBuffers );
+    if ( ++m_windowLength >= depth() )
+    {
+        //We never went under half of the buffer for a whole depth worth of frames:
+        //this clip is over-provisioned.
+        quint32     d = depth();
+        if ( m_windowMinLevel > d / 2 )
+            setDepth( qMax( minimalDepth(), d - ( m_windowMinLevel - d / 2 ) / 2 ) );
+        m_windowLength = 0;
+        m_windowMinLevel = m_maxDepth;
+    }
+}
+
+void
+BufferDepthController::underrun()
+{
+    m_nbUnderruns.ref();
+    //Underruns happening before the first frame has been rendered are only
+    //the clip's startup latency, a deeper buffer wouldn't change anything.
+    if ( m_lastConsumed == -1 )
+        return ;
+    quint32     d = depth();
+    setDepth( d + qMax( 2u, d / 2 ) );
+    m_windowLength = 0;
+    m_windowMinLevel = m_maxDepth;
+}
+
+void
+BufferDepthController::paused()
+{
+    m_nbPauses.ref();
+}
+
+quint32
+BufferDepthController::minimalDepth() const
+{
+    qint64  jitter = m_jitter;
+    qint64  produceInterval = (int)m_produceInterval;
+
+    if ( m_consumeInterval <= 0 )
+        return m_minDepth;
+    //Be able to absorb 4 times the average jitter.
+    qint64  needed = ( 4 * jitter + m_consumeInterval - 1 ) / m_consumeInterval;
+    //If we can't decode as fast as we render, keep enough to last one more second.
+    if ( produceInterval > m_consumeInterval )
+        needed += 1000000 / m_consumeInterval - 1000000 / produceInterval;
+    return qBound( m_minDepth, m_minDepth + (quint32)qMin( needed, (qint64)m_maxDepth ),
+                   m_maxDepth );
+}
+
+void
+BufferDepthController::setDepth( quint32 depth )
+{
+    m_depth = (int)qBound( m_minDepth, depth, m_maxDepth );
+}
+
+quint32
+BufferDepthController::depth() const
+{
+    return (int)m_depth;
+}
+
+quint32
+BufferDepthController::resumeThreshold() const
+{
+    return depth() / 3;
+}
+
+int
+BufferDepthController::nbUnderruns() const
+{
+    return m_nbUnderruns;
+}
+
+int
+BufferDepthController::nbPauses() const
+{
+    return m_nbPauses;
+}
+
+int
+BufferDepthController::jitter() const
+{
+    return m_jitter;
+}
+
+int
+BufferDepthController::produceInterval() const
+{
+    return m_produceInterval;
+}
+
+qint64
+BufferDepthController::consumeInterval() const
+{
+    return m_consumeInterval;
+}
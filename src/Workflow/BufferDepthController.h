@@ -0,0 +1,110 @@
+/*****************************************************************************
+ * BufferDepthController.h: Adaptive clip buffer depth
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+
+#ifndef BUFFERDEPTHCONTROLLER_H
+#define BUFFERDEPTHCONTROLLER_H
+
+#include <QAtomicInt>
+#include <QtGlobal>
+
+/**
+ *  \brief  Computes how many buffers a ClipWorkflow should keep ahead of the
+ *          renderer.
+ *
+ *  The depth is derived from the measured production (decoding) and
+ *  consumption (rendering) intervals, and from the decoding jitter. The minimal
+ *  depth absorbs a few times the jitter, plus one second of deficit when the
+ *  decoder is slower than the renderer. Then:
+ *  - an underrun deepens the buffer right away;
+ *  - a clip that never came close to running dry during a whole depth worth of
+ *    frames is slowly shrunk, down to what the jitter requires;
+ *  - a clip that isn't consumed (preloaded, or idle) is shrunk to that minimum.
+ *
+ *  produced() and paused() are called from VLC's thread, every other method
+ *  from the rendering thread.
+ */
+class   BufferDepthController
+{
+    public:
+        BufferDepthController( quint32 minDepth, quint32 maxDepth, quint32 initialDepth );
+
+        /**
+         *  \brief  Forget the timings, but keep the learned depth.
+         *
+         *  This has to be called when the clip is (re)started or seeked. The
+         *  producer may still be running, so its own timings are only
+         *  forgotten on its next produced().
+         */
+        void                reset();
+        void                produced();
+        void                consumed( quint32 nbComputedBuffers );
+        void                underrun();
+        void                paused();
+
+        /// \brief  The number of buffers after which the producer should pause
+        quint32             depth() const;
+        /// \brief  The number of buffers under which the producer should resume
+        quint32             resumeThreshold() const;
+        int                 nbUnderruns() const;
+        int                 nbPauses() const;
+        /// \brief  The average decoding jitter, in microseconds
+        int                 jitter() const;
+        /// \brief  The average decoding interval, in microseconds
+        int                 produceInterval() const;
+        /// \brief  The average rendering interval, in microseconds
+        qint64              consumeInterval() const;
+
+    private:
+        quint32             minimalDepth() const;
+        void                setDepth( quint32 depth );
+
+    private:
+        /// \brief  Intervals longer than this are considered as pauses (in µs)
+        static const qint64 MaxInterval = 500000;
+        /// \brief  A clip not consumed for this long is considered idle (in µs)
+        static const qint64 IdleDelay = 1000000;
+
+        const quint32       m_minDepth;
+        const quint32       m_maxDepth;
+        QAtomicInt          m_depth;
+        QAtomicInt          m_nbUnderruns;
+        QAtomicInt          m_nbPauses;
+
+        //Producer side:
+        qint64              m_lastProduced;
+        /// \brief  Set by reset(), so the producer forgets m_lastProduced itself.
+        QAtomicInt          m_producerReset;
+        /// \brief  Average interval between two decoded buffers (in µs)
+        QAtomicInt          m_produceInterval;
+        /// \brief  Average deviation from m_produceInterval (in µs)
+        QAtomicInt          m_jitter;
+
+        //Consumer side:
+        qint64              m_lastConsumed;
+        /// \brief  Average interval between two rendered buffers (in µs)
+        qint64              m_consumeInterval;
+        quint32             m_windowLength;
+        quint32             m_windowMinLevel;
+};
+
+#endif // BUFFERDEPTHCONTROLLER_H
@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * ClipIndex.hpp: The clips of a track, sorted by starting frame
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef CLIPINDEX_HPP
+#define CLIPINDEX_HPP
+
+#include <QList>
+#include <QMap>
+
+/**
+ *  \brief  The clips of a track, sorted by starting frame, with a playback cursor.
+ *
+ *  seek() moves the cursor along with the playback, so finding the upcoming clips
+ *  costs nothing when the frames are rendered in order, and a lookup otherwise.
+ *  Every modification invalidates the cursor, so it never points to a removed clip.
+ *  This class isn't thread safe, the caller is responsible for locking.
+ */
+template <typename T>
+class   ClipIndex
+{
+    public:
+        typedef typename QMap<qint64, T>::iterator          iterator;
+        typedef typename QMap<qint64, T>::const_iterator    const_iterator;
+
+        ClipIndex() :
+                m_cursorFrame( 0 ),
+                m_cursorValid( false )
+        {
+        }
+
+        iterator            begin()
+        {
+            return m_clips.begin();
+        }
+        const_iterator      begin() const
+        {
+            return m_clips.begin();
+        }
+        const_iterator      constBegin() const
+        {
+            return m_clips.constBegin();
+        }
+        iterator            end()
+        {
+            return m_clips.end();
+        }
+        const_iterator      end() const
+        {
+            return m_clips.end();
+        }
+        const_iterator      constEnd() const
+        {
+            return m_clips.constEnd();
+        }
+        iterator            find( qint64 start )
+        {
+            return m_clips.find( start );
+        }
+        const_iterator      upperBound( qint64 frame ) const
+        {
+            return m_clips.upperBound( frame );
+        }
+        int                 count() const
+        {
+            return m_clips.count();
+        }
+        int                 size() const
+        {
+            return m_clips.size();
+        }
+        bool                isEmpty() const
+        {
+            return m_clips.isEmpty();
+        }
+        QList<T>            values() const
+        {
+            return m_clips.values();
+        }
+
+        /**
+         *  \brief  Insert a clip, replacing the one already starting at this frame.
+         */
+        iterator            insert( qint64 start, const T& clip )
+        {
+            m_cursorValid = false;
+            return m_clips.insert( start, clip );
+        }
+        iterator            erase( iterator it )
+        {
+            m_cursorValid = false;
+            return m_clips.erase( it );
+        }
+        void                clear()
+        {
+            m_cursorValid = false;
+            m_clips.clear();
+        }
+
+        /**
+         *  \brief  Return the first clip starting after currentFrame.
+         */
+        iterator            seek( qint64 currentFrame )
+        {
+            //Only follow the playback, jumps are faster to handle with a lookup.
+            if ( m_cursorValid == true && currentFrame >= m_cursorFrame &&
+                 currentFrame - m_cursorFrame <= 1 )
+            {
+                while ( m_cursor != m_clips.end() && m_cursor.key() <= currentFrame )
+                    ++m_cursor;
+            }
+            else
+            {
+                m_cursor = m_clips.upperBound( currentFrame );
+                m_cursorValid = true;
+            }
+            m_cursorFrame = currentFrame;
+            return m_cursor;
+        }
+
+    private:
+        QMap<qint64, T>     m_clips;
+        /**
+         *  \brief  The first clip starting after m_cursorFrame.
+         */
+        iterator            m_cursor;
+        qint64              m_cursorFrame;
+        bool                m_cursorValid;
+};
+
+#endif // CLIPINDEX_HPP
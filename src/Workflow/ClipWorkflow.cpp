@@ -21,10 +21,13 @@
  *****************************************************************************/
 
 #include "vlmc.h"
+#include "BufferDepthController.h"
 #include "ClipWorkflow.h"
-#include "MemoryPool.hpp"
 #include "LightVideoFrame.h"
+#include "MediaPlayerPool.h"
+#include "PreloadScheduler.h"
 #include "Clip.h"
+#include "SeekIndex.h"
 #include "VLCMediaPlayer.h"
 #include "WaitCondition.hpp"
 #include "VLCMedia.h"
@@ -34,9 +37,22 @@
 #include <QtDebug>
 
 ClipWorkflow::ClipWorkflow( Clip::Clip* clip ) :
+                m_initializeDate( -1 ),
+                m_startupLatency( -1 ),
+                m_prerollLatency( -1 ),
+                m_waitingFirstFrame( 0 ),
+                m_holdsPreloadSlot( 0 ),
+                m_seekTarget( -1 ),
+                m_seekDate( -1 ),
+                m_seekInFlight( 0 ),
+                m_seekDelayed( false ),
+                m_decodingProxy( false ),
                 m_mediaPlayer(NULL),
                 m_clip( clip ),
-                m_state( ClipWorkflow::Stopped )
+                m_state( ClipWorkflow::Stopped ),
+                m_depthController( NULL ),
+                m_measureSeeks( false ),
+                m_useProxy( false )
 {
     m_stateLock = new QReadWriteLock;
     m_initWaitCond = new WaitCondition;
@@ -54,20 +70,37 @@ ClipWorkflow::~ClipWorkflow()
     delete m_stateLock;
     delete m_availableBuffersMutex;
     delete m_computedBuffersMutex;
+    delete m_depthController;
 }
 
-void    ClipWorkflow::initialize()
+void    ClipWorkflow::initialize( bool preloading )
 {
 //    qDebug() << "Setting state to initializing";
     setState( ClipWorkflow::Initializing );
+    m_initializeDate = mdate();
+    m_prerollLatency = -1;
+    m_holdsPreloadSlot = preloading ? 1 : 0;
+    m_waitingFirstFrame = 1;
+    m_seekInFlight = 0;
+    m_seekDelayed = false;
 
 //    qDebug() << "State is Initializing.";
-    m_vlcMedia = new LibVLCpp::Media( m_clip->getParent()->mrl() );
+    //Renders to a file always decode the original media.
+    QString     proxyMrl;
+    if ( m_useProxy == true && m_fullSpeedRender == false )
+        proxyMrl = m_clip->getParent()->proxyMrl();
+    m_decodingProxy = proxyMrl.isEmpty() == false;
+    if ( m_decodingProxy == true )
+        m_vlcMedia = new LibVLCpp::Media( proxyMrl );
+    else
+        m_vlcMedia = new LibVLCpp::Media( m_clip->getParent()->mrl() );
     m_currentPts = -1;
     m_previousPts = -1;
     m_pauseDuration = -1;
+    if ( m_depthController != NULL )
+        m_depthController->reset();
     initVlcOutput();
-    m_mediaPlayer = MemoryPool<LibVLCpp::MediaPlayer>::getInstance()->get();
+    m_mediaPlayer = MediaPlayerPool::getInstance()->get();
     m_mediaPlayer->setMedia( m_vlcMedia );
 
     connect( m_mediaPlayer, SIGNAL( playing() ), this, SLOT( loadingComplete() ), Qt::DirectConnection );
@@ -82,6 +115,7 @@ void    ClipWorkflow::loadingComplete()
     connect( m_mediaPlayer, SIGNAL( playing() ), this, SLOT( mediaPlayerUnpaused() ), Qt::DirectConnection );
     connect( m_mediaPlayer, SIGNAL( paused() ), this, SLOT( mediaPlayerPaused() ), Qt::DirectConnection );
     QMutexLocker    lock( m_initWaitCond->getMutex() );
+    m_startupLatency = mdate() - m_initializeDate;
     setState( Rendering );
     m_initWaitCond->wake();
 }
@@ -91,8 +125,10 @@ void    ClipWorkflow::adjustBegin()
     if ( m_clip->getParent()->fileType() == Media::Video ||
          m_clip->getParent()->fileType() == Media::Audio )
     {
-        m_mediaPlayer->setTime( m_clip->begin() /
-                                m_clip->getParent()->fps() * 1000 );
+        m_seekTarget = m_clip->begin() / m_clip->getParent()->fps() * 1000;
+        m_seekDate = mdate();
+        m_seekInFlight.fetchAndStoreOrdered( 1 );
+        m_mediaPlayer->setTime( m_seekTarget );
     }
 }
 
@@ -129,11 +165,17 @@ void            ClipWorkflow::stop()
     {
         m_mediaPlayer->stop();
         disconnect( m_mediaPlayer, SIGNAL( endReached() ), this, SLOT( clipEndReached() ) );
-        MemoryPool<LibVLCpp::MediaPlayer>::getInstance()->release( m_mediaPlayer );
+        MediaPlayerPool::getInstance()->release( m_mediaPlayer );
         m_mediaPlayer = NULL;
         setState( Stopped );
+        m_waitingFirstFrame = 0;
+        m_seekInFlight = 0;
+        m_seekDelayed = false;
+        if ( m_holdsPreloadSlot.fetchAndStoreOrdered( 0 ) == 1 )
+            PreloadScheduler::getInstance()->releasePreloadSlot();
         delete m_vlcMedia;
         flushComputedBuffers();
+        releaseBuffers();
     }
     else
         qDebug() << "ClipWorkflow has already been stopped";
@@ -142,6 +184,44 @@ void            ClipWorkflow::stop()
 void
 ClipWorkflow::setTime( qint64 time )
 {
+    if ( m_fullSpeedRender == false && isSeeking() == true )
+    {
+        m_seekDelayed = true;
+        return ;
+    }
+    m_seekDelayed = false;
+    seek( time );
+}
+
+bool
+ClipWorkflow::isDelayedSeekReady() const
+{
+    return m_seekDelayed == true && isSeeking() == false;
+}
+
+bool
+ClipWorkflow::hasDelayedSeek() const
+{
+    return m_seekDelayed;
+}
+
+bool
+ClipWorkflow::isSeeking() const
+{
+    if ( m_seekInFlight == 0 )
+        return false;
+    //Don't wait forever if the seek never lands, for instance at the end of the media.
+    qint64      timeout = m_clip->getParent()->seekIndex()->estimatedCost( m_seekTarget );
+    timeout = ( timeout < 0 ? DefaultSeekTimeout : 2 * timeout );
+    return mdate() - m_seekDate < timeout;
+}
+
+void
+ClipWorkflow::seek( qint64 time )
+{
+    m_seekTarget = time;
+    m_seekDate = mdate();
+    m_seekInFlight.fetchAndStoreOrdered( 1 );
     m_mediaPlayer->setTime( time );
     resyncClipWorkflow();
     QWriteLocker    lock( m_stateLock );
@@ -173,11 +253,34 @@ QReadWriteLock* ClipWorkflow::getStateLock()
 
 void        ClipWorkflow::waitForCompleteInit()
 {
-    if ( isRendering() == false )
-    {
-        QMutexLocker    lock( m_initWaitCond->getMutex() );
+    //loadingComplete() changes the state with this mutex locked, so the wake
+    //can't be missed between the check and the wait.
+    QMutexLocker    lock( m_initWaitCond->getMutex() );
+    m_stateLock->lockForRead();
+    bool            initializing = ( m_state == ClipWorkflow::Initializing );
+    m_stateLock->unlock();
+    if ( initializing == true )
         m_initWaitCond->waitLocked();
-    }
+}
+
+qint64
+ClipWorkflow::timeSinceInitialize() const
+{
+    if ( m_initializeDate < 0 )
+        return -1;
+    return mdate() - m_initializeDate;
+}
+
+qint64
+ClipWorkflow::startupLatency() const
+{
+    return m_startupLatency;
+}
+
+qint64
+ClipWorkflow::prerollLatency() const
+{
+    return m_prerollLatency;
 }
 
 LibVLCpp::MediaPlayer*       ClipWorkflow::getMediaPlayer()
@@ -189,14 +292,31 @@ bool        ClipWorkflow::preGetOutput()
 {
     //Computed buffer mutex is already locked by underlying clipworkflow getoutput method
     if ( getNbComputedBuffers() == 0 )
+    {
+        bufferUnderrun();
         return false;
+    }
     return true;
 }
 
+void        ClipWorkflow::bufferUnderrun()
+{
+    if ( m_depthController != NULL )
+        m_depthController->underrun();
+}
+
 void        ClipWorkflow::postGetOutput()
 {
+    quint32     nbComputed = getNbComputedBuffers();
+    quint32     resumeThreshold = getMaxComputedBuffers() / 3;
+
+    if ( m_depthController != NULL )
+    {
+        m_depthController->consumed( nbComputed );
+        resumeThreshold = m_depthController->resumeThreshold();
+    }
     //If we're running out of computed buffers, refill our stack.
-    if ( getNbComputedBuffers() < getMaxComputedBuffers() / 3 )
+    if ( nbComputed < resumeThreshold )
     {
         QWriteLocker        lock( m_stateLock );
         if ( m_state == ClipWorkflow::Paused )
@@ -211,13 +331,45 @@ void        ClipWorkflow::postGetOutput()
     }
 }
 
+void
+ClipWorkflow::firstFrameComputed()
+{
+    if ( m_waitingFirstFrame.fetchAndStoreOrdered( 0 ) == 0 )
+        return ;
+    m_prerollLatency = mdate() - m_initializeDate;
+    PreloadScheduler::getInstance()->startupMeasured( m_clip->getParent(), m_prerollLatency );
+    if ( m_holdsPreloadSlot.fetchAndStoreOrdered( 0 ) == 1 )
+        PreloadScheduler::getInstance()->releasePreloadSlot();
+}
+
+void
+ClipWorkflow::seekCompleted()
+{
+    if ( m_seekInFlight.fetchAndStoreOrdered( 0 ) == 0 )
+        return ;
+    //Frames decoded before the seek was processed may still come through, so
+    //this is only an approximation.
+    //Seeking in the proxy says nothing about seeking in the media.
+    if ( m_measureSeeks == true && m_decodingProxy == false )
+    {
+        m_clip->getParent()->seekIndex()->seekMeasured( m_seekTarget,
+                                                        mdate() - m_seekDate );
+    }
+}
+
 void        ClipWorkflow::commonUnlock()
 {
+    firstFrameComputed();
+    seekCompleted();
     //Don't test using availableBuffer, as it may evolve if a buffer is required while
     //no one is available : we would spawn a new buffer, thus modifying the number of available buffers
+    if ( m_depthController != NULL )
+        m_depthController->produced();
     if ( getNbComputedBuffers() >= getMaxComputedBuffers() )
     {
 //        qWarning() << "Pausing clip workflow. Type:" << debugType;
+        if ( m_depthController != NULL )
+            m_depthController->paused();
         setState( ClipWorkflow::PauseRequired );
         m_mediaPlayer->pause();
     }
@@ -265,11 +417,18 @@ void    ClipWorkflow::mediaPlayerUnpaused()
 //    qDebug() << "pause duration:" << m_pauseDuration;
 }
 
+void
+ClipWorkflow::releaseBuffers()
+{
+}
+
 void    ClipWorkflow::resyncClipWorkflow()
 {
     flushComputedBuffers();
     m_previousPts = -1;
     m_currentPts = -1;
+    if ( m_depthController != NULL )
+        m_depthController->reset();
 }
 
 void
@@ -307,3 +466,27 @@ ClipWorkflow::isResyncRequired()
     }
     return false;
 }
+
+quint32
+ClipWorkflow::bufferDepth() const
+{
+    if ( m_depthController != NULL )
+        return m_depthController->depth();
+    return getMaxComputedBuffers();
+}
+
+int
+ClipWorkflow::nbUnderruns() const
+{
+    if ( m_depthController != NULL )
+        return m_depthController->nbUnderruns();
+    return 0;
+}
+
+int
+ClipWorkflow::nbPauses() const
+{
+    if ( m_depthController != NULL )
+        return m_depthController->nbPauses();
+    return 0;
+}
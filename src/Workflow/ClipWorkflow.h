@@ -30,6 +30,7 @@
 class   QReadWriteLock;
 class   QMutex;
 
+class   BufferDepthController;
 class   Clip;
 class   WaitCondition;
 class   LightVideoFrame;
@@ -87,6 +88,9 @@ class   ClipWorkflow : public QObject
             Get,
         };
 
+        /// \brief  Used to delay seeks when the media seek cost is still unknown (µs)
+        static const qint64     DefaultSeekTimeout = 1000000;
+
         ClipWorkflow( Clip* clip );
         virtual ~ClipWorkflow();
 
@@ -99,7 +103,12 @@ class   ClipWorkflow : public QObject
         bool                    preGetOutput();
         void                    postGetOutput();
         virtual void            initVlcOutput() = 0;
-        void                    initialize();
+        /**
+         *  \param  preloading  true if the clip is started ahead of time. A preload
+         *                      slot must have been acquired from the PreloadScheduler,
+         *                      and will be released once the first frame is computed.
+         */
+        void                    initialize( bool preloading = false );
 
         /**
          *  Return true ONLY if the state is equal to EndReached.
@@ -139,9 +148,24 @@ class   ClipWorkflow : public QObject
         void                    stop();
         /**
          *  \brief  Set the rendering position
+         *
+         *  When not rendering at full speed, a seek requested while the previous
+         *  one hasn't produced a frame yet is dropped, as it would make VLC decode
+         *  from the same keyframe over and over while scrubbing.
+         *  isDelayedSeekReady() tells when the position should be set again.
          *  \param  time    The position in millisecond
          */
         void                    setTime( qint64 time );
+        /**
+         *  \return true if a seek has been dropped by setTime(), and could now
+         *          be performed.
+         */
+        bool                    isDelayedSeekReady() const;
+        /**
+         *  \return true if a seek has been dropped by setTime(), and the
+         *          position is therefore not the one that was asked for.
+         */
+        bool                    hasDelayedSeek() const;
 
         /**
          *  This method must be used to change the state of the ClipWorkflow
@@ -159,7 +183,26 @@ class   ClipWorkflow : public QObject
          */
         QReadWriteLock*         getStateLock();
 
+        /**
+         *  \brief  Block until the clip is rendering, if it is still initializing.
+         */
         void                    waitForCompleteInit();
+        /**
+         *  \return The time elapsed (in microseconds) since the last initialize()
+         *          call, or -1 if the clip hasn't been initialized yet.
+         */
+        qint64                  timeSinceInitialize() const;
+        /**
+         *  \return The time (in microseconds) the last initialization took, from
+         *          initialize() to the media player being ready, or -1 if the
+         *          clip didn't complete any initialization yet.
+         */
+        qint64                  startupLatency() const;
+        /**
+         *  \return The time (in microseconds) it took to compute the first frame
+         *          after the last initialize() call, or -1 if it's not computed yet.
+         */
+        qint64                  prerollLatency() const;
 
         virtual void*           getLockCallback() const = 0;
         virtual void*           getUnlockCallback() const = 0;
@@ -183,13 +226,46 @@ class   ClipWorkflow : public QObject
          */
         bool                    isResyncRequired();
 
+        /**
+         *  \brief  The number of buffers this clip currently keeps ahead of the
+         *          renderer.
+         *  \sa     BufferDepthController
+         */
+        quint32                 bufferDepth() const;
+        /// \brief  The number of times the renderer found this clip's buffer empty
+        int                     nbUnderruns() const;
+        /// \brief  The number of times the producer had to be paused
+        int                     nbPauses() const;
+
     private:
         void                    setState( State state );
         void                    adjustBegin();
+        void                    seek( qint64 time );
+        /**
+         *  \return true if the last seek hasn't produced any frame yet, and
+         *          isn't expected to have done so already.
+         */
+        bool                    isSeeking() const;
 
     protected:
         void                    computePtsDiff( qint64 pts );
         void                    commonUnlock();
+        /**
+         *  \brief  To be called by the underlying implementation each time a
+         *          buffer has been computed. Only the first call after the
+         *          initialization has an effect.
+         */
+        void                    firstFrameComputed();
+        /**
+         *  \brief  To be called by the underlying implementation each time a
+         *          buffer has been computed. Measures the last seek cost.
+         */
+        void                    seekCompleted();
+        /**
+         *  \brief  To be called when the renderer asks for a buffer while none
+         *          has been computed yet.
+         */
+        void                    bufferUnderrun();
         /**
          *  \warning    Must be called from a thread safe context.
          *              This thread safe context has to be set
@@ -203,6 +279,14 @@ class   ClipWorkflow : public QObject
          *          clipworkflow implementation.
          */
         virtual void            flushComputedBuffers() = 0;
+        /**
+         *  \brief  Give back the buffers this clipworkflow keeps for later use.
+         *
+         *  This is called once the clipworkflow has been stopped, so buffers of
+         *  clips that are not rendering don't stay allocated.
+         *  The default implementation does nothing.
+         */
+        virtual void            releaseBuffers();
 
     private:
         WaitCondition*          m_initWaitCond;
@@ -214,6 +298,20 @@ class   ClipWorkflow : public QObject
          *  updated.
          */
         QAtomicInt              m_resyncRequired;
+        qint64                  m_initializeDate;
+        qint64                  m_startupLatency;
+        qint64                  m_prerollLatency;
+        QAtomicInt              m_waitingFirstFrame;
+        QAtomicInt              m_holdsPreloadSlot;
+        /// \brief  The position (in ms) of the last seek
+        qint64                  m_seekTarget;
+        qint64                  m_seekDate;
+        QAtomicInt              m_seekInFlight;
+        bool                    m_seekDelayed;
+        /**
+         *  \brief  true if the media proxy is decoded instead of the media.
+         */
+        bool                    m_decodingProxy;
 
     protected:
         LibVLCpp::MediaPlayer*  m_mediaPlayer;
@@ -231,12 +329,34 @@ class   ClipWorkflow : public QObject
          *  \brief  This is used for basic synchronisation when
          *          the clipworkflow hasn't generate a frame yet,
          *          while the renderer asks for one.
+         *
+         *  Lock-free implementations (see VideoClipWorkflow) only use these
+         *  to serialize callers on the same side of their rings, and never
+         *  take them from VLC's thread.
          */
         QMutex*                 m_computedBuffersMutex;
         QMutex*                 m_availableBuffersMutex;
         qint64                  m_beginPausePts;
         qint64                  m_pauseDuration;
         bool                    m_fullSpeedRender;
+        /**
+         *  \brief  Sizes the computed buffers stack.
+         *
+         *  This has to be created by the underlying clipworkflow implementation.
+         *  If left to NULL, getMaxComputedBuffers() is used as is.
+         */
+        BufferDepthController*  m_depthController;
+        /**
+         *  \brief  If true, the seek costs are reported to the media SeekIndex.
+         *
+         *  Only decoding video is expensive enough to be worth it.
+         */
+        bool                    m_measureSeeks;
+        /**
+         *  \brief  If true, previews decode the media proxy when it's ready.
+         *  \sa     ProxyManager
+         */
+        bool                    m_useProxy;
         int                     debugType;
 
     private slots:
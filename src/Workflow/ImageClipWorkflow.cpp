@@ -49,7 +49,9 @@ ImageClipWorkflow::initVlcOutput()
     m_vlcMedia->setVideoDataCtx( this );
     m_vlcMedia->setVideoLockCallback( reinterpret_cast<void*>( getLockCallback() ) );
     m_vlcMedia->setVideoUnlockCallback( reinterpret_cast<void*>( getUnlockCallback() ) );
-    m_vlcMedia->addOption( ":sout-transcode-vcodec=RV24" );
+    sprintf( buffer, ":sout-transcode-vcodec=%s",
+             VideoFrame::fourcc( MainWorkflow::getInstance()->getVideoFormat() ) );
+    m_vlcMedia->addOption( buffer );
     m_vlcMedia->addOption( ":sout-smem-time-sync" );
 
     sprintf( buffer, ":sout-transcode-width=%i",
@@ -83,6 +85,8 @@ ImageClipWorkflow::getOutput( ClipWorkflow::GetMode )
 {
     QMutexLocker    lock( m_renderLock );
 
+    if ( m_stackedBuffer != NULL )
+        m_stackedBuffer->ref();
     return m_stackedBuffer;
 }
 
@@ -92,18 +96,22 @@ ImageClipWorkflow::lock(ImageClipWorkflow *cw, void **pp_ret, int size )
     cw->m_renderLock->lock();
     if ( cw->m_buffer == NULL )
     {
+        MainWorkflow*   mainWorkflow = MainWorkflow::getInstance();
+
         //        cw->m_buffer = new LightVideoFrame( size );
-        cw->m_buffer = new LightVideoFrame( MainWorkflow::getInstance()->getWidth(),
-                                            MainWorkflow::getInstance()->getHeight() );
-        cw->m_stackedBuffer = new StackedBuffer( cw->m_buffer );
+        cw->m_buffer = new LightVideoFrame( mainWorkflow->getWidth(),
+                                            mainWorkflow->getHeight(),
+                                            mainWorkflow->getVideoFormat() );
+        cw->m_stackedBuffer = new StackedBuffer<LightVideoFrame*>( cw->m_buffer, false );
     }
-    *pp_ret = (*(cw->m_buffer))->frame.octets;
+    *pp_ret = cw->m_buffer->reallocateIfShared().frame.octets;
 }
 
 void
 ImageClipWorkflow::unlock(ImageClipWorkflow *cw, void *buffer, int width, int height, int bpp, int size, qint64 pts)
 {
     cw->m_renderLock->unlock();
+    cw->firstFrameComputed();
     cw->emit computedFinished();
 }
 
@@ -133,14 +141,3 @@ void
 ImageClipWorkflow::flushComputedBuffers()
 {
 }
-
-ImageClipWorkflow::StackedBuffer::StackedBuffer( LightVideoFrame *lvf ) :
-    ::StackedBuffer<LightVideoFrame*>( lvf, false )
-{
-}
-
-void
-ImageClipWorkflow::StackedBuffer::release()
-{
-    return ;
-}
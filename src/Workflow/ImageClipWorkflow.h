@@ -31,12 +31,6 @@ class   ImageClipWorkflow : public ClipWorkflow
     Q_OBJECT
 
     public:
-        class   StackedBuffer : public ::StackedBuffer<LightVideoFrame*>
-        {
-            public:
-                StackedBuffer( LightVideoFrame* lvf );
-                virtual void    release();
-        };
         ImageClipWorkflow( Clip* clip );
 
         void                    *getLockCallback() const;
@@ -55,7 +49,11 @@ class   ImageClipWorkflow : public ClipWorkflow
                                         qint64 pts );
     private:
         LightVideoFrame         *m_buffer;
-        StackedBuffer           *m_stackedBuffer;
+        /**
+         *  \brief  The only handle we ever give. It's never released, as the
+         *          workflow always keeps a reference on it.
+         */
+        StackedBuffer<LightVideoFrame*> *m_stackedBuffer;
 
     private slots:
         void                    stopComputation();
@@ -26,9 +26,12 @@
 #include "vlmc.h"
 #include "Clip.h"
 #include "EffectsEngine.h"
+#include "FrameArena.h"
 #include "Library.h"
 #include "LightVideoFrame.h"
 #include "MainWorkflow.h"
+#include "MediaPlayerPool.h"
+#include "PreloadScheduler.h"
 #include "TrackWorkflow.h"
 #include "TrackHandler.h"
 #include "SettingsManager.h"
@@ -41,13 +44,65 @@ MainWorkflow::MainWorkflow( int trackCount ) :
         m_lengthFrame( 0 ),
         m_renderStarted( false ),
         m_width( 0 ),
-        m_height( 0 )
+        m_height( 0 ),
+        m_videoFormat( VideoFrame::RGB24 ),
+        m_timelineRevision( 0 )
 {
     m_currentFrameLock = new QReadWriteLock;
     m_renderStartedMutex = new QMutex;
 
+    //Every frame allocated from now on will come from the arena.
+    VideoFrame::setDefaultAllocator( FrameArena::getInstance() );
+    VLMC_CREATE_PREFERENCE_INT( "general/FrameMemoryBudget", 512, "Frame memory budget",
+                                "Maximum amount of memory (in MB) kept to store video frames" );
+    SettingsManager::getInstance()->watchValue( "general/FrameMemoryBudget",
+                                                FrameArena::getInstance(),
+                                                SLOT( budgetChanged( const QVariant& ) ),
+                                                SettingsManager::Vlmc );
+    FrameArena::getInstance()->setBudget(
+            (quint64)VLMC_GET_UINT( "general/FrameMemoryBudget" ) * 1024 * 1024 );
+    VLMC_CREATE_PREFERENCE_INT( "general/TrackFetchWorkers", 0, "Track fetching threads",
+                                "Number of threads used to fetch the tracks in parallel. "
+                                "With 0 or 1, tracks are fetched one after the other" );
+    VLMC_CREATE_PREFERENCE_INT( "general/EffectWorkers", 0, "Effect rendering threads",
+                                "Number of threads used to render the independent "
+                                "branches of the effects graph. With 0 or 1, effects "
+                                "are rendered one after the other" );
+    VLMC_CREATE_PREFERENCE_INT( "general/ClipStartupFallback", 0, "Clip startup fallback",
+                                "What is rendered while a clip is starting: 0 for the "
+                                "last frame, 1 for black, 2 for the media thumbnail" );
+    VLMC_CREATE_PREFERENCE_INT( "general/ClipStartupTimeout", 500, "Clip startup timeout",
+                                "Maximum time (in ms) to render the fallback before "
+                                "waiting for a clip to start" );
+    VLMC_CREATE_PREFERENCE_INT( "general/MaxPreloadingClips", 4, "Preloaded clips",
+                                "Maximum number of clips that can be preloaded at the "
+                                "same time" );
+    SettingsManager::getInstance()->watchValue( "general/MaxPreloadingClips",
+                PreloadScheduler::getInstance(),
+                SLOT( maxPreloadingChanged( const QVariant& ) ), SettingsManager::Vlmc );
+    PreloadScheduler::getInstance()->setMaxPreloading(
+            VLMC_GET_INT( "general/MaxPreloadingClips" ) );
+    VLMC_CREATE_PREFERENCE_INT( "general/MaxMediaPlayers", 8, "Media players",
+                                "Maximum number of media players kept alive to "
+                                "render the clips" );
+    SettingsManager::getInstance()->watchValue( "general/MaxMediaPlayers",
+                MediaPlayerPool::getInstance(),
+                SLOT( maxPlayersChanged( const QVariant& ) ), SettingsManager::Vlmc );
+    MediaPlayerPool::getInstance()->setMaxPlayers(
+            VLMC_GET_INT( "general/MaxMediaPlayers" ) );
+    VLMC_CREATE_PREFERENCE_INT( "general/ProxyHeight", 360, "Proxy height",
+                                "Height of the low resolution copies of the videos, "
+                                "used for previews. 0 disables them" );
+    VLMC_CREATE_PREFERENCE_INT( "general/FrameCacheSize", 256, "Frame cache size",
+                                "Maximum amount of memory (in MB) used to keep the "
+                                "rendered frames, for scrubbing and replay" );
+
     m_effectEngine = new EffectsEngine;
     m_effectEngine->disable();
+    SettingsManager::getInstance()->watchValue( "general/EffectWorkers", this,
+                SLOT( effectWorkerCountChanged( const QVariant& ) ),
+                SettingsManager::Vlmc );
+    m_effectEngine->setWorkerCount( VLMC_GET_INT( "general/EffectWorkers" ) );
 
     m_tracks = new TrackHandler*[MainWorkflow::NbTrackType];
     m_currentFrame = new qint64[MainWorkflow::NbTrackType];
@@ -58,9 +113,18 @@ MainWorkflow::MainWorkflow( int trackCount ) :
         m_tracks[i] = new TrackHandler( trackCount, trackType, m_effectEngine );
         connect( m_tracks[i], SIGNAL( tracksEndReached() ),
                  this, SLOT( tracksEndReached() ) );
+        SettingsManager::getInstance()->watchValue( "general/TrackFetchWorkers",
+                m_tracks[i], SLOT( fetchWorkerCountChanged( const QVariant& ) ),
+                SettingsManager::Vlmc );
+        m_tracks[i]->setFetchWorkerCount( VLMC_GET_INT( "general/TrackFetchWorkers" ) );
         m_currentFrame[i] = 0;
+        m_frameAllocations[i] = 0;
     }
+    m_frameCopies = 0;
     m_outputBuffers = new OutputBuffers;
+    m_outputBuffers->videoFrame = 0;
+    m_outputBuffers->revision = 0;
+    m_outputBuffers->videoExact = false;
 }
 
 MainWorkflow::~MainWorkflow()
@@ -89,6 +153,7 @@ MainWorkflow::addClip( Clip *clip, unsigned int trackId,
 {
     m_tracks[trackType]->addClip( clip, trackId, start );
     computeLength();
+    timelineEdited( start, start + clip->length() );
     //Inform the GUI
     emit clipAdded( clip, trackId, start, trackType );
 }
@@ -112,16 +177,16 @@ MainWorkflow::computeLength()
 }
 
 void
-MainWorkflow::startRender( quint32 width, quint32 height )
+MainWorkflow::startRender( quint32 width, quint32 height, VideoFrame::Format format )
 {
     m_renderStarted = true;
     m_width = width;
     m_height = height;
+    m_videoFormat = format;
     if ( blackOutput != NULL )
         delete blackOutput;
-    blackOutput = new LightVideoFrame( m_width, m_height );
-    // FIX ME vvvvvv , It doesn't update meta info (nbpixels, nboctets, etc.
-    memset( (*blackOutput)->frame.octets, 0, (*blackOutput)->nboctets );
+    blackOutput = new LightVideoFrame( m_width, m_height, m_videoFormat );
+    blackOutput->fillBlack();
     for ( unsigned int i = 0; i < MainWorkflow::NbTrackType; ++i )
         m_tracks[i]->startRender();
     computeLength();
@@ -135,17 +200,36 @@ MainWorkflow::getOutput( TrackType trackType, bool paused )
     if ( m_renderStarted == true )
     {
         QReadLocker         lock2( m_currentFrameLock );
+        int                 nbAllocations = nbStackedBufferAllocations( trackType );
+        qint64              nbCopies = nbFrameCopies();
+        //Read the revision first: an edit made while rendering will then
+        //discard this frame.
+        int                 revision = m_timelineRevision;
 
         m_tracks[trackType]->getOutput( m_currentFrame[VideoTrack],
                                         m_currentFrame[trackType], paused );
+        m_frameAllocations[trackType] = nbStackedBufferAllocations( trackType ) -
+                                        nbAllocations;
         if ( trackType == MainWorkflow::VideoTrack )
         {
             m_effectEngine->render();
+            m_frameCopies = nbFrameCopies() - nbCopies;
+            if ( m_frameCopies > MaxFrameCopies &&
+                 FrameArena::getInstance()->copyLogging() == false )
+            {
+                qWarning() << "Rendering frame" << m_currentFrame[VideoTrack] << "took"
+                        << m_frameCopies << "frame copies. Logging the next copies.";
+                FrameArena::getInstance()->setCopyLogging( true );
+                VideoFrame::setCopyLogging( true );
+            }
             const LightVideoFrame &tmp = m_effectEngine->getVideoOutput( 1 );
             if ( tmp->nboctets == 0 )
                 m_outputBuffers->video = blackOutput;
             else
                 m_outputBuffers->video = &tmp;
+            m_outputBuffers->videoFrame = m_currentFrame[VideoTrack];
+            m_outputBuffers->revision = revision;
+            m_outputBuffers->videoExact = m_tracks[VideoTrack]->isOutputExact();
         }
         else
         {
@@ -156,6 +240,45 @@ MainWorkflow::getOutput( TrackType trackType, bool paused )
     return m_outputBuffers;
 }
 
+void
+MainWorkflow::schedule( TrackType trackType )
+{
+    QMutexLocker        lock( m_renderStartedMutex );
+
+    if ( m_renderStarted == true )
+    {
+        QReadLocker         lock2( m_currentFrameLock );
+
+        m_tracks[trackType]->schedule( m_currentFrame[VideoTrack] );
+    }
+}
+
+int
+MainWorkflow::nbStackedBufferAllocations( MainWorkflow::TrackType trackType )
+{
+    if ( trackType == MainWorkflow::VideoTrack )
+        return StackedBufferPool<LightVideoFrame*>::nbAllocations();
+    return StackedBufferPool<AudioClipWorkflow::AudioSample*>::nbAllocations();
+}
+
+int
+MainWorkflow::frameAllocations( MainWorkflow::TrackType trackType ) const
+{
+    return m_frameAllocations[trackType];
+}
+
+qint64
+MainWorkflow::nbFrameCopies()
+{
+    return FrameArena::getInstance()->nbCopies() + VideoFrame::nbDeepCopies();
+}
+
+int
+MainWorkflow::frameCopies() const
+{
+    return m_frameCopies;
+}
+
 void
 MainWorkflow::nextFrame( MainWorkflow::TrackType trackType )
 {
@@ -201,6 +324,8 @@ MainWorkflow::stop()
         m_tracks[i]->stop();
         m_currentFrame[i] = 0;
     }
+    //Stopped clips gave their frames back. Don't keep them around for too long.
+    FrameArena::getInstance()->trim();
     emit frameChanged( 0, Renderer );
 }
 
@@ -210,8 +335,16 @@ MainWorkflow::moveClip( const QUuid &clipUuid, unsigned int oldTrack,
                         MainWorkflow::TrackType trackType,
                         bool undoRedoCommand /*= false*/ )
 {
+    Clip*   clip = m_tracks[trackType]->getClip( clipUuid, oldTrack );
+    qint64  oldPos = m_tracks[trackType]->getClipPosition( clipUuid, oldTrack );
+
     m_tracks[trackType]->moveClip( clipUuid, oldTrack, newTrack, startingFrame );
     computeLength();
+    if ( clip != NULL )
+    {
+        timelineEdited( oldPos, oldPos + clip->length() );
+        timelineEdited( startingFrame, startingFrame + clip->length() );
+    }
 
     if ( undoRedoCommand == true )
     {
@@ -223,10 +356,12 @@ Clip*
 MainWorkflow::removeClip( const QUuid &uuid, unsigned int trackId,
                           MainWorkflow::TrackType trackType )
 {
+    qint64  pos = m_tracks[trackType]->getClipPosition( uuid, trackId );
     Clip *clip = m_tracks[trackType]->removeClip( uuid, trackId );
     if ( clip != NULL )
     {
         computeLength();
+        timelineEdited( pos, pos + clip->length() );
         emit clipRemoved( clip, trackId, trackType );
     }
     return clip;
@@ -236,12 +371,33 @@ void
 MainWorkflow::muteTrack( unsigned int trackId, MainWorkflow::TrackType trackType )
 {
     m_tracks[trackType]->muteTrack( trackId );
+    timelineEdited( 0, -1 );
 }
 
 void
 MainWorkflow::unmuteTrack( unsigned int trackId, MainWorkflow::TrackType trackType )
 {
     m_tracks[trackType]->unmuteTrack( trackId );
+    timelineEdited( 0, -1 );
+}
+
+void
+MainWorkflow::setAudioTrackGain( unsigned int trackId, float gain )
+{
+    m_tracks[MainWorkflow::AudioTrack]->setTrackGain( trackId, gain );
+}
+
+void
+MainWorkflow::setVideoTrackLayer( unsigned int trackId, quint8 opacity,
+                                  qint32 x, qint32 y )
+{
+    VideoLayer      layer;
+
+    layer.opacity = opacity;
+    layer.x = x;
+    layer.y = y;
+    m_tracks[MainWorkflow::VideoTrack]->setTrackLayer( trackId, layer );
+    timelineEdited( 0, -1 );
 }
 
 void
@@ -249,6 +405,7 @@ MainWorkflow::muteClip( const QUuid& uuid, unsigned int trackId,
                         MainWorkflow::TrackType trackType )
 {
     m_tracks[trackType]->muteClip( uuid, trackId );
+    clipEdited( uuid, trackId, trackType );
 }
 
 void
@@ -256,6 +413,7 @@ MainWorkflow::unmuteClip( const QUuid& uuid, unsigned int trackId,
                           MainWorkflow::TrackType trackType )
 {
     m_tracks[trackType]->unmuteClip( uuid, trackId );
+    clipEdited( uuid, trackId, trackType );
 }
 
 void toggleBreakPoint()
@@ -401,6 +559,7 @@ MainWorkflow::clear()
 {
     for ( unsigned int i = 0; i < MainWorkflow::NbTrackType; ++i )
         m_tracks[i]->clear();
+    timelineEdited( 0, -1 );
     emit cleared();
 }
 
@@ -415,6 +574,12 @@ MainWorkflow::tracksEndReached()
     emit mainWorkflowEndReached();
 }
 
+void
+MainWorkflow::effectWorkerCountChanged( const QVariant& nbWorkers )
+{
+    m_effectEngine->setWorkerCount( nbWorkers.toInt() );
+}
+
 int
 MainWorkflow::getTrackCount( MainWorkflow::TrackType trackType ) const
 {
@@ -443,6 +608,12 @@ MainWorkflow::getHeight() const
     return m_height;
 }
 
+VideoFrame::Format
+MainWorkflow::getVideoFormat() const
+{
+    return m_videoFormat;
+}
+
 void
 MainWorkflow::renderOneFrame()
 {
@@ -469,6 +640,7 @@ MainWorkflow::split( Clip* toSplit, Clip* newClip, quint32 trackId, qint64 newCl
 
     toSplit->setEnd( newClipBegin, true );
     addClip( newClip, trackId, newClipPos, trackType );
+    clipEdited( toSplit->uuid(), trackId, trackType );
     return newClip;
 }
 
@@ -479,11 +651,13 @@ MainWorkflow::resizeClip( Clip* clip, qint64 newBegin, qint64 newEnd, qint64 new
 {
     QMutexLocker    lock( m_renderStartedMutex );
 
+    clipEdited( clip->uuid(), trackId, trackType );
     if ( newBegin != clip->begin() )
     {
         moveClip( clip->uuid(), trackId, trackId, newPos, trackType, undoRedoAction );
     }
     clip->setBoundaries( newBegin, newEnd );
+    clipEdited( clip->uuid(), trackId, trackType );
 }
 
 void
@@ -494,4 +668,31 @@ MainWorkflow::unsplit( Clip* origin, Clip* splitted, quint32 trackId,
 
     removeClip( splitted->uuid(), trackId, trackType );
     origin->setEnd( splitted->end(), true );
+    clipEdited( origin->uuid(), trackId, trackType );
+}
+
+int
+MainWorkflow::timelineRevision() const
+{
+    return m_timelineRevision;
+}
+
+void
+MainWorkflow::timelineEdited( qint64 begin, qint64 end )
+{
+    int     revision = m_timelineRevision.fetchAndAddOrdered( 1 ) + 1;
+
+    emit timelineChanged( begin, end, revision );
+}
+
+void
+MainWorkflow::clipEdited( const QUuid& uuid, unsigned int trackId,
+                          MainWorkflow::TrackType trackType )
+{
+    Clip*   clip = m_tracks[trackType]->getClip( uuid, trackId );
+
+    if ( clip == NULL )
+        return ;
+    qint64  pos = m_tracks[trackType]->getClipPosition( uuid, trackId );
+    timelineEdited( pos, pos + clip->length() );
 }
@@ -26,15 +26,16 @@
 
 #include "Singleton.hpp"
 #include "AudioClipWorkflow.h"
+#include "LightVideoFrame.h"
 
 class   QDomDocument;
 class   QDomElement;
 class   QMutex;
 class   QReadWriteLock;
+class   QVariant;
 
 class   Clip;
 class   EffectsEngine;
-class   LightVideoFrame;
 class   TrackHandler;
 class   TrackWorkflow;
 
@@ -49,6 +50,15 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
     Q_OBJECT
 
     public:
+        /**
+         *  \brief  The number of deep copies a video frame should need at most.
+         *
+         *  An effect writing to a frame that is still referenced by a track has
+         *  to copy it. More than that means a frame is copied more than once on
+         *  its way to the output.
+         */
+        static const int        MaxFrameCopies = 1;
+
         /**
          *  \struct     Represents an output, with both audio and video buffers.
          *              Note that an OutputBuffers will not necessarly have its both
@@ -58,6 +68,15 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
         {
             const LightVideoFrame*              video;
             AudioClipWorkflow::AudioSample*     audio;
+            /// The timeline frame the video buffer has been rendered for
+            qint64                              videoFrame;
+            /// The timeline revision the video buffer has been rendered with
+            int                                 revision;
+            /**
+             *  false if the video buffer isn't exactly videoFrame, for instance
+             *  because a clip was still starting.
+             */
+            bool                                videoExact;
         };
         /**
          *  \enum   Represents the potential Track types.
@@ -107,9 +126,13 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          *
          *  \param      width   The width to use with this render session.
          *  \param      height  The height to use with this render session.
+         *  \param      format  The format of the frames, as negotiated with the
+         *                      effects engine.
          *  This will basically activate all the tracks, so they can render.
+         *  \sa         EffectsEngine::videoFormat()
          */
-        void                    startRender( quint32 width, quint32 height );
+        void                    startRender( quint32 width, quint32 height,
+                                             VideoFrame::Format format );
         /**
          *  \brief      Gets a frame from the workflow
          *
@@ -122,6 +145,32 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          *  \param  paused      The paused state of the renderer
          */
         OutputBuffers*          getOutput( TrackType trackType, bool paused );
+        /**
+         *  \brief  Move the clips along with the current frame, as getOutput() would,
+         *          but without rendering anything.
+         *
+         *  This must be called for each frame that isn't rendered with getOutput(),
+         *  so that the upcoming clips are preloaded, and the end is detected.
+         *  \param  trackType   The type of track to schedule.
+         */
+        void                    schedule( TrackType trackType );
+        /**
+         *  \brief  Returns the number of buffer handles allocated while computing
+         *          the last output of the given type.
+         *
+         *  Handles are pooled, so once every clip has rendered a few frames, this
+         *  should remain 0.
+         */
+        int                     frameAllocations( TrackType trackType ) const;
+        /**
+         *  \brief  Returns the number of frame deep copies made while computing the
+         *          last video output, from the tracks to the effects output.
+         *
+         *  The first time this goes over MaxFrameCopies, every following copy is
+         *  logged, along with its call site.
+         *  \sa     LightVideoFrame::writable()
+         */
+        int                     frameCopies() const;
         /**
          *  \brief  Returns the effect engine instance used by the workflow
          *
@@ -255,6 +304,24 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          */
         void                    unmuteTrack( unsigned int trackId,
                                              MainWorkflow::TrackType trackType );
+        /**
+         *  \brief      Set the gain of an audio track.
+         *
+         *  \param  trackId     The id of the audio track.
+         *  \param  gain        The factor applied to the track samples. 1 leaves
+         *                      them untouched.
+         */
+        void                    setAudioTrackGain( unsigned int trackId, float gain );
+        /**
+         *  \brief      Set how a video track is drawn over the tracks below it.
+         *
+         *  \param  trackId     The id of the video track.
+         *  \param  opacity     From 0 (invisible) to 255 (opaque).
+         *  \param  x           The horizontal position of the track, in pixels.
+         *  \param  y           The vertical position of the track, in pixels.
+         */
+        void                    setVideoTrackLayer( unsigned int trackId, quint8 opacity,
+                                                    qint32 x, qint32 y );
 
         /**
          *  \brief      Mute a clip.
@@ -315,6 +382,12 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          *  \sa         getWidth()
          */
         quint32                getHeight() const;
+        /**
+         *  \brief      Get the format of the rendered frames.
+         *
+         *  As the width and height, this only changes when a render is started.
+         */
+        VideoFrame::Format     getVideoFormat() const;
 
         /**
          *  \brief          Will render one frame only
@@ -345,6 +418,15 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
         void                    unsplit( Clip* origin, Clip* splitted, quint32 trackId,
                                          MainWorkflow::TrackType trackType );
 
+        /**
+         *  \brief  Return the timeline revision.
+         *
+         *  The revision is increased each time an edit changes what the timeline
+         *  renders.
+         *  \sa     timelineChanged( qint64, qint64, int )
+         */
+        int                     timelineRevision() const;
+
         /// Pre-filled buffer used when there's nothing to render
         static LightVideoFrame*         blackOutput;
 
@@ -359,6 +441,26 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          *  This method will update the attribute m_lengthFrame
          */
         void                    computeLength();
+        static int              nbStackedBufferAllocations( TrackType trackType );
+        /**
+         *  \brief  The number of frame deep copies since the application started,
+         *          for the arena frames and for the others.
+         */
+        static qint64           nbFrameCopies();
+        /**
+         *  \brief  Increase the timeline revision and emit timelineChanged()
+         *
+         *  \param  begin   The first frame that changed.
+         *  \param  end     The frame after the last one that changed, or -1 if
+         *                  every frame after begin changed.
+         */
+        void                    timelineEdited( qint64 begin, qint64 end );
+        /**
+         *  \brief  Same as timelineEdited( qint64, qint64 ), for the frames
+         *          covered by a clip.
+         */
+        void                    clipEdited( const QUuid& uuid, unsigned int trackId,
+                                            MainWorkflow::TrackType trackType );
 
     private:
         /// Lock for the m_currentFrame atribute.
@@ -391,6 +493,13 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
         quint32                         m_width;
         /// Height used for the render
         quint32                         m_height;
+        /// Format of the rendered frames
+        VideoFrame::Format              m_videoFormat;
+        /// Number of buffer handles allocated during the last getOutput() per track type
+        int                             m_frameAllocations[NbTrackType];
+        /// Number of frame deep copies during the last video getOutput()
+        int                             m_frameCopies;
+        QAtomicInt                      m_timelineRevision;
 
         friend class                    Singleton<MainWorkflow>;
 
@@ -403,6 +512,7 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          *  \sa     mainWorkflowEndReached()
          */
         void                            tracksEndReached();
+        void                            effectWorkerCountChanged( const QVariant& nbWorkers );
 
     public slots:
         /**
@@ -494,6 +604,15 @@ class   MainWorkflow : public QObject, public Singleton<MainWorkflow>
          *  \param  newLength   The new length, in frames
          */
         void                    lengthChanged( qint64 );
+        /**
+         *  \brief  Emitted when an edit changes what some frames render.
+         *
+         *  \param  begin       The first frame that changed
+         *  \param  end         The frame after the last one that changed, or -1 if
+         *                      every frame after begin changed.
+         *  \param  revision    The new timeline revision
+         */
+        void                    timelineChanged( qint64 begin, qint64 end, int revision );
 };
 
 #endif // MAINWORKFLOW_H
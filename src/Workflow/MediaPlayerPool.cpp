@@ -0,0 +1,166 @@
+/*****************************************************************************
+ * MediaPlayerPool.cpp: Keeps media players alive between clips
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "MediaPlayerPool.h"
+#include "VLCMediaPlayer.h"
+#include "mdate.h"
+
+#include <QMutex>
+#include <QVariant>
+
+MediaPlayerPool::MediaPlayerPool() :
+        m_maxPlayers( 8 )
+{
+    m_mutex = new QMutex;
+    m_stats.nbIdle = 0;
+    m_stats.nbInUse = 0;
+    resetStats();
+}
+
+MediaPlayerPool::~MediaPlayerPool()
+{
+    foreach ( const IdlePlayer& idle, m_idlePlayers )
+        delete idle.mediaPlayer;
+    delete m_mutex;
+}
+
+LibVLCpp::MediaPlayer*
+MediaPlayerPool::get()
+{
+    LibVLCpp::MediaPlayer*          mediaPlayer = NULL;
+    QList<LibVLCpp::MediaPlayer*>   toDestroy;
+    {
+        QMutexLocker    lock( m_mutex );
+
+        if ( m_idlePlayers.isEmpty() == false )
+        {
+            //The last released player is the most likely to still be in cache.
+            mediaPlayer = m_idlePlayers.takeLast().mediaPlayer;
+            ++m_stats.nbHits;
+            --m_stats.nbIdle;
+            ++m_stats.nbInUse;
+            trim( toDestroy );
+        }
+    }
+    foreach ( LibVLCpp::MediaPlayer* mp, toDestroy )
+        delete mp;
+    if ( mediaPlayer != NULL )
+        return mediaPlayer;
+    //Don't block the other clips while libvlc creates the player.
+    qint64                  start = mdate();
+    mediaPlayer = new LibVLCpp::MediaPlayer;
+    qint64                  latency = mdate() - start;
+
+    QMutexLocker    lock( m_mutex );
+    ++m_stats.nbMisses;
+    ++m_stats.nbInUse;
+    m_stats.lastCreationLatency = latency;
+    m_stats.maxCreationLatency = qMax( m_stats.maxCreationLatency, latency );
+    m_stats.totalCreationLatency += latency;
+    return mediaPlayer;
+}
+
+void
+MediaPlayerPool::release( LibVLCpp::MediaPlayer* mediaPlayer )
+{
+    QList<LibVLCpp::MediaPlayer*>   toDestroy;
+
+    //The next owner will connect its own slots.
+    mediaPlayer->disconnect();
+    {
+        QMutexLocker    lock( m_mutex );
+        IdlePlayer      idle;
+
+        idle.mediaPlayer = mediaPlayer;
+        idle.releaseDate = mdate();
+        m_idlePlayers.append( idle );
+        --m_stats.nbInUse;
+        ++m_stats.nbIdle;
+        trim( toDestroy );
+    }
+    foreach ( LibVLCpp::MediaPlayer* mp, toDestroy )
+        delete mp;
+}
+
+void
+MediaPlayerPool::trim( QList<LibVLCpp::MediaPlayer*>& toDestroy )
+{
+    qint64      now = mdate();
+
+    //The oldest players are at the beginning of the list.
+    while ( m_idlePlayers.isEmpty() == false &&
+            ( m_stats.nbIdle + m_stats.nbInUse > m_maxPlayers ||
+              now - m_idlePlayers.first().releaseDate > IdleTimeout ) )
+    {
+        toDestroy.append( m_idlePlayers.takeFirst().mediaPlayer );
+        --m_stats.nbIdle;
+        ++m_stats.nbDestroyed;
+    }
+}
+
+void
+MediaPlayerPool::setMaxPlayers( int maxPlayers )
+{
+    QList<LibVLCpp::MediaPlayer*>   toDestroy;
+    {
+        QMutexLocker    lock( m_mutex );
+
+        m_maxPlayers = qMax( maxPlayers, 0 );
+        trim( toDestroy );
+    }
+    foreach ( LibVLCpp::MediaPlayer* mp, toDestroy )
+        delete mp;
+}
+
+int
+MediaPlayerPool::maxPlayers() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_maxPlayers;
+}
+
+MediaPlayerPool::Stats
+MediaPlayerPool::stats() const
+{
+    QMutexLocker    lock( m_mutex );
+    return m_stats;
+}
+
+void
+MediaPlayerPool::resetStats()
+{
+    QMutexLocker    lock( m_mutex );
+
+    //The number of players is not a statistic, and must be kept.
+    m_stats.nbHits = 0;
+    m_stats.nbMisses = 0;
+    m_stats.nbDestroyed = 0;
+    m_stats.lastCreationLatency = 0;
+    m_stats.maxCreationLatency = 0;
+    m_stats.totalCreationLatency = 0;
+}
+
+void
+MediaPlayerPool::maxPlayersChanged( const QVariant& maxPlayers )
+{
+    setMaxPlayers( maxPlayers.toInt() );
+}
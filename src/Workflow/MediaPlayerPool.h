@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * MediaPlayerPool.h: Keeps media players alive between clips
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef MEDIAPLAYERPOOL_H
+#define MEDIAPLAYERPOOL_H
+
+#include "Singleton.hpp"
+
+#include <QList>
+#include <QObject>
+
+class   QMutex;
+class   QVariant;
+
+namespace LibVLCpp
+{
+    class   MediaPlayer;
+}
+
+/**
+ *  \brief  Lends media players to the clip workflows.
+ *
+ *  Creating a libvlc media player is expensive, and every cut used to create
+ *  one and destroy another. Released players are stopped and kept alive, their
+ *  libvlc events stay attached, only their Qt connections are dropped so the
+ *  next clip can connect its own slots.
+ *  The pool grows as needed, but never keeps more than maxPlayers() players
+ *  alive. Players that stay unused for IdleTimeout are destroyed.
+ */
+class   MediaPlayerPool : public QObject, public Singleton<MediaPlayerPool>
+{
+    Q_OBJECT
+
+    public:
+        /// \brief  Idle players are destroyed after this delay (in µs)
+        static const qint64     IdleTimeout = 30000000;
+
+        struct  Stats
+        {
+            /// \brief  The number of players given from the idle list
+            int         nbHits;
+            /// \brief  The number of players that had to be created
+            int         nbMisses;
+            int         nbDestroyed;
+            int         nbIdle;
+            int         nbInUse;
+            qint64      lastCreationLatency;
+            qint64      maxCreationLatency;
+            qint64      totalCreationLatency;
+        };
+
+        /**
+         *  \brief  Return a stopped media player. A new one is created if no
+         *          player is available.
+         */
+        LibVLCpp::MediaPlayer*  get();
+        /**
+         *  \brief  Give a player back to the pool.
+         *
+         *  The player must have been stopped. All of its signals are disconnected.
+         */
+        void                    release( LibVLCpp::MediaPlayer* mediaPlayer );
+
+        void                    setMaxPlayers( int maxPlayers );
+        int                     maxPlayers() const;
+        Stats                   stats() const;
+        void                    resetStats();
+
+    private:
+        MediaPlayerPool();
+        virtual ~MediaPlayerPool();
+
+        struct  IdlePlayer
+        {
+            LibVLCpp::MediaPlayer*  mediaPlayer;
+            qint64                  releaseDate;
+        };
+        /**
+         *  \brief  Pick the players that have to be destroyed.
+         *  \warning    The pool mutex must be locked.
+         */
+        void                    trim( QList<LibVLCpp::MediaPlayer*>& toDestroy );
+
+    private:
+        mutable QMutex*         m_mutex;
+        /// \brief  The most recently released players are at the end.
+        QList<IdlePlayer>       m_idlePlayers;
+        int                     m_maxPlayers;
+        Stats                   m_stats;
+
+    private slots:
+        void                    maxPlayersChanged( const QVariant& maxPlayers );
+
+        friend class    Singleton<MediaPlayerPool>;
+};
+
+#endif // MEDIAPLAYERPOOL_H
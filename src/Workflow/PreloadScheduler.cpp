@@ -0,0 +1,178 @@
+/*****************************************************************************
+ * PreloadScheduler.cpp: Decides when upcoming clips have to be started
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "PreloadScheduler.h"
+#include "Media.h"
+
+#include <QMutex>
+#include <QVariant>
+
+PreloadScheduler::PreloadScheduler() :
+        m_hasGlobalEstimate( false ),
+        m_maxLeadTime( DefaultLatency ),
+        m_nbPreloading( 0 ),
+        m_maxPreloading( 4 ),
+        m_nbPostponed( 0 )
+{
+    m_mutex = new QMutex;
+    m_globalEstimate.mean = DefaultLatency;
+    m_globalEstimate.deviation = 0;
+}
+
+PreloadScheduler::~PreloadScheduler()
+{
+    delete m_mutex;
+}
+
+void
+PreloadScheduler::update( Estimate& estimate, qint64 latency )
+{
+    //Same smoothing as TCP's RTT estimator: 1/8 for the mean, 1/4 for the deviation.
+    qint64      error = latency - estimate.mean;
+
+    estimate.mean += error / 8;
+    estimate.deviation += ( qAbs( error ) - estimate.deviation ) / 4;
+}
+
+qint64
+PreloadScheduler::leadTime( const Estimate& estimate )
+{
+    qint64      lead = estimate.mean + 4 * estimate.deviation;
+
+    //Don't use qMax here, it would take MinLeadTime by reference.
+    return ( lead < MinLeadTime ? MinLeadTime : lead );
+}
+
+void
+PreloadScheduler::startupMeasured( const Media* media, qint64 latency )
+{
+    QMutexLocker    lock( m_mutex );
+
+    QHash<QUuid, Estimate>::iterator    it = m_estimates.find( media->uuid() );
+    if ( it == m_estimates.end() )
+    {
+        Estimate    estimate;
+        estimate.mean = latency;
+        estimate.deviation = latency / 2;
+        m_estimates.insert( media->uuid(), estimate );
+    }
+    else
+        update( it.value(), latency );
+    if ( m_hasGlobalEstimate == false )
+    {
+        m_globalEstimate.mean = latency;
+        m_globalEstimate.deviation = latency / 2;
+        m_hasGlobalEstimate = true;
+    }
+    else
+        update( m_globalEstimate, latency );
+    updateMaxLeadTime();
+}
+
+void
+PreloadScheduler::updateMaxLeadTime()
+{
+    m_maxLeadTime = leadTime( m_globalEstimate );
+    foreach ( const Estimate& estimate, m_estimates )
+        m_maxLeadTime = qMax( m_maxLeadTime, leadTime( estimate ) );
+}
+
+qint64
+PreloadScheduler::predictedLatency( const Media* media ) const
+{
+    QMutexLocker    lock( m_mutex );
+
+    QHash<QUuid, Estimate>::const_iterator  it = m_estimates.find( media->uuid() );
+    if ( it != m_estimates.end() )
+        return leadTime( it.value() );
+    return leadTime( m_globalEstimate );
+}
+
+bool
+PreloadScheduler::mustPreload( const Media* media, qint64 timeToStart ) const
+{
+    return timeToStart <= predictedLatency( media );
+}
+
+bool
+PreloadScheduler::mustKeepLoaded( const Media* media, qint64 timeToStart ) const
+{
+    return timeToStart <= 2 * predictedLatency( media );
+}
+
+bool
+PreloadScheduler::isBeyondHorizon( qint64 timeToStart ) const
+{
+    QMutexLocker    lock( m_mutex );
+
+    return timeToStart > 2 * m_maxLeadTime;
+}
+
+bool
+PreloadScheduler::acquirePreloadSlot()
+{
+    int     maxPreloading = m_maxPreloading;
+
+    if ( m_nbPreloading.fetchAndAddOrdered( 1 ) >= maxPreloading )
+    {
+        m_nbPreloading.deref();
+        m_nbPostponed.ref();
+        return false;
+    }
+    return true;
+}
+
+void
+PreloadScheduler::releasePreloadSlot()
+{
+    m_nbPreloading.deref();
+}
+
+int
+PreloadScheduler::nbPreloading() const
+{
+    return m_nbPreloading;
+}
+
+void
+PreloadScheduler::setMaxPreloading( int maxPreloading )
+{
+    m_maxPreloading = qMax( maxPreloading, 1 );
+}
+
+int
+PreloadScheduler::maxPreloading() const
+{
+    return m_maxPreloading;
+}
+
+int
+PreloadScheduler::nbPostponed() const
+{
+    return m_nbPostponed;
+}
+
+void
+PreloadScheduler::maxPreloadingChanged( const QVariant& maxPreloading )
+{
+    setMaxPreloading( maxPreloading.toInt() );
+}
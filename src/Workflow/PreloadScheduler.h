@@ -0,0 +1,140 @@
+/*****************************************************************************
+ * PreloadScheduler.h: Decides when upcoming clips have to be started
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef PRELOADSCHEDULER_H
+#define PRELOADSCHEDULER_H
+
+#include "Singleton.hpp"
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QObject>
+#include <QUuid>
+
+class   Media;
+
+class   QMutex;
+class   QVariant;
+
+/**
+ *  \brief  Learns how long each media takes to start, and uses it to preload
+ *          clips just early enough to have their first frame ready on time.
+ *
+ *  The startup latency is measured from ClipWorkflow::initialize() to the first
+ *  computed frame, so it includes the seek to the clip's beginning.
+ *  For each media, the scheduler keeps a smoothed latency and its smoothed
+ *  deviation, and plans for the mean plus four deviations. Media that have never
+ *  been started use the average of all the media instead.
+ *  The number of clips being preloaded at the same time is capped, so upcoming
+ *  cuts don't open every decoder at once.
+ */
+class   PreloadScheduler : public QObject, public Singleton<PreloadScheduler>
+{
+    Q_OBJECT
+
+    public:
+        /**
+         *  \brief  Used until a first latency has been measured (in µs).
+         *
+         *  This is the previous fixed preloading delay: 60 frames at 30fps.
+         */
+        static const qint64     DefaultLatency = 2000000;
+        /// \brief  Always preload at least that early (in µs)
+        static const qint64     MinLeadTime = 250000;
+
+        /**
+         *  \brief  Record the time a clip from this media took to compute its
+         *          first frame.
+         */
+        void                    startupMeasured( const Media* media, qint64 latency );
+        /**
+         *  \return The time (in µs) it should take to start a clip from this media.
+         */
+        qint64                  predictedLatency( const Media* media ) const;
+        /**
+         *  \param  timeToStart The time left (in µs) before the clip is rendered.
+         *  \return true if the clip has to be preloaded now.
+         */
+        bool                    mustPreload( const Media* media, qint64 timeToStart ) const;
+        /**
+         *  \return false if a clip that is already loaded is so far from being
+         *          rendered that it should be stopped.
+         *
+         *  This is twice the preloading delay, so a clip isn't stopped and restarted
+         *  because its media latency has just been reevaluated.
+         */
+        bool                    mustKeepLoaded( const Media* media, qint64 timeToStart ) const;
+        /**
+         *  \return true if a clip starting in timeToStart µs doesn't have to be
+         *          loaded, whatever its media.
+         *
+         *  This lets the tracks stop looking at upcoming clips early.
+         */
+        bool                    isBeyondHorizon( qint64 timeToStart ) const;
+
+        /**
+         *  \brief  Reserve a slot to preload a clip.
+         *  \return false if too many clips are already being preloaded.
+         */
+        bool                    acquirePreloadSlot();
+        void                    releasePreloadSlot();
+        int                     nbPreloading() const;
+        void                    setMaxPreloading( int maxPreloading );
+        int                     maxPreloading() const;
+        /**
+         *  \return The number of times a preload was postponed because of the cap.
+         */
+        int                     nbPostponed() const;
+
+    private:
+        PreloadScheduler();
+        virtual ~PreloadScheduler();
+
+        struct  Estimate
+        {
+            qint64      mean;
+            qint64      deviation;
+        };
+        static void             update( Estimate& estimate, qint64 latency );
+        static qint64           leadTime( const Estimate& estimate );
+        /// \warning    The scheduler mutex must be locked.
+        void                    updateMaxLeadTime();
+
+    private:
+        mutable QMutex*             m_mutex;
+        QHash<QUuid, Estimate>      m_estimates;
+        /// \brief  All media mixed together, used for unknown media
+        Estimate                    m_globalEstimate;
+        bool                        m_hasGlobalEstimate;
+        /// \brief  The longest lead time over every media
+        qint64                      m_maxLeadTime;
+        QAtomicInt                  m_nbPreloading;
+        QAtomicInt                  m_maxPreloading;
+        QAtomicInt                  m_nbPostponed;
+
+    private slots:
+        void                    maxPreloadingChanged( const QVariant& maxPreloading );
+
+        friend class    Singleton<PreloadScheduler>;
+};
+
+#endif // PRELOADSCHEDULER_H
@@ -23,24 +23,45 @@
 #ifndef STACKEDBUFFER_HPP
 #define STACKEDBUFFER_HPP
 
+#include <QAtomicInt>
+#include <QMutex>
 #include <QtDebug>
-#include "Pool.hpp"
 
+template <typename T>
+class   StackedBufferPool;
+
+/**
+ *  \brief  A handle on a computed buffer, handed from a ClipWorkflow to the renderer.
+ *
+ *  Handles are intrusively reference counted. When the last reference is released,
+ *  the handle goes back to the StackedBufferPool it comes from (which gives the
+ *  buffer back to its ClipWorkflow if required), so that no memory is allocated
+ *  per frame once the pool is warm.
+ *  A handle that doesn't belong to any pool is never destroyed by release().
+ */
 template <typename T>
 class   StackedBuffer
 {
     public:
-        StackedBuffer( T buff, bool mustBeReleased  = true ) :
+        StackedBuffer( T buff, bool mustBeReleased = true ) :
                 m_buff( buff ),
-                m_mustRelease( mustBeReleased )
+                m_mustRelease( mustBeReleased ),
+                m_refCount( 1 ),
+                m_pool( NULL ),
+                m_next( NULL )
         {
         }
-        virtual ~StackedBuffer()
+
+        void        ref()
         {
+            m_refCount.ref();
         }
-
         /// \warning    Calling this method will definitely invalidate the pointer;
-        virtual void    release() = 0;
+        void        release()
+        {
+            if ( m_refCount.deref() == false && m_pool != NULL )
+                m_pool->recycle( this );
+        }
 
         const   T&   get() const
         {
@@ -62,6 +83,133 @@ class   StackedBuffer
     protected:
         T           m_buff;
         bool        m_mustRelease;
+
+    private:
+        QAtomicInt              m_refCount;
+        StackedBufferPool<T>*   m_pool;
+        /// \brief  Links the handles in the pool's free list
+        StackedBuffer<T>*       m_next;
+
+        friend class    StackedBufferPool<T>;
+};
+
+/**
+ *  \brief  Recycles the StackedBuffer handles of a ClipWorkflow.
+ *
+ *  The pool is owned by its handler (the ClipWorkflow), but may outlive it: when
+ *  the handler is destroyed while some handles are still used by the renderer, the
+ *  pool is only detached, and deletes itself once the last handle comes back.
+ */
+template <typename T>
+class   StackedBufferPool
+{
+    public:
+        class   Handler
+        {
+            public:
+                virtual ~Handler() {}
+                /**
+                 *  \brief  Called when the last reference on a handle created
+                 *          with mustBeReleased set to true is released.
+                 */
+                virtual void    releaseBuffer( T buff ) = 0;
+        };
+
+        StackedBufferPool( Handler* handler ) :
+                m_handler( handler ),
+                m_free( NULL ),
+                m_nbOutstanding( 0 )
+        {
+            m_mutex = new QMutex;
+        }
+
+        StackedBuffer<T>*   get( T buff, bool mustBeReleased = true )
+        {
+            QMutexLocker        lock( m_mutex );
+            StackedBuffer<T>*   sb = m_free;
+
+            if ( sb != NULL )
+            {
+                m_free = sb->m_next;
+                sb->m_buff = buff;
+                sb->m_mustRelease = mustBeReleased;
+                sb->m_refCount = 1;
+            }
+            else
+            {
+                s_nbAllocations.ref();
+                sb = new StackedBuffer<T>( buff, mustBeReleased );
+                sb->m_pool = this;
+            }
+            sb->m_next = NULL;
+            ++m_nbOutstanding;
+            return sb;
+        }
+        /**
+         *  \brief  To be called by the handler instead of deleting the pool.
+         */
+        void                detach()
+        {
+            m_mutex->lock();
+            m_handler = NULL;
+            if ( m_nbOutstanding == 0 )
+            {
+                m_mutex->unlock();
+                delete this;
+                return ;
+            }
+            m_mutex->unlock();
+        }
+        /**
+         *  \return The total number of handles allocated by every pool of this type.
+         *
+         *  Once warm, a pool doesn't allocate anymore, so this shouldn't change
+         *  during playback.
+         */
+        static int          nbAllocations()
+        {
+            return s_nbAllocations;
+        }
+
+    private:
+        ~StackedBufferPool()
+        {
+            while ( m_free != NULL )
+            {
+                StackedBuffer<T>*   next = m_free->m_next;
+                delete m_free;
+                m_free = next;
+            }
+            delete m_mutex;
+        }
+        void                recycle( StackedBuffer<T>* sb )
+        {
+            m_mutex->lock();
+            if ( sb->m_mustRelease == true && m_handler != NULL )
+                m_handler->releaseBuffer( sb->m_buff );
+            sb->m_next = m_free;
+            m_free = sb;
+            --m_nbOutstanding;
+            if ( m_handler == NULL && m_nbOutstanding == 0 )
+            {
+                m_mutex->unlock();
+                delete this;
+                return ;
+            }
+            m_mutex->unlock();
+        }
+
+    private:
+        Handler*                m_handler;
+        QMutex*                 m_mutex;
+        StackedBuffer<T>*       m_free;
+        quint32                 m_nbOutstanding;
+        static QAtomicInt       s_nbAllocations;
+
+        friend class    StackedBuffer<T>;
 };
 
+template <typename T>
+QAtomicInt  StackedBufferPool<T>::s_nbAllocations = QAtomicInt( 0 );
+
 #endif // STACKEDBUFFER_HPP
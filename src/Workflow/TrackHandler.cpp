@@ -24,39 +24,109 @@
 #include "LightVideoFrame.h"
 #include "TrackHandler.h"
 #include "TrackWorkflow.h"
+#include "mdate.h"
 
 #include <QDomDocument>
 #include <QDomElement>
+#include <QMutex>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QVariant>
 
-LightVideoFrame* TrackHandler::nullOutput = NULL;
+
+/**
+ *  \brief  Fetches one track's output from the TrackHandler's thread pool.
+ */
+class   TrackHandler::TrackFetcher : public QRunnable
+{
+    public:
+        TrackFetcher( TrackHandler* handler, unsigned int trackId ) :
+                m_handler( handler ),
+                m_trackId( trackId ),
+                m_currentFrame( 0 ),
+                m_subFrame( 0 ),
+                m_paused( false )
+        {
+            setAutoDelete( false );
+        }
+        void    setFrame( qint64 currentFrame, qint64 subFrame, bool paused )
+        {
+            m_currentFrame = currentFrame;
+            m_subFrame = subFrame;
+            m_paused = paused;
+        }
+        virtual void    run()
+        {
+            m_handler->fetchTrack( m_trackId, m_currentFrame, m_subFrame, m_paused );
+            m_handler->m_fetchDone->release();
+        }
+
+    private:
+        TrackHandler*   m_handler;
+        unsigned int    m_trackId;
+        qint64          m_currentFrame;
+        qint64          m_subFrame;
+        bool            m_paused;
+};
 
 TrackHandler::TrackHandler( unsigned int nbTracks, MainWorkflow::TrackType trackType,
                             EffectsEngine* effectsEngine ) :
         m_trackCount( nbTracks ),
         m_trackType( trackType ),
         m_length( 0 ),
-        m_effectEngine( effectsEngine )
+        m_effectEngine( effectsEngine ),
+        m_tmpAudioBuffer( NULL ),
+        m_mixer( NULL ),
+        m_outputExact( true ),
+        m_nbFetchWorkers( 0 )
 {
-    TrackHandler::nullOutput = new LightVideoFrame();
-
+    m_fetchStatsMutex = new QMutex;
+    m_layersMutex = new QMutex;
+    m_endReachedMutex = new QMutex;
+    m_fetchDone = new QSemaphore;
+    m_fetchPool = new QThreadPool;
+    m_outputs = new void*[nbTracks];
+    m_endedTracks = new bool[nbTracks];
+    m_fetchStats = new FetchStats[nbTracks];
+    m_fetchers = new TrackFetcher*[nbTracks];
+    m_layers = new VideoLayer[nbTracks];
+    m_currentLayers = new VideoLayer[nbTracks];
     m_tracks = new Toggleable<TrackWorkflow*>[nbTracks];
+    if ( trackType == MainWorkflow::AudioTrack )
+        m_mixer = new AudioMixer( nbTracks );
     for ( unsigned int i = 0; i < nbTracks; ++i )
     {
         m_tracks[i].setPtr( new TrackWorkflow( i, trackType ) );
         connect( m_tracks[i], SIGNAL( trackEndReached( unsigned int ) ), this, SLOT( trackEndReached(unsigned int) ), Qt::DirectConnection );
+        m_fetchers[i] = new TrackFetcher( this, i );
+        m_outputs[i] = NULL;
+        m_endedTracks[i] = false;
     }
+    resetFetchStats();
 }
 
 TrackHandler::~TrackHandler()
 {
-    if ( nullOutput != NULL )
-    {
-        delete nullOutput;
-        nullOutput = NULL;
-    }
+    //Make sure no worker is still using a track.
+    m_fetchPool->waitForDone();
+    delete m_fetchPool;
+    for ( unsigned int i = 0; i < m_trackCount; ++i )
+        delete m_fetchers[i];
+    delete[] m_fetchers;
+    delete[] m_fetchStats;
+    delete[] m_outputs;
+    delete[] m_endedTracks;
+    delete[] m_currentLayers;
+    delete[] m_layers;
+    delete m_layersMutex;
+    delete m_fetchDone;
+    delete m_endReachedMutex;
+    delete m_fetchStatsMutex;
     for (unsigned int i = 0; i < m_trackCount; ++i)
         delete m_tracks[i];
     delete[] m_tracks;
+    delete m_mixer;
 }
 
 void
@@ -80,6 +150,12 @@ void
 TrackHandler::startRender()
 {
     m_endReached = false;
+    {
+        QMutexLocker    lock( m_endReachedMutex );
+        for ( unsigned int i = 0; i < m_trackCount; ++i )
+            m_endedTracks[i] = false;
+    }
+    resetFetchStats();
     computeLength();
     if ( m_length == 0 )
         m_endReached = true;
@@ -112,44 +188,179 @@ TrackHandler::getLength() const
 void
 TrackHandler::getOutput( qint64 currentFrame, qint64 subFrame, bool paused )
 {
+    int             nbWorkers = m_nbFetchWorkers;
+    int             nbStarted = 0;
+    unsigned int    lowestTrack = 0;
+
     m_tmpAudioBuffer = NULL;
+    if ( m_trackType == MainWorkflow::VideoTrack )
+    {
+        {
+            QMutexLocker    lock( m_layersMutex );
+            for ( unsigned int i = 0; i < m_trackCount; ++i )
+                m_currentLayers[i] = m_layers[i];
+        }
+        lowestTrack = lowestVisibleTrack( currentFrame );
+    }
     for ( unsigned int i = 0; i < m_trackCount; ++i )
     {
-        if ( m_trackType == MainWorkflow::VideoTrack )
+        m_outputs[i] = NULL;
+        if ( m_tracks[i].activated() == false || i < lowestTrack )
+            continue ;
+        if ( nbWorkers < 2 )
+            fetchTrack( i, currentFrame, subFrame, paused );
+        else
+        {
+            m_fetchers[i]->setFrame( currentFrame, subFrame, paused );
+            m_fetchPool->start( m_fetchers[i] );
+            ++nbStarted;
+        }
+    }
+    //Every track has to be fetched before anything is given to the effects engine.
+    m_fetchDone->acquire( nbStarted );
+    if ( lowestTrack > 0 )
+    {
+        //The hidden tracks don't render anything, and will be repositioned once
+        //they're visible again. Their clips still have to be preloaded and
+        //stopped though. If the hiding track didn't render anything after all,
+        //they have to be fetched now.
+        bool    occluded = ( m_outputs[lowestTrack] != NULL );
+
+        for ( unsigned int i = 0; i < lowestTrack; ++i )
         {
             if ( m_tracks[i].activated() == false )
-            {
-                m_effectEngine->setVideoInput( i + 1, *TrackHandler::nullOutput );
-            }
+                continue ;
+            if ( occluded == false )
+                fetchTrack( i, currentFrame, subFrame, paused );
             else
             {
-                void*   ret = m_tracks[i]->getOutput( currentFrame, subFrame, paused );
-                if ( ret == NULL )
-                    m_effectEngine->setVideoInput( i + 1, *TrackHandler::nullOutput );
-                else
-                {
-                    StackedBuffer<LightVideoFrame*>* stackedBuffer =
-                        reinterpret_cast<StackedBuffer<LightVideoFrame*>*>( ret );
-                    m_effectEngine->setVideoInput( i + 1, *( stackedBuffer->get() ) );
-                }
+                m_tracks[i]->schedule( currentFrame );
+                QMutexLocker    lock( m_fetchStatsMutex );
+                ++m_fetchStats[i].nbOccluded;
             }
         }
-        else
+    }
+    m_outputExact = true;
+    for ( unsigned int i = 0; i < m_trackCount; ++i )
+    {
+        void*   ret = m_outputs[i];
+
+        if ( ret != NULL && m_tracks[i]->isOutputExact() == false )
+            m_outputExact = false;
+
+        //A track without any frame isn't given to the effects engine, which
+        //then doesn't render its input at all.
+        if ( m_trackType == MainWorkflow::VideoTrack && ret != NULL )
         {
-            if ( m_tracks[i].activated() == true )
-            {
-                //If paused is false at this point, there's probably something wrong...
-                void*   ret = m_tracks[i]->getOutput( currentFrame, subFrame, paused );
-                //m_tmpAudioBuffer is NULl by default, so it will remain NULL if we continue;
-                if ( ret == NULL )
-                    continue ;
-                StackedBuffer<AudioClipWorkflow::AudioSample*>* stackedBuffer =
-                    reinterpret_cast<StackedBuffer<AudioClipWorkflow::AudioSample*>*> ( ret );
-                if ( stackedBuffer != NULL )
-                    m_tmpAudioBuffer = stackedBuffer->get();
-            }
+            StackedBuffer<LightVideoFrame*>* stackedBuffer =
+                reinterpret_cast<StackedBuffer<LightVideoFrame*>*>( ret );
+            //This only shares the frame: the layer isn't part of the frame data.
+            LightVideoFrame     frame = *( stackedBuffer->get() );
+
+            frame.setLayer( m_currentLayers[i] );
+            m_effectEngine->setVideoInput( i + 1, frame );
+        }
+    }
+    if ( m_trackType == MainWorkflow::AudioTrack )
+        mixAudio( currentFrame, subFrame, paused );
+    //No worker is running anymore.
+    deactivateEndedTracks();
+}
+
+void
+TrackHandler::mixAudio( qint64 currentFrame, qint64 subFrame, bool paused )
+{
+    quint32     nbFrames = 0;
+
+    for ( unsigned int i = 0; i < m_trackCount; ++i )
+    {
+        //If paused is false at this point, there's probably something wrong...
+        if ( m_outputs[i] == NULL )
+            continue ;
+        StackedBuffer<AudioClipWorkflow::AudioSample*>* stackedBuffer =
+            reinterpret_cast<StackedBuffer<AudioClipWorkflow::AudioSample*>*>(
+                    m_outputs[i] );
+        AudioClipWorkflow::AudioSample*     sample = stackedBuffer->get();
+
+        m_mixer->addInput( i, sample );
+        if ( sample->nbSample > nbFrames )
+            nbFrames = sample->nbSample;
+    }
+    //Tracks don't produce buffers of the same size. Fetch the ones that produced
+    //less than the others again, instead of padding them with silence.
+    //The samples have been copied, so the previous buffers can be released.
+    for ( unsigned int i = 0; i < m_trackCount; ++i )
+    {
+        if ( m_outputs[i] == NULL )
+            continue ;
+        for ( int j = 0; j < MaxExtraFetches &&
+                         m_mixer->nbQueuedFrames( i ) < nbFrames; ++j )
+        {
+            fetchTrack( i, currentFrame, subFrame, paused );
+            if ( m_outputs[i] == NULL )
+                break ;
+            StackedBuffer<AudioClipWorkflow::AudioSample*>* stackedBuffer =
+                reinterpret_cast<StackedBuffer<AudioClipWorkflow::AudioSample*>*>(
+                        m_outputs[i] );
+            m_mixer->addInput( i, stackedBuffer->get() );
         }
     }
+    //m_tmpAudioBuffer stays NULL if no track had anything to play.
+    m_tmpAudioBuffer = m_mixer->mix( nbFrames );
+}
+
+unsigned int
+TrackHandler::lowestVisibleTrack( qint64 currentFrame ) const
+{
+    for ( unsigned int i = m_trackCount - 1; i > 0; --i )
+    {
+        const VideoLayer&   layer = m_currentLayers[i];
+
+        if ( m_tracks[i].activated() == false || layer.opacity != VideoLayer::Opaque ||
+             layer.x != 0 || layer.y != 0 )
+            continue ;
+        if ( m_tracks[i]->hasClipAt( currentFrame ) == true )
+            return i;
+    }
+    return 0;
+}
+
+bool
+TrackHandler::isOutputExact() const
+{
+    return m_outputExact;
+}
+
+void
+TrackHandler::fetchTrack( unsigned int trackId, qint64 currentFrame, qint64 subFrame,
+                          bool paused )
+{
+    qint64      start = mdate();
+
+    m_outputs[trackId] = m_tracks[trackId]->getOutput( currentFrame, subFrame, paused );
+
+    qint64          duration = mdate() - start;
+    QMutexLocker    lock( m_fetchStatsMutex );
+    FetchStats&     stats = m_fetchStats[trackId];
+
+    stats.last = duration;
+    if ( duration > stats.max )
+        stats.max = duration;
+    stats.total += duration;
+    ++stats.nbFetches;
+}
+
+void
+TrackHandler::schedule( qint64 currentFrame )
+{
+    m_tmpAudioBuffer = NULL;
+    for ( unsigned int i = 0; i < m_trackCount; ++i )
+    {
+        m_outputs[i] = NULL;
+        if ( m_tracks[i].activated() == true )
+            m_tracks[i]->schedule( currentFrame );
+    }
+    deactivateEndedTracks();
 }
 
 void
@@ -184,6 +395,8 @@ TrackHandler::stop()
         if ( m_tracks[i].activated() == true )
             m_tracks[i]->stop();
     }
+    if ( m_mixer != NULL )
+        m_mixer->flush();
 }
 
 void
@@ -223,12 +436,51 @@ void
 TrackHandler::muteTrack( unsigned int trackId )
 {
     m_tracks[trackId].setHardDeactivation( true );
+    //Don't play what the track had queued.
+    if ( m_mixer != NULL )
+        m_mixer->setMuted( trackId, true );
 }
 
 void
 TrackHandler::unmuteTrack( unsigned int trackId )
 {
     m_tracks[trackId].setHardDeactivation( false );
+    if ( m_mixer != NULL )
+        m_mixer->setMuted( trackId, false );
+}
+
+void
+TrackHandler::setTrackGain( unsigned int trackId, float gain )
+{
+    Q_ASSERT( trackId < m_trackCount );
+
+    if ( m_mixer != NULL )
+        m_mixer->setGain( trackId, gain );
+}
+
+void
+TrackHandler::setTrackLayer( unsigned int trackId, const VideoLayer& layer )
+{
+    Q_ASSERT( trackId < m_trackCount );
+
+    QMutexLocker    lock( m_layersMutex );
+    m_layers[trackId] = layer;
+}
+
+VideoLayer
+TrackHandler::trackLayer( unsigned int trackId ) const
+{
+    Q_ASSERT( trackId < m_trackCount );
+
+    QMutexLocker    lock( m_layersMutex );
+    return m_layers[trackId];
+}
+
+AudioMixer::Stats
+TrackHandler::mixerStats() const
+{
+    Q_ASSERT( m_mixer != NULL );
+    return m_mixer->stats();
 }
 
 Clip*
@@ -258,8 +510,32 @@ TrackHandler::endIsReached() const
 void
 TrackHandler::trackEndReached( unsigned int trackId )
 {
-    m_tracks[trackId].deactivate();
+    QMutexLocker    lock( m_endReachedMutex );
 
+    //This can be called by the workers, while the render thread reads which
+    //tracks are activated. The track is deactivated once they're done.
+    m_endedTracks[trackId] = true;
+}
+
+void
+TrackHandler::deactivateEndedTracks()
+{
+    {
+        QMutexLocker    lock( m_endReachedMutex );
+        bool            ended = false;
+
+        for ( unsigned int i = 0; i < m_trackCount; ++i )
+        {
+            if ( m_endedTracks[i] == true )
+            {
+                m_tracks[i].deactivate();
+                m_endedTracks[i] = false;
+                ended = true;
+            }
+        }
+        if ( ended == false || m_endReached == true )
+            return ;
+    }
     for ( unsigned int i = 0; i < m_trackCount; ++i)
     {
         if ( m_tracks[i].activated() == true )
@@ -320,3 +596,47 @@ TrackHandler::unmuteClip( const QUuid &uuid, quint32 trackId )
 {
     m_tracks[trackId]->unmuteClip( uuid );
 }
+
+void
+TrackHandler::setFetchWorkerCount( int nbWorkers )
+{
+    if ( nbWorkers >= 2 )
+        m_fetchPool->setMaxThreadCount( nbWorkers );
+    m_nbFetchWorkers = nbWorkers;
+}
+
+int
+TrackHandler::fetchWorkerCount() const
+{
+    return m_nbFetchWorkers;
+}
+
+void
+TrackHandler::fetchWorkerCountChanged( const QVariant& nbWorkers )
+{
+    setFetchWorkerCount( nbWorkers.toInt() );
+}
+
+TrackHandler::FetchStats
+TrackHandler::fetchStats( unsigned int trackId ) const
+{
+    Q_ASSERT( trackId < m_trackCount );
+
+    QMutexLocker    lock( m_fetchStatsMutex );
+    return m_fetchStats[trackId];
+}
+
+void
+TrackHandler::resetFetchStats()
+{
+    QMutexLocker    lock( m_fetchStatsMutex );
+
+    for ( unsigned int i = 0; i < m_trackCount; ++i )
+    {
+        m_fetchStats[i].last = 0;
+        m_fetchStats[i].max = 0;
+        m_fetchStats[i].total = 0;
+        m_fetchStats[i].nbFetches = 0;
+        m_fetchStats[i].nbOccluded = 0;
+    }
+}
@@ -23,20 +23,43 @@
 #ifndef TRACKHANDLER_H
 #define TRACKHANDLER_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include "Toggleable.hpp"
+#include "LightVideoFrame.h"
 #include "MainWorkflow.h"
 
 //TEMPORARY:
 #include "AudioClipWorkflow.h"
+#include "AudioMixer.h"
 
 class   EffectEngine;
 class   TrackWorkflow;
 
+class   QMutex;
+class   QSemaphore;
+class   QThreadPool;
+class   QVariant;
+
 class   TrackHandler : public QObject
 {
     Q_OBJECT
     public:
+        /**
+         *  \brief  Timings of the TrackWorkflow::getOutput() calls for one track.
+         *
+         *  All the durations are in microseconds.
+         */
+        struct  FetchStats
+        {
+            qint64      last;
+            qint64      max;
+            qint64      total;
+            qint64      nbFetches;
+            /// \brief  The frames this track wasn't fetched for, as it was hidden.
+            qint64      nbOccluded;
+        };
+
         TrackHandler( unsigned int nbTracks, MainWorkflow::TrackType trackType, EffectsEngine* effectsEngine );
         ~TrackHandler();
 
@@ -58,6 +81,14 @@ class   TrackHandler : public QObject
          */
         void                    getOutput( qint64 currentFrame, qint64 subFrame,
                                            bool paused );
+        /**
+         *  \brief  Start, stop or keep the clips of every track, and detect the end
+         *          of the tracks, without rendering anything.
+         *
+         *  This is used instead of getOutput() when the frame is already known.
+         *  \sa     TrackWorkflow::schedule()
+         */
+        void                    schedule( qint64 currentFrame );
         void                    activateAll();
         qint64                  getClipPosition( const QUuid& uuid, unsigned int trackId ) const;
         void                    stop();
@@ -66,6 +97,20 @@ class   TrackHandler : public QObject
         Clip*                   removeClip( const QUuid& uuid, unsigned int trackId );
         void                    muteTrack( unsigned int trackId );
         void                    unmuteTrack( unsigned int trackId );
+        /**
+         *  \brief  Set the gain applied to an audio track when mixing it.
+         */
+        void                    setTrackGain( unsigned int trackId, float gain );
+        /**
+         *  \return The mixer statistics. Only audio tracks are mixed.
+         */
+        AudioMixer::Stats       mixerStats() const;
+        /**
+         *  \brief  Set the position and the opacity of a video track.
+         */
+        void                    setTrackLayer( unsigned int trackId,
+                                               const VideoLayer& layer );
+        VideoLayer              trackLayer( unsigned int trackId ) const;
         Clip*                   getClip( const QUuid& uuid, unsigned int trackId );
         void                    clear();
 
@@ -73,6 +118,12 @@ class   TrackHandler : public QObject
         AudioClipWorkflow::AudioSample* getTmpAudioBuffer() { return m_tmpAudioBuffer; }
 
         bool                    endIsReached() const;
+        /**
+         *  \return false if a track rendered something else than the exact frame
+         *          during the last getOutput() call.
+         *  \sa     TrackWorkflow::isOutputExact()
+         */
+        bool                    isOutputExact() const;
 
         void                    save( QDomDocument& doc, QDomElement& timelineNode ) const;
 
@@ -97,12 +148,60 @@ class   TrackHandler : public QObject
         void                    muteClip( const QUuid& uuid, quint32 trackId );
         void                    unmuteClip( const QUuid& uuid, quint32 trackId );
 
+        /**
+         *  \brief  Set the number of threads used to fetch the tracks outputs.
+         *
+         *  With less than 2 workers, the tracks are fetched one after the other
+         *  from the rendering thread.
+         */
+        void                    setFetchWorkerCount( int nbWorkers );
+        int                     fetchWorkerCount() const;
+        /**
+         *  \return The getOutput() timings for the given track.
+         *  The values are only a snapshot, as they're updated by the render threads.
+         */
+        FetchStats              fetchStats( unsigned int trackId ) const;
+        void                    resetFetchStats();
+
     private:
+        class   TrackFetcher;
+
         void                    computeLength();
         void                    activateTrack( unsigned int tracKId );
+        /**
+         *  \brief  Fetch the output of a single track, and time it.
+         *
+         *  This can be called from any thread, as long as a track is only
+         *  fetched by one thread at a time.
+         */
+        void                    fetchTrack( unsigned int trackId, qint64 currentFrame,
+                                            qint64 subFrame, bool paused );
+        /**
+         *  \brief  Mix the fetched audio tracks into m_tmpAudioBuffer.
+         */
+        void                    mixAudio( qint64 currentFrame, qint64 subFrame,
+                                          bool paused );
+        /**
+         *  \brief  Return the lowest track that has to be fetched.
+         *
+         *  Every track renders frames at the project size, so an opaque track that
+         *  isn't moved hides all the tracks below it, when it has a clip to render.
+         */
+        unsigned int            lowestVisibleTrack( qint64 currentFrame ) const;
+        /**
+         *  \brief  Deactivate the tracks that reached their end during the last
+         *          fetch, and tell if every track is done.
+         *
+         *  This must be called from the render thread, once the workers are done.
+         */
+        void                    deactivateEndedTracks();
+
+        /**
+         *  \brief  How many times a track can be fetched again to fill a block.
+         */
+        static const int        MaxExtraFetches = 4;
 
     private:
-        static LightVideoFrame*         nullOutput;
         Toggleable<TrackWorkflow*>*     m_tracks;
         unsigned int                    m_trackCount;
         MainWorkflow::TrackType         m_trackType;
@@ -111,10 +210,43 @@ class   TrackHandler : public QObject
         bool                            m_endReached;
         EffectsEngine*                  m_effectEngine;
         AudioClipWorkflow::AudioSample* m_tmpAudioBuffer;
+        /// \brief  NULL for video tracks.
+        AudioMixer*                     m_mixer;
+        bool                            m_outputExact;
+        VideoLayer*                     m_layers;
+        /// \brief  The layers used by the frame being rendered.
+        VideoLayer*                     m_currentLayers;
+        mutable QMutex*                 m_layersMutex;
+        /**
+         *  \brief  The outputs of the last fetch, one per track.
+         *
+         *  This is where the workers store their result before the outputs are
+         *  given to the effects engine, in the track order.
+         */
+        void**                          m_outputs;
+        FetchStats*                     m_fetchStats;
+        mutable QMutex*                 m_fetchStatsMutex;
+        TrackFetcher**                  m_fetchers;
+        QThreadPool*                    m_fetchPool;
+        /**
+         *  \brief  Released once by each fetcher, so getOutput() can wait for
+         *          all of them before rendering.
+         */
+        QSemaphore*                     m_fetchDone;
+        QAtomicInt                      m_nbFetchWorkers;
+        /**
+         *  \brief  The tracks that reached their end during the last fetch.
+         */
+        bool*                           m_endedTracks;
+        /**
+         *  \brief  Tracks can reach their end from different worker threads.
+         */
+        QMutex*                         m_endReachedMutex;
 
 
     private slots:
         void                            trackEndReached( unsigned int trackId );
+        void                            fetchWorkerCountChanged( const QVariant& nbWorkers );
 
     signals:
         void                            tracksEndReached();
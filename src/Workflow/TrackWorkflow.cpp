@@ -28,9 +28,14 @@
 #include "ImageClipWorkflow.h"
 #include "AudioClipWorkflow.h"
 #include "Clip.h"
+#include "LightVideoFrame.h"
 #include "Media.h"
+#include "PreloadScheduler.h"
+#include "SeekIndex.h"
+#include "SettingsManager.h"
 #include <QReadWriteLock>
 #include <QDomDocument>
+#include <QImage>
 #include <QDomElement>
 
 TrackWorkflow::TrackWorkflow( unsigned int trackId, MainWorkflow::TrackType type  ) :
@@ -39,10 +44,26 @@ TrackWorkflow::TrackWorkflow( unsigned int trackId, MainWorkflow::TrackType type
         m_trackType( type ),
         m_lastFrame( 0 ),
         m_videoStackedBuffer( NULL ),
-        m_audioStackedBuffer( NULL )
+        m_audioStackedBuffer( NULL ),
+        m_fullSpeedRender( false ),
+        m_fallbackClip( NULL ),
+        m_outputExact( true )
 {
     m_renderOneFrameMutex = new QMutex;
     m_clipsLock = new QReadWriteLock;
+    m_lastOutput = new LightVideoFrame;
+    m_fallbackFrame = new LightVideoFrame;
+    m_fallbackBuffer = new StackedBuffer<LightVideoFrame*>( m_fallbackFrame, false );
+
+    SettingsManager::getInstance()->watchValue( "general/ClipStartupFallback",
+                this, SLOT( startupFallbackChanged( const QVariant& ) ),
+                SettingsManager::Vlmc );
+    SettingsManager::getInstance()->watchValue( "general/ClipStartupTimeout",
+                this, SLOT( startupTimeoutChanged( const QVariant& ) ),
+                SettingsManager::Vlmc );
+    m_startupFallback = static_cast<StartupFallback>(
+            VLMC_GET_INT( "general/ClipStartupFallback" ) );
+    m_startupTimeout = (qint64)VLMC_GET_INT( "general/ClipStartupTimeout" ) * 1000;
 }
 
 TrackWorkflow::~TrackWorkflow()
@@ -56,6 +77,9 @@ TrackWorkflow::~TrackWorkflow()
         delete it.value();
         it = m_clips.erase( it );
     }
+    delete m_fallbackBuffer;
+    delete m_fallbackFrame;
+    delete m_lastOutput;
     delete m_clipsLock;
     delete m_renderOneFrameMutex;
 }
@@ -78,7 +102,15 @@ void    TrackWorkflow::addClip( Clip* clip, qint64 start )
 void    TrackWorkflow::addClip( ClipWorkflow* cw, qint64 start )
 {
     QWriteLocker    lock( m_clipsLock );
+    //A clip that was already starting at this frame gets replaced.
+    QMap<qint64, ClipWorkflow*>::const_iterator     previous = m_clips.find( start );
+    if ( previous != m_clips.end() )
+        m_clipPositions.remove( previous.value()->getClip()->uuid() );
     m_clips.insert( start, cw );
+    m_clipPositions[cw->getClip()->uuid()] = start;
+    //The clip may come from another track, and still be running. It'll be
+    //stopped on the next frame if it's not supposed to render.
+    m_visitedClips.append( cw );
     computeLength();
 }
 
@@ -101,30 +133,28 @@ qint64              TrackWorkflow::getLength() const
 
 qint64              TrackWorkflow::getClipPosition( const QUuid& uuid ) const
 {
-    QMap<qint64, ClipWorkflow*>::const_iterator     it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::const_iterator     end = m_clips.end();
-
-    while ( it != end )
-    {
-        if ( it.value()->getClip()->uuid() == uuid )
-            return it.key();
-        ++it;
-    }
-    return -1;
+    return m_clipPositions.value( uuid, -1 );
 }
 
 Clip*               TrackWorkflow::getClip( const QUuid& uuid )
 {
-    QMap<qint64, ClipWorkflow*>::const_iterator     it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::const_iterator     end = m_clips.end();
+    QMap<qint64, ClipWorkflow*>::iterator     it = findClip( uuid );
 
-    while ( it != end )
-    {
-        if ( it.value()->getClip()->uuid() == uuid )
-            return it.value()->getClip();
-        ++it;
-    }
-    return NULL;
+    if ( it == m_clips.end() )
+        return NULL;
+    return it.value()->getClip();
+}
+
+QMap<qint64, ClipWorkflow*>::iterator
+TrackWorkflow::findClip( const QUuid& uuid )
+{
+    QHash<QUuid, qint64>::const_iterator    pos = m_clipPositions.constFind( uuid );
+
+    if ( pos == m_clipPositions.constEnd() )
+        return m_clips.end();
+    QMap<qint64, ClipWorkflow*>::iterator   it = m_clips.find( pos.value() );
+    Q_ASSERT( it != m_clips.end() && it.value()->getClip()->uuid() == uuid );
+    return it;
 }
 
 void*
@@ -144,20 +174,45 @@ TrackWorkflow::renderClip( ClipWorkflow* cw, qint64 currentFrame,
     {
         cw->getStateLock()->unlock();
 
-        if ( cw->isResyncRequired() == true || needRepositioning == true )
+        if ( cw->isResyncRequired() == true || needRepositioning == true ||
+             cw->isDelayedSeekReady() == true )
             adjustClipTime( currentFrame, start, cw );
-        return cw->getOutput( mode );
+        return getClipOutput( cw, mode );
     }
     else if ( cw->getState() == ClipWorkflow::Stopped )
     {
         cw->getStateLock()->unlock();
         cw->initialize();
-        cw->waitForCompleteInit();
-        if ( start != currentFrame || cw->getClip()->begin() != 0 ) //Clip was not started as its real begining
+        //When rendering to a file, every frame counts, so we have to wait.
+        if ( m_fullSpeedRender == true )
         {
-            adjustClipTime( currentFrame, start, cw );
+            cw->waitForCompleteInit();
+            if ( start != currentFrame || cw->getClip()->begin() != 0 ) //Clip was not started as its real begining
+            {
+                adjustClipTime( currentFrame, start, cw );
+            }
+            return getClipOutput( cw, mode );
         }
-        return cw->getOutput( mode );
+        //Frames will be rendered until the clip is ready, so it will have to be
+        //repositioned by then.
+        cw->requireResync();
+        m_outputExact = false;
+        return startupFallback( cw );
+    }
+    else if ( cw->getState() == ClipWorkflow::Initializing )
+    {
+        cw->getStateLock()->unlock();
+        if ( m_fullSpeedRender == false && cw->timeSinceInitialize() < m_startupTimeout )
+        {
+            m_outputExact = false;
+            return startupFallback( cw );
+        }
+        //The clip takes too long to start. Stop rendering the fallback and wait for it.
+        cw->waitForCompleteInit();
+        if ( cw->isResyncRequired() == true || start != currentFrame ||
+             cw->getClip()->begin() != 0 )
+            adjustClipTime( currentFrame, start, cw );
+        return getClipOutput( cw, mode );
     }
     else if ( cw->getState() == ClipWorkflow::EndReached ||
               cw->getState() == ClipWorkflow::Muted )
@@ -173,6 +228,67 @@ TrackWorkflow::renderClip( ClipWorkflow* cw, qint64 currentFrame,
     return NULL;
 }
 
+void*
+TrackWorkflow::getClipOutput( ClipWorkflow* cw, ClipWorkflow::GetMode mode )
+{
+    int     nbUnderruns = cw->nbUnderruns();
+    void*   ret = cw->getOutput( mode );
+
+    //On underrun, the previous frame is rendered again.
+    if ( cw->nbUnderruns() != nbUnderruns || cw->hasDelayedSeek() == true )
+        m_outputExact = false;
+    return ret;
+}
+
+bool
+TrackWorkflow::isOutputExact() const
+{
+    return m_outputExact;
+}
+
+bool
+TrackWorkflow::hasClipAt( qint64 currentFrame ) const
+{
+    QReadLocker     lock( m_clipsLock );
+    QMap<qint64, ClipWorkflow*>::const_iterator     it =
+            m_clips.upperBound( currentFrame );
+
+    if ( it == m_clips.constBegin() )
+        return false;
+    --it;
+    ClipWorkflow*   cw = it.value();
+    if ( currentFrame > it.key() + cw->getClip()->length() )
+        return false;
+    QReadLocker     lock2( cw->getStateLock() );
+    return cw->getState() != ClipWorkflow::Muted &&
+            cw->getState() != ClipWorkflow::EndReached;
+}
+
+qint64
+TrackWorkflow::frameToTime( qint64 nbFrames, ClipWorkflow* cw )
+{
+    Media*      media = cw->getClip()->getParent();
+    float       fps = ( media->fps() > 0.0f ? media->fps() : Clip::DefaultFPS );
+
+    return nbFrames * 1000000 / fps;
+}
+
+void
+TrackWorkflow::scheduleClip( ClipWorkflow* cw, qint64 timeToStart )
+{
+    PreloadScheduler*   scheduler = PreloadScheduler::getInstance();
+    Media*              media = cw->getClip()->getParent();
+
+    //The scheduler knows the average startup latency of the media. A clip that
+    //begins far from a keyframe will take longer than that to seek to its start.
+    qint64              begin = frameToTime( cw->getClip()->begin(), cw ) / 1000;
+    timeToStart -= media->seekIndex()->extraCost( begin );
+    if ( scheduler->mustPreload( media, timeToStart ) == true )
+        preloadClip( cw );
+    else if ( scheduler->mustKeepLoaded( media, timeToStart ) == false )
+        stopClipWorkflow( cw );
+}
+
 void                TrackWorkflow::preloadClip( ClipWorkflow* cw )
 {
     cw->getStateLock()->lockForRead();
@@ -180,7 +296,10 @@ void                TrackWorkflow::preloadClip( ClipWorkflow* cw )
     if ( cw->getState() == ClipWorkflow::Stopped )
     {
         cw->getStateLock()->unlock();
-        cw->initialize();
+        //If too many clips are already being preloaded, this will be tried
+        //again on the next frame.
+        if ( PreloadScheduler::getInstance()->acquirePreloadSlot() == true )
+            cw->initialize( true );
         return ;
     }
     cw->getStateLock()->unlock();
@@ -222,6 +341,7 @@ TrackWorkflow::stop()
         stopClipWorkflow( it.value() );
         ++it;
     }
+    m_visitedClips.clear();
     releasePreviousRender();
     m_lastFrame = 0;
 }
@@ -246,9 +366,10 @@ TrackWorkflow::getOutput( qint64 currentFrame, qint64 subFrame, bool paused )
 {
     releasePreviousRender();
     QReadLocker     lock( m_clipsLock );
+    m_outputExact = true;
 
-    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::iterator       end = m_clips.end();
+    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.seek( currentFrame );
+    QList<ClipWorkflow*>                        visitedClips;
     bool                                        needRepositioning;
     void*                                       ret = NULL;
     bool                                        renderOneFrame = false;
@@ -280,109 +401,215 @@ TrackWorkflow::getOutput( qint64 currentFrame, qint64 subFrame, bool paused )
         else
             needRepositioning = ( abs( subFrame - m_lastFrame ) > 1 ) ? true : false;
     }
-    while ( it != end )
+    //Clips don't overlap on a track, so the only clip that can be rendered is
+    //the last one starting before the current frame.
+    if ( it != m_clips.begin() )
     {
-        qint64          start = it.key();
-        ClipWorkflow*   cw = it.value();
-        //Is the clip supposed to render now ?
-//        qDebug() << "Start:" << start << "Current Frame:" << currentFrame;
-        if ( start <= currentFrame && currentFrame <= start + cw->getClip()->length() )
+        QMap<qint64, ClipWorkflow*>::iterator   prev = it - 1;
+        qint64                                  start = prev.key();
+        ClipWorkflow*                           cw = prev.value();
+
+        if ( currentFrame <= start + cw->getClip()->length() )
         {
-            if ( ret != NULL )
-                qCritical() << "There's more than one clip to render here. Undefined behaviour !";
             ret = renderClip( cw, currentFrame, start, needRepositioning,
                               renderOneFrame, paused );
             if ( m_trackType == MainWorkflow::VideoTrack )
                 m_videoStackedBuffer = reinterpret_cast<StackedBuffer<LightVideoFrame*>*>( ret );
             else
                 m_audioStackedBuffer = reinterpret_cast<StackedBuffer<AudioClipWorkflow::AudioSample*>*>( ret );
+            visitedClips.append( cw );
         }
-        //Is it about to be rendered ?
-        else if ( start > currentFrame &&
-                start - currentFrame < TrackWorkflow::nbFrameBeforePreload )
-            preloadClip( cw );
-        //Is it supposed to be stopped ?
-        else
-            stopClipWorkflow( cw );
-        ++it;
     }
+    scheduleClips( it, currentFrame, visitedClips );
     m_lastFrame = subFrame;
+    if ( m_videoStackedBuffer != NULL && m_videoStackedBuffer != m_fallbackBuffer )
+    {
+        //This only shares the frame, it's not copied.
+        *m_lastOutput = *( m_videoStackedBuffer->get() );
+        m_fallbackClip = NULL;
+    }
 
     return ret;
 }
 
-void            TrackWorkflow::moveClip( const QUuid& id, qint64 startingFrame )
+void
+TrackWorkflow::schedule( qint64 currentFrame )
 {
-    QWriteLocker    lock( m_clipsLock );
+    //Nothing from this track will be rendered.
+    releasePreviousRender();
+    QReadLocker     lock( m_clipsLock );
 
-    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::iterator       end = m_clips.end();
+    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.seek( currentFrame );
+    QList<ClipWorkflow*>                        visitedClips;
 
-    while ( it != end )
+    if ( checkEnd( currentFrame ) == true )
+        emit trackEndReached( m_trackId );
+    //The hidden clip is kept loaded, so it can be shown again at once. As
+    //m_lastFrame isn't updated, it will be repositioned then.
+    if ( it != m_clips.begin() )
     {
-        if ( it.value()->getClip()->uuid() == id )
+        QMap<qint64, ClipWorkflow*>::iterator   prev = it - 1;
+        ClipWorkflow*                           cw = prev.value();
+
+        if ( currentFrame <= prev.key() + cw->getClip()->length() )
         {
-            ClipWorkflow* cw = it.value();
-            m_clips.erase( it );
-            m_clips[startingFrame] = cw;
-            cw->requireResync();
-            computeLength();
-            return ;
+            preloadClip( cw );
+            visitedClips.append( cw );
         }
-        ++it;
     }
-    qDebug() << "Track" << m_trackId << "was asked to move clip" << id << "to position" << startingFrame
-            << "but this clip doesn't exist in this track";
+    scheduleClips( it, currentFrame, visitedClips );
 }
 
-Clip*       TrackWorkflow::removeClip( const QUuid& id )
+void
+TrackWorkflow::scheduleClips( QMap<qint64, ClipWorkflow*>::iterator it,
+                              qint64 currentFrame, QList<ClipWorkflow*>& visitedClips )
 {
-    QWriteLocker    lock( m_clipsLock );
-
-    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.begin();
     QMap<qint64, ClipWorkflow*>::iterator       end = m_clips.end();
+    PreloadScheduler*                           scheduler = PreloadScheduler::getInstance();
 
+    //Only look at the clips that may have to be preloaded.
     while ( it != end )
     {
-        if ( it.value()->getClip()->uuid() == id )
-        {
-            ClipWorkflow*   cw = it.value();
-            Clip*           clip = cw->getClip();
-            m_clips.erase( it );
-            stopClipWorkflow( cw );
-            computeLength();
-            cw->disconnect();
-            delete cw;
-            if ( m_length == 0 )
-                emit trackEndReached( m_trackId );
-            return clip;
-        }
+        ClipWorkflow*   cw = it.value();
+        qint64          timeToStart = frameToTime( it.key() - currentFrame, cw );
+
+        if ( scheduler->isBeyondHorizon( timeToStart ) == true )
+            break ;
+        scheduleClip( cw, timeToStart );
+        visitedClips.append( cw );
         ++it;
     }
-    return NULL;
+    //Any clip that was visited on the previous frame and isn't anymore is either
+    //past, or too far ahead.
+    foreach ( ClipWorkflow* cw, m_visitedClips )
+    {
+        if ( visitedClips.contains( cw ) == false )
+            stopClipWorkflow( cw );
+    }
+    m_visitedClips = visitedClips;
 }
 
-ClipWorkflow*       TrackWorkflow::removeClipWorkflow( const QUuid& id )
+void*
+TrackWorkflow::startupFallback( ClipWorkflow* cw )
 {
-    QWriteLocker    lock( m_clipsLock );
+    if ( m_trackType != MainWorkflow::VideoTrack )
+        return NULL;
+    if ( cw != m_fallbackClip )
+    {
+        computeFallbackFrame( cw );
+        m_fallbackClip = cw;
+    }
+    //Will be released by releasePreviousRender(), as any other buffer.
+    m_fallbackBuffer->ref();
+    return m_fallbackBuffer;
+}
 
-    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::iterator       end = m_clips.end();
+void
+TrackWorkflow::computeFallbackFrame( ClipWorkflow* cw )
+{
+    quint32                 width = MainWorkflow::getInstance()->getWidth();
+    quint32                 height = MainWorkflow::getInstance()->getHeight();
+    VideoFrame::Format      format = MainWorkflow::getInstance()->getVideoFormat();
+    const LightVideoFrame&  lastOutput = *m_lastOutput;
+
+    if ( m_startupFallback == LastFrame && lastOutput->frame.octets != NULL &&
+         lastOutput->width == width && lastOutput->height == height &&
+         lastOutput->format == format )
+    {
+        *m_fallbackFrame = lastOutput;
+        return ;
+    }
+    const QImage&       snapshot = cw->getClip()->getParent()->snapshotImage();
 
-    while ( it != end )
+    if ( m_startupFallback == Thumbnail && snapshot.isNull() == false )
     {
-        if ( it.value()->getClip()->uuid() == id )
-        {
-            ClipWorkflow*   cw = it.value();
-            cw->disconnect();
-            m_clips.erase( it );
-            computeLength();
-            return cw;
+        //RGB24 frames are BGR. QImage lines are padded, so they're copied one by one.
+        //The snapshot keeps its aspect ratio, and is centered on a black frame.
+        LightVideoFrame     frame( width, height );
+        frame.fillBlack();
+        VideoFrame&         dst = frame.reallocateIfShared();
+        QImage              image = snapshot.scaled( width, height, Qt::KeepAspectRatio )
+                                    .convertToFormat( QImage::Format_RGB888 )
+                                    .rgbSwapped();
+        quint32             left = ( width - image.width() ) / 2;
+        quint32             top = ( height - image.height() ) / 2;
+        quint32             lineSize = image.width() * Pixel::NbComposantes;
+
+        for ( int y = 0; y < image.height(); ++y )
+            memcpy( dst.scanLine( 0, top + y ) + left * Pixel::NbComposantes,
+                    image.scanLine( y ), lineSize );
+        *m_fallbackFrame = frame.converted( format );
+    }
+    else
+    {
+        LightVideoFrame     frame( width, height, format );
 
-        }
-        ++it;
+        frame.fillBlack();
+        *m_fallbackFrame = frame;
     }
-    return NULL;
+}
+
+void            TrackWorkflow::moveClip( const QUuid& id, qint64 startingFrame )
+{
+    QWriteLocker    lock( m_clipsLock );
+
+    QMap<qint64, ClipWorkflow*>::iterator       it = findClip( id );
+
+    if ( it != m_clips.end() )
+    {
+        ClipWorkflow* cw = it.value();
+        m_clips.erase( it );
+        QMap<qint64, ClipWorkflow*>::const_iterator     previous =
+                m_clips.find( startingFrame );
+        if ( previous != m_clips.end() )
+            m_clipPositions.remove( previous.value()->getClip()->uuid() );
+        m_clips.insert( startingFrame, cw );
+        m_clipPositions[id] = startingFrame;
+            cw->requireResync();
+        computeLength();
+        return ;
+    }
+    qDebug() << "Track" << m_trackId << "was asked to move clip" << id << "to position" << startingFrame
+            << "but this clip doesn't exist in this track";
+}
+
+Clip*       TrackWorkflow::removeClip( const QUuid& id )
+{
+    QWriteLocker    lock( m_clipsLock );
+
+    QMap<qint64, ClipWorkflow*>::iterator       it = findClip( id );
+
+    if ( it == m_clips.end() )
+        return NULL;
+    ClipWorkflow*   cw = it.value();
+    Clip*           clip = cw->getClip();
+    m_clips.erase( it );
+    m_clipPositions.remove( id );
+    m_visitedClips.removeAll( cw );
+    stopClipWorkflow( cw );
+    computeLength();
+    cw->disconnect();
+    delete cw;
+    if ( m_length == 0 )
+        emit trackEndReached( m_trackId );
+    return clip;
+}
+
+ClipWorkflow*       TrackWorkflow::removeClipWorkflow( const QUuid& id )
+{
+    QWriteLocker    lock( m_clipsLock );
+
+    QMap<qint64, ClipWorkflow*>::iterator       it = findClip( id );
+
+    if ( it == m_clips.end() )
+        return NULL;
+    ClipWorkflow*   cw = it.value();
+    cw->disconnect();
+    m_clips.erase( it );
+    m_clipPositions.remove( id );
+    m_visitedClips.removeAll( cw );
+    computeLength();
+    return cw;
 }
 
 void    TrackWorkflow::save( QDomDocument& doc, QDomElement& trackNode ) const
@@ -448,6 +675,8 @@ void    TrackWorkflow::clear()
         delete cw;
     }
     m_clips.clear();
+    m_clipPositions.clear();
+    m_visitedClips.clear();
     m_length = 0;
 }
 
@@ -469,6 +698,7 @@ TrackWorkflow::renderOneFrame()
 void
 TrackWorkflow::setFullSpeedRender( bool val )
 {
+    m_fullSpeedRender = val;
     foreach ( ClipWorkflow* cw, m_clips.values() )
     {
         cw->setFullSpeedRender( val );
@@ -480,17 +710,12 @@ TrackWorkflow::muteClip( const QUuid &uuid )
 {
     QWriteLocker    lock( m_clipsLock );
 
-    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::iterator       end = m_clips.end();
+    QMap<qint64, ClipWorkflow*>::iterator       it = findClip( uuid );
 
-    while ( it != end )
+    if ( it != m_clips.end() )
     {
-        if ( it.value()->getClip()->uuid() == uuid )
-        {
-            it.value()->mute();
-            return ;
-        }
-        ++it;
+        it.value()->mute();
+        return ;
     }
     qWarning() << "Failed to mute clip" << uuid << "it probably doesn't exist "
             "in this track";
@@ -501,18 +726,26 @@ TrackWorkflow::unmuteClip( const QUuid &uuid )
 {
     QWriteLocker    lock( m_clipsLock );
 
-    QMap<qint64, ClipWorkflow*>::iterator       it = m_clips.begin();
-    QMap<qint64, ClipWorkflow*>::iterator       end = m_clips.end();
+    QMap<qint64, ClipWorkflow*>::iterator       it = findClip( uuid );
 
-    while ( it != end )
+    if ( it != m_clips.end() )
     {
-        if ( it.value()->getClip()->uuid() == uuid )
-        {
-            it.value()->unmute();
-            return ;
-        }
-        ++it;
+        it.value()->unmute();
+        return ;
     }
     qWarning() << "Failed to unmute clip" << uuid << "it probably doesn't exist "
             "in this track";
 }
+
+void
+TrackWorkflow::startupFallbackChanged( const QVariant& fallback )
+{
+    //This will be used from the next clip to start.
+    m_startupFallback = static_cast<StartupFallback>( fallback.toInt() );
+}
+
+void
+TrackWorkflow::startupTimeoutChanged( const QVariant& timeout )
+{
+    m_startupTimeout = (qint64)timeout.toInt() * 1000;
+}
@@ -23,9 +23,13 @@
 #ifndef TRACKWORKFLOW_H
 #define TRACKWORKFLOW_H
 
+#include "ClipIndex.hpp"
 #include "MainWorkflow.h"
 #include "StackedBuffer.hpp"
 
+#include <QHash>
+#include <QList>
+#include <QMap>
 #include <QObject>
 
 class   ClipWorkflow;
@@ -33,12 +37,9 @@ class   LightVideoFrame;
 
 class   QDomElement;
 class   QDomElement;
-template <typename T>
-class   QList;
-template <typename T, typename U>
-class   QMap;
 class   QMutex;
 class   QReadWriteLock;
+class   QVariant;
 class   QWaitCondition;
 
 //TODO: REMOVE THIS
@@ -55,11 +56,29 @@ class   TrackWorkflow : public QObject
     Q_OBJECT
 
     public:
+        /**
+         *  \brief  What is rendered while a clip is starting.
+         */
+        enum    StartupFallback
+        {
+            LastFrame, ///< The last frame this track rendered
+            BlackFrame,
+            Thumbnail, ///< The media snapshot
+        };
+
         TrackWorkflow( unsigned int trackId, MainWorkflow::TrackType type );
         ~TrackWorkflow();
 
         void*                                   getOutput( qint64 currentFrame,
                                                            qint64 subFrame, bool paused );
+        /**
+         *  \brief  Start, stop or keep the clips as getOutput() would, without
+         *          rendering anything.
+         *
+         *  This is used when the track is hidden by an opaque track, or when
+         *  the frame comes from the renderer's frame cache.
+         */
+        void                                    schedule( qint64 currentFrame );
         qint64                                  getLength() const;
         void                                    stop();
         void                                    moveClip( const QUuid& id, qint64 startingFrame );
@@ -70,9 +89,6 @@ class   TrackWorkflow : public QObject
         qint64                                  getClipPosition( const QUuid& uuid ) const;
         Clip*                                   getClip( const QUuid& uuid );
 
-        //FIXME: this won't be reliable as soon as we change the fps from the configuration
-        static const unsigned int               nbFrameBeforePreload = 60;
-
         void                                    save( QDomDocument& doc, QDomElement& trackNode ) const;
         void                                    clear();
 
@@ -91,23 +107,83 @@ class   TrackWorkflow : public QObject
          */
         void                                    muteClip( const QUuid& uuid );
         void                                    unmuteClip( const QUuid& uuid );
+        /**
+         *  \return false if the last output isn't the exact frame, because a
+         *          clip was still starting, seeking, or had no frame ready.
+         */
+        bool                                    isOutputExact() const;
+        /**
+         *  \return true if a clip that isn't muted is to be rendered at this frame.
+         */
+        bool                                    hasClipAt( qint64 currentFrame ) const;
 
     private:
         void                                    computeLength();
+        /**
+         *  \brief  Get a clip output, and check if it is exact.
+         */
+        void*                                   getClipOutput( ClipWorkflow* cw,
+                                                        ClipWorkflow::GetMode mode );
         void*                                   renderClip( ClipWorkflow* cw, qint64 currentFrame,
                                                             qint64 start, bool needRepositioning,
                                                             bool renderOneFrame, bool paused );
+        /**
+         *  \brief  Start, stop or leave an upcoming clip, according to the time
+         *          left before it is rendered.
+         *  \sa     PreloadScheduler
+         */
+        void                                    scheduleClip( ClipWorkflow* cw,
+                                                              qint64 timeToStart );
+        /**
+         *  \brief  Schedule the clips starting from it, and stop the clips that
+         *          were visited on the previous frame but aren't anymore.
+         *  \param  visitedClips    The clips already visited for this frame.
+         *  \warning    m_clipsLock must be locked.
+         */
+        void                                    scheduleClips(
+                                                    QMap<qint64, ClipWorkflow*>::iterator it,
+                                                    qint64 currentFrame,
+                                                    QList<ClipWorkflow*>& visitedClips );
+        /**
+         *  \brief  Convert a number of timeline frames to microseconds.
+         */
+        static qint64                           frameToTime( qint64 nbFrames, ClipWorkflow* cw );
+        /**
+         *  \brief  Return the clip using m_clipPositions, or m_clips.end()
+         *  \warning    m_clipsLock must be locked.
+         */
+        QMap<qint64, ClipWorkflow*>::iterator   findClip( const QUuid& uuid );
         void                                    preloadClip( ClipWorkflow* cw );
         void                                    stopClipWorkflow( ClipWorkflow* cw );
         bool                                    checkEnd( qint64 currentFrame ) const;
         void                                    adjustClipTime( qint64 currentFrame, qint64 start, ClipWorkflow* cw );
         void                                    releasePreviousRender();
+        /**
+         *  \brief  Return the buffer to render while a clip is initializing.
+         *
+         *  Audio tracks don't have any fallback, and will render silence.
+         */
+        void*                                   startupFallback( ClipWorkflow* cw );
+        void                                    computeFallbackFrame( ClipWorkflow* cw );
 
 
     private:
         unsigned int                            m_trackId;
 
-        QMap<qint64, ClipWorkflow*>             m_clips;
+        ClipIndex<ClipWorkflow*>                m_clips;
+        /**
+         *  \brief  The starting frame of each clip, by clip uuid.
+         *
+         *  This must be kept in sync with m_clips.
+         */
+        QHash<QUuid, qint64>                    m_clipPositions;
+        /**
+         *  \brief  The clips that were rendered or scheduled on the last frame.
+         *
+         *  Those are the only clips that may be loaded, so they're the only ones
+         *  that have to be stopped when they're not visited anymore.
+         */
+        QList<ClipWorkflow*>                    m_visitedClips;
 
         /**
          *  \brief      The track length in frames.
@@ -124,6 +200,33 @@ class   TrackWorkflow : public QObject
         StackedBuffer<LightVideoFrame*>*                    m_videoStackedBuffer;
         StackedBuffer<AudioClipWorkflow::AudioSample*>*     m_audioStackedBuffer;
 
+        bool                                    m_fullSpeedRender;
+        StartupFallback                         m_startupFallback;
+        /**
+         *  \brief  How long (in microseconds) the fallback can be rendered, before
+         *          waiting for the clip to be ready.
+         */
+        qint64                                  m_startupTimeout;
+        /**
+         *  \brief  A reference on the last frame this track rendered.
+         */
+        LightVideoFrame*                        m_lastOutput;
+        LightVideoFrame*                        m_fallbackFrame;
+        /**
+         *  \brief  Wraps m_fallbackFrame. This doesn't belong to any pool, so
+         *          releasing it has no effect.
+         */
+        StackedBuffer<LightVideoFrame*>*        m_fallbackBuffer;
+        /**
+         *  \brief  The clip m_fallbackFrame has been computed for.
+         */
+        ClipWorkflow*                           m_fallbackClip;
+        bool                                    m_outputExact;
+
+    private slots:
+        void                                    startupFallbackChanged( const QVariant& fallback );
+        void                                    startupTimeoutChanged( const QVariant& timeout );
+
     signals:
         void                                    trackEndReached( unsigned int );
 };
@@ -21,6 +21,7 @@
  *****************************************************************************/
 
 #include "VideoClipWorkflow.h"
+#include "BufferDepthController.h"
 #include "MainWorkflow.h"
 #include "StackedBuffer.hpp"
 #include "LightVideoFrame.h"
@@ -31,35 +32,68 @@
 
 VideoClipWorkflow::VideoClipWorkflow( Clip *clip ) :
         ClipWorkflow( clip ),
-        m_lastRenderedFrame( NULL ),
+        //Leave some room for the frames decoded while the pause is being processed
+        m_computedBuffers( VideoClipWorkflow::maxBuffers * 2 ),
+        m_availableBuffers( VideoClipWorkflow::maxBuffers * 2 ),
+        m_pendingFrame( NULL ),
+        m_stackedBufferPool( NULL ),
         m_width( 0 ),
-        m_height( 0 )
+        m_height( 0 ),
+        m_format( VideoFrame::RGB24 )
 {
+    m_stackedBufferPool = new StackedBufferPool<LightVideoFrame*>( this );
+    m_depthController = new BufferDepthController( VideoClipWorkflow::minBuffers,
+                                                   VideoClipWorkflow::maxBuffers,
+                                                   VideoClipWorkflow::initialBuffers );
+    m_measureSeeks = true;
+    m_useProxy = true;
     debugType = 2;
 }
 
 VideoClipWorkflow::~VideoClipWorkflow()
 {
+    LightVideoFrame     *lvf;
+
+    //Handles still owned by the renderer will delete the pool once released.
+    m_stackedBufferPool->detach();
     while ( m_availableBuffers.isEmpty() == false )
-        delete m_availableBuffers.dequeue();
+    {
+        m_availableBuffers.pop( lvf );
+        delete lvf;
+    }
     while ( m_computedBuffers.isEmpty() == false )
-        delete m_computedBuffers.dequeue();
+    {
+        m_computedBuffers.pop( lvf );
+        delete lvf;
+    }
+    delete m_pendingFrame;
 }
 
 void
 VideoClipWorkflow::preallocate()
 {
-    quint32     newWidth = MainWorkflow::getInstance()->getWidth();
-    quint32     newHeight = MainWorkflow::getInstance()->getHeight();
-    if ( newWidth != m_width || newHeight != m_height )
+    quint32             newWidth = MainWorkflow::getInstance()->getWidth();
+    quint32             newHeight = MainWorkflow::getInstance()->getHeight();
+    VideoFrame::Format  newFormat = MainWorkflow::getInstance()->getVideoFormat();
+    if ( newWidth != m_width || newHeight != m_height || newFormat != m_format )
     {
+        LightVideoFrame     *lvf;
+
         m_width = newWidth;
         m_height = newHeight;
+        m_format = newFormat;
+        //VLC isn't running yet, so we can safely act as the rings consumer.
         while ( m_availableBuffers.isEmpty() == false )
-            delete m_availableBuffers.dequeue();
-        for ( unsigned int i = 0; i < VideoClipWorkflow::nbBuffers; ++i )
         {
-            m_availableBuffers.enqueue( new LightVideoFrame( newWidth, newHeight ) );
+            m_availableBuffers.pop( lvf );
+            delete lvf;
+        }
+        delete m_pendingFrame;
+        m_pendingFrame = NULL;
+        for ( unsigned int i = 0; i < m_depthController->depth(); ++i )
+        {
+            m_availableBuffers.push( new LightVideoFrame( newWidth, newHeight,
+                                                          newFormat ) );
         }
     }
 }
@@ -76,7 +110,9 @@ VideoClipWorkflow::initVlcOutput()
     m_vlcMedia->setVideoDataCtx( this );
     m_vlcMedia->setVideoLockCallback( reinterpret_cast<void*>( getLockCallback() ) );
     m_vlcMedia->setVideoUnlockCallback( reinterpret_cast<void*>( getUnlockCallback() ) );
-    m_vlcMedia->addOption( ":sout-transcode-vcodec=RV24" );
+    //Only decode to RGB when an effect requires it.
+    sprintf( buffer, ":sout-transcode-vcodec=%s", VideoFrame::fourcc( m_format ) );
+    m_vlcMedia->addOption( buffer );
     if ( m_fullSpeedRender == false )
         m_vlcMedia->addOption( ":sout-smem-time-sync" );
     else
@@ -105,24 +141,32 @@ VideoClipWorkflow::getUnlockCallback() const
 void*
 VideoClipWorkflow::getOutput( ClipWorkflow::GetMode mode )
 {
-    QMutexLocker    lock( m_renderLock );
-    QMutexLocker    lock2( m_computedBuffersMutex );
+    //This only serializes the consumer side (getOutput/flush). VLC's thread never
+    //takes this lock, so we never wait for a frame to be fully decoded.
+    QMutexLocker    lock( m_computedBuffersMutex );
+    LightVideoFrame *lvf = NULL;
 
-    if ( preGetOutput() == false )
+    if ( m_computedBuffers.peek( lvf ) == false )
     {
-        if ( m_lastRenderedFrame != NULL )
-            return new StackedBuffer( m_lastRenderedFrame, NULL, false );
+        bufferUnderrun();
+        const LightVideoFrame&  lastFrame = m_lastRenderedFrame;
+
+        if ( lastFrame->frame.octets != NULL )
+            return m_stackedBufferPool->get( &m_lastRenderedFrame, false );
         return NULL;
     }
     if ( isEndReached() == true )
         return NULL;
     ::StackedBuffer<LightVideoFrame*>* buff;
     if ( mode == ClipWorkflow::Pop )
-        buff = new StackedBuffer( m_computedBuffers.dequeue(), this, true );
-    else if ( mode == ClipWorkflow::Get )
-        buff = new StackedBuffer( m_computedBuffers.head(), NULL, false );
+    {
+        m_computedBuffers.pop( lvf );
+        buff = m_stackedBufferPool->get( lvf, true );
+    }
+    else
+        buff = m_stackedBufferPool->get( lvf, false );
     postGetOutput();
-    m_lastRenderedFrame = buff->get();
+    m_lastRenderedFrame = *( buff->get() );
     return buff;
 }
 
@@ -130,19 +174,29 @@ void
 VideoClipWorkflow::lock( VideoClipWorkflow *cw, void **pp_ret, int size )
 {
     Q_UNUSED( size );
-    QMutexLocker        lock( cw->m_availableBuffersMutex );
-    LightVideoFrame*    lvf = NULL;
+    //If the previous frame couldn't be pushed, its buffer is simply reused.
+    LightVideoFrame*    lvf = cw->m_pendingFrame;
 
-    cw->m_renderLock->lock();
-    cw->m_computedBuffersMutex->lock();
-    if ( cw->m_availableBuffers.isEmpty() == true )
+    if ( lvf == NULL && cw->m_availableBuffers.pop( lvf ) == false )
+        lvf = new LightVideoFrame( cw->m_width, cw->m_height, cw->m_format );
+    else
     {
-        lvf = new LightVideoFrame( cw->m_width, cw->m_height );
+        const LightVideoFrame&  frame = *lvf;
+
+        //A frame released after a resolution or format change can't be reused.
+        if ( frame->width != cw->m_width || frame->height != cw->m_height ||
+             frame->format != cw->m_format )
+        {
+            delete lvf;
+            lvf = new LightVideoFrame( cw->m_width, cw->m_height, cw->m_format );
+        }
     }
-    else
-        lvf = cw->m_availableBuffers.dequeue();
-    cw->m_computedBuffers.enqueue( lvf );
-    *pp_ret = (*(lvf))->frame.octets;
+    cw->m_pendingFrame = lvf;
+    //smem writes straight into the frame buffer. It's Packed, as smem doesn't
+    //know about padded rows, but it's still aligned for the effects.
+    //The whole frame is overwritten, so if it's still referenced downstream
+    //(ie. by the frame cache) it gets a new buffer, rather than a copy.
+    *pp_ret = lvf->reallocateIfShared().frame.octets;
 }
 
 void
@@ -156,11 +210,13 @@ VideoClipWorkflow::unlock( VideoClipWorkflow *cw, void *buffer, int width,
     Q_UNUSED( size );
 
     cw->computePtsDiff( pts );
-    LightVideoFrame     *lvf = cw->m_computedBuffers.last();
-    (*(lvf))->ptsDiff = cw->m_currentPts - cw->m_previousPts;
+    LightVideoFrame     *lvf = cw->m_pendingFrame;
+    lvf->writable( Q_FUNC_INFO ).ptsDiff = cw->m_currentPts - cw->m_previousPts;
+    //Publishing the frame is the only synchronisation point with the renderer.
+    //When the ring is full, the frame is dropped and lock() will reuse it.
+    if ( cw->m_computedBuffers.push( lvf ) == true )
+        cw->m_pendingFrame = NULL;
     cw->commonUnlock();
-    cw->m_renderLock->unlock();
-    cw->m_computedBuffersMutex->unlock();
 }
 
 uint32_t
@@ -172,14 +228,16 @@ VideoClipWorkflow::getNbComputedBuffers() const
 uint32_t
 VideoClipWorkflow::getMaxComputedBuffers() const
 {
-    return VideoClipWorkflow::nbBuffers;
+    return m_depthController->depth();
 }
 
 void
 VideoClipWorkflow::releaseBuffer( LightVideoFrame *lvf )
 {
     QMutexLocker    lock( m_availableBuffersMutex );
-    m_availableBuffers.enqueue( lvf );
+    //Once stopped, frames go straight back to the arena.
+    if ( isStopped() == true || m_availableBuffers.push( lvf ) == false )
+        delete lvf;
 }
 
 void
@@ -187,23 +245,57 @@ VideoClipWorkflow::flushComputedBuffers()
 {
     QMutexLocker    lock( m_computedBuffersMutex );
     QMutexLocker    lock2( m_availableBuffersMutex );
+    LightVideoFrame *lvf;
 
     while ( m_computedBuffers.isEmpty() == false )
-        m_availableBuffers.enqueue( m_computedBuffers.dequeue() );
+    {
+        m_computedBuffers.pop( lvf );
+        if ( m_availableBuffers.push( lvf ) == false )
+            delete lvf;
+    }
 }
 
-VideoClipWorkflow::StackedBuffer::StackedBuffer( LightVideoFrame *lvf,
-                                                    VideoClipWorkflow *poolHandler,
-                                                    bool mustBeReleased) :
-    ::StackedBuffer<LightVideoFrame*>( lvf, mustBeReleased ),
-    m_poolHandler( poolHandler )
+void
+VideoClipWorkflow::releaseBuffers()
 {
+    QMutexLocker    lock( m_computedBuffersMutex );
+    QMutexLocker    lock2( m_availableBuffersMutex );
+    LightVideoFrame *lvf;
+
+    //VLC has been stopped, so we can act as the available ring's consumer.
+    while ( m_availableBuffers.isEmpty() == false )
+    {
+        m_availableBuffers.pop( lvf );
+        delete lvf;
+    }
+    delete m_pendingFrame;
+    m_pendingFrame = NULL;
+    m_lastRenderedFrame = LightVideoFrame();
+    //Force the next initialization to preallocate again.
+    m_width = 0;
+    m_height = 0;
 }
 
-void
-VideoClipWorkflow::StackedBuffer::release()
+int
+VideoClipWorkflow::nbComputedBuffersUnderrun() const
+{
+    return m_computedBuffers.nbEmpty();
+}
+
+int
+VideoClipWorkflow::nbComputedBuffersOverrun() const
+{
+    return m_computedBuffers.nbFull();
+}
+
+int
+VideoClipWorkflow::nbAvailableBuffersUnderrun() const
+{
+    return m_availableBuffers.nbEmpty();
+}
+
+int
+VideoClipWorkflow::nbAvailableBuffersOverrun() const
 {
-    if ( m_mustRelease == true && m_poolHandler.isNull() == false )
-        m_poolHandler->releaseBuffer( m_buff );
-    delete this;
+    return m_availableBuffers.nbFull();
 }
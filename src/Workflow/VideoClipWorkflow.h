@@ -24,51 +24,97 @@
 #define VIDEOCLIPWORKFLOW_H
 
 #include "ClipWorkflow.h"
+#include "LightVideoFrame.h"
 #include "StackedBuffer.hpp"
-#include "Pool.hpp"
-
-#include <QPointer>
+#include "SpscRing.hpp"
 
 class   Clip;
 
-class   VideoClipWorkflow : public ClipWorkflow
+class   VideoClipWorkflow : public ClipWorkflow,
+                            public StackedBufferPool<LightVideoFrame*>::Handler
 {
     Q_OBJECT
 
     public:
-        class   StackedBuffer : public ::StackedBuffer<LightVideoFrame*>
-        {
-            public:
-                StackedBuffer( LightVideoFrame* lvf, VideoClipWorkflow* poolHandler,
-                                    bool mustBeReleased = true);
-                virtual void    release();
-            private:
-                QPointer<VideoClipWorkflow>     m_poolHandler;
-        };
-
         VideoClipWorkflow( Clip* clip );
         ~VideoClipWorkflow();
         void                    *getLockCallback() const;
         void                    *getUnlockCallback() const;
         virtual void            *getOutput( ClipWorkflow::GetMode mode );
 
-        static const quint32    nbBuffers = 3 * 30; //3 seconds with an average fps of 30
+        /**
+         *  \brief  Number of times the renderer asked for a frame that wasn't
+         *          decoded yet.
+         */
+        int                     nbComputedBuffersUnderrun() const;
+        /**
+         *  \brief  Number of frames VLC decoded while the computed ring was full.
+         *          Those frames are dropped.
+         */
+        int                     nbComputedBuffersOverrun() const;
+        /**
+         *  \brief  Number of times VLC had to allocate a new frame because no
+         *          released one was available.
+         */
+        int                     nbAvailableBuffersUnderrun() const;
+        /**
+         *  \brief  Number of released frames that were deleted because the
+         *          available ring was full.
+         */
+        int                     nbAvailableBuffersOverrun() const;
+
+        /**
+         *  \brief  Bounds of the adaptive buffer depth
+         *  \sa     BufferDepthController
+         */
+        static const quint32    minBuffers = 5;
+        static const quint32    maxBuffers = 3 * 30; //3 seconds with an average fps of 30
+        static const quint32    initialBuffers = 30;
 
     protected:
         virtual void            initVlcOutput();
         virtual quint32         getNbComputedBuffers() const;
         virtual quint32         getMaxComputedBuffers() const;
-        void                    releaseBuffer( LightVideoFrame* lvf );
+        virtual void            releaseBuffer( LightVideoFrame* lvf );
         void                    flushComputedBuffers();
+        /**
+         *  \brief  Give every available frame back to the FrameArena.
+         */
+        virtual void            releaseBuffers();
         /**
          *  \brief              Pre-allocate some image buffers.
          */
         void                    preallocate();
 
     private:
-        QQueue<LightVideoFrame*>    m_computedBuffers;
-        QQueue<LightVideoFrame*>    m_availableBuffers;
-        LightVideoFrame             *m_lastRenderedFrame;
+        /**
+         *  \brief  Frames decoded by VLC, waiting to be rendered.
+         *
+         *  VLC's thread is the only producer, and the render thread is the
+         *  only consumer.
+         */
+        SpscRing<LightVideoFrame*>  m_computedBuffers;
+        /**
+         *  \brief  Frames released by the renderer, waiting to be reused by VLC.
+         *
+         *  The render thread is the only producer, and VLC's thread is the
+         *  only consumer.
+         */
+        SpscRing<LightVideoFrame*>  m_availableBuffers;
+        /**
+         *  \brief  The frame VLC is currently writing to, between lock() and unlock()
+         *
+         *  This is only accessed from VLC's thread.
+         */
+        LightVideoFrame             *m_pendingFrame;
+        /**
+         *  \brief  The last frame given to the renderer, rendered again on underrun.
+         *
+         *  This shares the frame, so it stays valid once its buffer is recycled
+         *  or deleted, and VLC will write the next frames somewhere else.
+         */
+        LightVideoFrame             m_lastRenderedFrame;
+        StackedBufferPool<LightVideoFrame*>     *m_stackedBufferPool;
         static void                 lock( VideoClipWorkflow* clipWorkflow, void** pp_ret,
                                       int size );
         static void                 unlock( VideoClipWorkflow* clipWorkflow, void* buffer,
@@ -76,6 +122,7 @@ class   VideoClipWorkflow : public ClipWorkflow
                                         qint64 pts );
         quint32                     m_width;
         quint32                     m_height;
+        VideoFrame::Format          m_format;
 };
 
 #endif // VIDEOCLIPWORKFLOW_H
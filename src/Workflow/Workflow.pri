@@ -1,14 +1,23 @@
 HEADERS += AudioClipWorkflow.h \
+    AudioMixer.h \
+    BufferDepthController.h \
+    ClipIndex.hpp \
     ClipWorkflow.h \
     MainWorkflow.h \
+    MediaPlayerPool.h \
+    PreloadScheduler.h \
     TrackHandler.h \
     TrackWorkflow.h \
     VideoClipWorkflow.h \
     ImageClipWorkflow.h \
     StackedBuffer.hpp
 SOURCES += AudioClipWorkflow.cpp \
+    AudioMixer.cpp \
+    BufferDepthController.cpp \
     ClipWorkflow.cpp \
     MainWorkflow.cpp \
+    MediaPlayerPool.cpp \
+    PreloadScheduler.cpp \
     TrackHandler.cpp \
     TrackWorkflow.cpp \
     VideoClipWorkflow.cpp \
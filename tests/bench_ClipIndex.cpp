@@ -0,0 +1,170 @@
+/*****************************************************************************
+ * bench_ClipIndex.cpp: Measures the cost of finding the clips to render
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "ClipIndex.hpp"
+
+#include <QtTest>
+#include <QVector>
+
+/**
+ *  \brief  Renders NbFrames frames of NbTracks tracks holding NbClips clips each,
+ *          and looks for the clip to render and the clips to preload on each frame,
+ *          like TrackWorkflow::getOutput does.
+ *
+ *  Run it with -tickcounter or -callgrind to get stable numbers.
+ */
+class   bench_ClipIndex : public QObject
+{
+    Q_OBJECT
+
+    private:
+        typedef ClipIndex<int>  Index;
+
+        static const int        NbTracks = 8;
+        static const int        NbClips = 10000;
+        static const int        ClipLength = 25;
+        static const int        NbFrames = 1000;
+        /**
+         *  \brief  Starts in the middle of the timeline, so that a scan has to
+         *          skip half of the clips.
+         */
+        static const qint64     FirstFrame = NbClips * ClipLength / 2;
+        /**
+         *  \brief  How many frames ahead the clips are preloaded.
+         */
+        static const int        PreloadWindow = 50;
+
+        QVector<Index>          m_tracks;
+        qint64                  m_checksum;
+
+        /**
+         *  \brief  Walks the clips from the one starting before frame, until the
+         *          preload window is passed.
+         */
+        void            visit( Index& index, Index::iterator it, qint64 frame )
+        {
+            if ( it != index.begin() )
+                --it;
+            while ( it != index.end() && it.key() <= frame + PreloadWindow )
+            {
+                m_checksum += it.value();
+                ++it;
+            }
+        }
+
+    private slots:
+        void    initTestCase()
+        {
+            m_tracks.resize( NbTracks );
+            for ( int track = 0; track < NbTracks; ++track )
+            {
+                //Shift each track so that the clips don't all start on the same frame.
+                for ( int i = 0; i < NbClips; ++i )
+                    m_tracks[track].insert( i * ClipLength + track, i );
+            }
+            m_checksum = 0;
+        }
+        void    cleanupTestCase()
+        {
+            qDebug() << "checksum:" << m_checksum;
+        }
+
+        /**
+         *  \brief  The cursor follows the playback.
+         */
+        void    playbackCursor()
+        {
+            QBENCHMARK
+            {
+                for ( qint64 frame = FirstFrame; frame < FirstFrame + NbFrames; ++frame )
+                    for ( int track = 0; track < NbTracks; ++track )
+                        visit( m_tracks[track], m_tracks[track].seek( frame ), frame );
+            }
+        }
+        /**
+         *  \brief  A lookup on every frame.
+         */
+        void    playbackLookup()
+        {
+            QBENCHMARK
+            {
+                for ( qint64 frame = FirstFrame; frame < FirstFrame + NbFrames; ++frame )
+                {
+                    for ( int track = 0; track < NbTracks; ++track )
+                    {
+                        Index&          index = m_tracks[track];
+                        qint64          next = index.upperBound( frame ).key();
+                        visit( index, index.find( next ), frame );
+                    }
+                }
+            }
+        }
+        /**
+         *  \brief  Every clip of every track is visited on every frame.
+         */
+        void    playbackScan()
+        {
+            QBENCHMARK
+            {
+                for ( qint64 frame = FirstFrame; frame < FirstFrame + NbFrames; ++frame )
+                {
+                    for ( int track = 0; track < NbTracks; ++track )
+                    {
+                        Index&              index = m_tracks[track];
+                        Index::iterator     it = index.begin();
+                        while ( it != index.end() && it.key() <= frame )
+                            ++it;
+                        visit( index, it, frame );
+                    }
+                }
+            }
+        }
+        /**
+         *  \brief  A clip is moved around the cursor on every clip boundary, which
+         *          invalidates the cursor.
+         */
+        void    playbackWithEdits()
+        {
+            QBENCHMARK
+            {
+                for ( qint64 frame = FirstFrame; frame < FirstFrame + NbFrames; ++frame )
+                {
+                    for ( int track = 0; track < NbTracks; ++track )
+                    {
+                        Index&  index = m_tracks[track];
+                        if ( ( frame - track ) % ClipLength == 0 )
+                        {
+                            //Remove the upcoming clip, and add it back.
+                            Index::iterator it = index.find( frame + ClipLength );
+                            int             clip = it.value();
+                            index.erase( it );
+                            index.insert( frame + ClipLength, clip );
+                        }
+                        visit( index, index.seek( frame ), frame );
+                    }
+                }
+            }
+        }
+};
+
+QTEST_MAIN( bench_ClipIndex )
+#include "bench_ClipIndex.moc"
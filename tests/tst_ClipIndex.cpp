@@ -0,0 +1,217 @@
+/*****************************************************************************
+ * tst_ClipIndex.cpp: Tests the playback cursor of ClipIndex
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "ClipIndex.hpp"
+
+#include <QtTest>
+
+/**
+ *  \brief  Each test edits the index the way TrackWorkflow's addClip, moveClip and
+ *          removeClip do, and checks seek() against a plain lookup.
+ */
+class   tst_ClipIndex : public QObject
+{
+    Q_OBJECT
+
+    private:
+        typedef ClipIndex<int>  Index;
+
+        /**
+         *  \brief  A clip every 10 frames, starting at 0. Each clip value is its
+         *          starting frame.
+         */
+        static void     fill( Index& index, int nbClips )
+        {
+            for ( int i = 0; i < nbClips; ++i )
+                index.insert( i * 10, i * 10 );
+        }
+        /**
+         *  \brief  Remove the clip starting at from, and insert it at to.
+         */
+        static void     move( Index& index, qint64 from, qint64 to )
+        {
+            Index::iterator     it = index.find( from );
+            QVERIFY( it != index.end() );
+            int                 clip = it.value();
+            index.erase( it );
+            index.insert( to, clip );
+        }
+        static void     checkSeek( Index& index, qint64 frame )
+        {
+            Index::const_iterator   expected = index.upperBound( frame );
+            Index::iterator         it = index.seek( frame );
+
+            if ( expected == index.constEnd() )
+            {
+                QVERIFY( it == index.end() );
+                return ;
+            }
+            QVERIFY( it != index.end() );
+            QCOMPARE( it.key(), expected.key() );
+            QCOMPARE( it.value(), expected.value() );
+        }
+
+    private slots:
+        void    playback()
+        {
+            Index   index;
+
+            fill( index, 10 );
+            for ( qint64 frame = 0; frame < 120; ++frame )
+                checkSeek( index, frame );
+        }
+        void    jumps()
+        {
+            Index   index;
+
+            fill( index, 10 );
+            checkSeek( index, 55 );
+            checkSeek( index, 12 );
+            checkSeek( index, 13 );
+            checkSeek( index, 90 );
+            checkSeek( index, 0 );
+            checkSeek( index, 200 );
+            checkSeek( index, -1 );
+        }
+        void    empty()
+        {
+            Index   index;
+
+            checkSeek( index, 0 );
+            checkSeek( index, 1 );
+            fill( index, 3 );
+            checkSeek( index, 2 );
+            index.clear();
+            checkSeek( index, 3 );
+            QVERIFY( index.isEmpty() );
+        }
+        void    addAroundCursor()
+        {
+            Index   index;
+
+            fill( index, 10 );
+            checkSeek( index, 15 );
+            //Before the cursor
+            index.insert( 12, 12 );
+            checkSeek( index, 16 );
+            //Between the current frame and the next clip
+            index.insert( 17, 17 );
+            checkSeek( index, 17 );
+            //Right after the current frame
+            index.insert( 18, 18 );
+            checkSeek( index, 17 );
+            checkSeek( index, 18 );
+            //Replaces the clip the cursor is on.
+            index.insert( 20, 42 );
+            checkSeek( index, 19 );
+            QCOMPARE( index.seek( 19 ).value(), 42 );
+            QCOMPARE( index.count(), 13 );
+        }
+        void    moveAroundCursor()
+        {
+            Index   index;
+
+            fill( index, 10 );
+            checkSeek( index, 15 );
+            //Move the clip under the cursor before the current frame
+            move( index, 20, 5 );
+            checkSeek( index, 16 );
+            QCOMPARE( index.seek( 16 ).key(), Q_INT64_C( 30 ) );
+            //Move it back right after the current frame
+            move( index, 5, 17 );
+            checkSeek( index, 16 );
+            QCOMPARE( index.seek( 16 ).key(), Q_INT64_C( 17 ) );
+            //Move a clip that is far away under the cursor
+            move( index, 90, 16 );
+            checkSeek( index, 16 );
+            checkSeek( index, 17 );
+            //Move the clip under the cursor over the next one
+            move( index, 30, 40 );
+            checkSeek( index, 18 );
+            QCOMPARE( index.seek( 18 ).key(), Q_INT64_C( 40 ) );
+            QCOMPARE( index.seek( 18 ).value(), 30 );
+            QCOMPARE( index.count(), 9 );
+        }
+        void    removeAroundCursor()
+        {
+            Index   index;
+
+            fill( index, 10 );
+            checkSeek( index, 15 );
+            //The clip under the cursor
+            index.erase( index.find( 20 ) );
+            checkSeek( index, 16 );
+            //The clip before the cursor
+            index.erase( index.find( 10 ) );
+            checkSeek( index, 17 );
+            //Every clip after the cursor
+            for ( qint64 start = 30; start < 100; start += 10 )
+                index.erase( index.find( start ) );
+            checkSeek( index, 18 );
+            QVERIFY( index.seek( 19 ) == index.end() );
+            //And back
+            index.insert( 20, 20 );
+            checkSeek( index, 19 );
+        }
+        void    randomEdits()
+        {
+            Index   index;
+            qint64  frame = 0;
+
+            qsrand( 42 );
+            fill( index, 100 );
+            for ( int i = 0; i < 20000; ++i )
+            {
+                qint64  start = frame - 20 + qrand() % 40;
+                switch ( qrand() % 8 )
+                {
+                case 0:
+                    index.insert( start, start );
+                    break ;
+                case 1:
+                {
+                    Index::const_iterator   next = index.upperBound( start );
+                    if ( next != index.constEnd() )
+                        index.erase( index.find( next.key() ) );
+                    break ;
+                }
+                case 2:
+                {
+                    Index::const_iterator   next = index.upperBound( start );
+                    if ( next != index.constEnd() )
+                        move( index, next.key(), frame - 20 + qrand() % 40 );
+                    break ;
+                }
+                case 3:
+                    frame = qrand() % 1100;
+                    break ;
+                default:
+                    ++frame;
+                    break ;
+                }
+                checkSeek( index, frame );
+            }
+        }
+};
+
+QTEST_MAIN( tst_ClipIndex )
+#include "tst_ClipIndex.moc"
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * tst_FrameCache.cpp: Tests the renderer's frame cache
+ *****************************************************************************
+ * Copyright (C) 2008-2010 VideoLAN
+ *
+ * Authors: Hugo Beauzee-Luyssen <hugo@vlmc.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "FrameCache.h"
+
+#include <QtTest>
+
+class   tst_FrameCache : public QObject
+{
+    Q_OBJECT
+
+    private:
+        static const quint32    Width = 16;
+        static const quint32    Height = 8;
+
+        /**
+         *  \brief  Insert a frame for each frame number in [begin, end[
+         */
+        static void     fill( FrameCache& cache, qint64 begin, qint64 end, int revision )
+        {
+            for ( qint64 i = begin; i < end; ++i )
+                cache.insert( i, revision, LightVideoFrame( Width, Height ) );
+        }
+        static bool     isCached( FrameCache& cache, qint64 frameNumber )
+        {
+            LightVideoFrame     frame;
+
+            return cache.get( frameNumber, frame );
+        }
+        static quint64  frameSize()
+        {
+            const LightVideoFrame   frame( Width, Height );
+
+            return frame->nboctets;
+        }
+
+    private slots:
+        void    miss()
+        {
+            FrameCache              cache( 100 * frameSize() );
+            LightVideoFrame         frame( Width, Height );
+            //Reading through a non const frame would detach it.
+            const LightVideoFrame&  constFrame = frame;
+            const quint8*           octets = constFrame->frame.octets;
+
+            QVERIFY( cache.get( 0, frame ) == false );
+            //A miss doesn't touch the frame.
+            QVERIFY( constFrame->frame.octets == octets );
+            fill( cache, 1, 2, 0 );
+            QVERIFY( isCached( cache, 0 ) == false );
+            QVERIFY( isCached( cache, 2 ) == false );
+            QCOMPARE( cache.stats().nbMisses, 3 );
+            QCOMPARE( cache.stats().nbHits, 0 );
+        }
+        void    hit()
+        {
+            FrameCache              cache( 100 * frameSize() );
+            const LightVideoFrame   inserted( Width, Height );
+            LightVideoFrame         frame;
+            const LightVideoFrame&  constFrame = frame;
+
+            cache.insert( 42, 0, inserted );
+            QVERIFY( cache.get( 42, frame ) == true );
+            //The cached frame is shared, not copied.
+            QVERIFY( constFrame->frame.octets == inserted->frame.octets );
+            QVERIFY( cache.get( 42, frame ) == true );
+            QCOMPARE( cache.stats().nbHits, 2 );
+            QCOMPARE( cache.stats().nbMisses, 0 );
+            QCOMPARE( cache.stats().nbInsertions, 1 );
+            QCOMPARE( cache.stats().nbFrames, 1 );
+            QCOMPARE( cache.stats().bytesUsed, frameSize() );
+        }
+        void    rangeInvalidation()
+        {
+            FrameCache          cache( 100 * frameSize() );
+
+            fill( cache, 0, 20, 0 );
+            cache.invalidate( 5, 10, 1 );
+            for ( qint64 i = 0; i < 20; ++i )
+                QCOMPARE( isCached( cache, i ), i < 5 || i >= 10 );
+            QCOMPARE( cache.stats().nbInvalidations, 5 );
+            QCOMPARE( cache.stats().nbFrames, 15 );
+            //Up to the end of the timeline
+            cache.invalidate( 15, -1, 2 );
+            for ( qint64 i = 0; i < 20; ++i )
+                QCOMPARE( isCached( cache, i ), i < 5 || ( i >= 10 && i < 15 ) );
+            QCOMPARE( cache.stats().nbInvalidations, 10 );
+            QCOMPARE( cache.stats().bytesUsed, 10 * frameSize() );
+        }
+        void    outdatedRevision()
+        {
+            FrameCache          cache( 100 * frameSize() );
+
+            cache.invalidate( 0, -1, 3 );
+            //Rendered before the edit.
+            fill( cache, 0, 1, 2 );
+            QVERIFY( isCached( cache, 0 ) == false );
+            fill( cache, 0, 1, 3 );
+            QVERIFY( isCached( cache, 0 ) == true );
+            QCOMPARE( cache.stats().nbInsertions, 1 );
+        }
+        void    eviction()
+        {
+            FrameCache          cache( 3 * frameSize() );
+
+            fill( cache, 0, 3, 0 );
+            //0 becomes the most recently used frame.
+            QVERIFY( isCached( cache, 0 ) == true );
+            fill( cache, 3, 4, 0 );
+            QVERIFY( isCached( cache, 1 ) == false );
+            QVERIFY( isCached( cache, 0 ) == true );
+            QVERIFY( isCached( cache, 2 ) == true );
+            QVERIFY( isCached( cache, 3 ) == true );
+            QCOMPARE( cache.stats().nbEvictions, 1 );
+            cache.setBudget( frameSize() );
+            QCOMPARE( cache.stats().nbFrames, 1 );
+            QVERIFY( isCached( cache, 3 ) == true );
+        }
+        void    clear()
+        {
+            FrameCache          cache( 100 * frameSize() );
+
+            fill( cache, 0, 10, 0 );
+            cache.clear();
+            QVERIFY( isCached( cache, 0 ) == false );
+            QCOMPARE( cache.stats().nbFrames, 0 );
+            QCOMPARE( cache.stats().bytesUsed, Q_UINT64_C( 0 ) );
+        }
+};
+
+QTEST_MAIN( tst_FrameCache )
+#include "tst_FrameCache.moc"